@@ -1,5 +1,6 @@
 #include "Comms.h"
 
+#include <algorithm>
 #include <cstring>
 #include <type_traits>
 #include <utility>
@@ -7,6 +8,18 @@
 namespace {
 constexpr uint32_t kDefaultRxBufferSize = 256;  //!< Generous RX buffer for bursty packets
 
+/** True when sequence a precedes b (modulo 256). */
+bool seqBefore(uint8_t a, uint8_t b) { return static_cast<int8_t>(a - b) < 0; }
+
+/**
+ * Retransmit timeout: two worst-case frame times (the frame and an ACK queued
+ * behind another full frame) plus scheduling slack.
+ */
+uint32_t retransmitTimeoutFor(uint32_t baud) {
+  constexpr uint32_t kMaxFrameBits = (Comms::kMaxPayloadSize + 16) * 10;
+  return 10 + (2 * kMaxFrameBits * 1000) / std::max<uint32_t>(baud, 1);
+}
+
 template <typename... Ts>
 using void_t = void;
 
@@ -77,6 +90,7 @@ bool Comms::begin(HardwareSerial& serial, int rxPin, int txPin, uint32_t baud) {
   started_ = true;
   linkState_ = LinkState::kIdle;
   lastHeartbeatSentMs_ = millis();
+  idleHeartbeatIntervalMs_ = heartbeatIntervalMs_;
   lastHeartbeatSeenMs_ = 0;
   lastTxMs_ = 0;
   lastRxMs_ = 0;
@@ -84,6 +98,17 @@ bool Comms::begin(HardwareSerial& serial, int rxPin, int txPin, uint32_t baud) {
   lastTransferStatus_ = 0;
   stats_ = {};
 
+  // A fresh session tells the peer to resynchronise its sequence tracking.
+  baud_ = baud;
+  retransmitTimeoutMs_ = retransmitTimeoutFor(baud);
+  txSession_ = static_cast<uint8_t>(random(1, 256));
+  txNextSeq_ = 0;
+  txCount_ = 0;
+  rxSynced_ = false;
+  for (auto& slot : rxSlots_) {
+    slot.used = false;
+  }
+
   return true;
 }
 
@@ -102,6 +127,7 @@ void Comms::setCallbacks(const Callbacks& callbacks) {
 
 void Comms::setHeartbeatInterval(uint32_t intervalMs) {
   heartbeatIntervalMs_ = intervalMs;
+  idleHeartbeatIntervalMs_ = intervalMs;
 }
 
 void Comms::setHeartbeatTimeout(uint32_t timeoutMs) {
@@ -112,7 +138,38 @@ bool Comms::send(const Packet& packet) {
   return send(packet.channel, packet.data, packet.size);
 }
 
+void Comms::setChannelReliable(uint8_t channel, bool reliable) {
+  uint32_t mask = 1UL << (channel % 32);
+  if (reliable) {
+    reliableChannels_[channel / 32] |= mask;
+  } else {
+    reliableChannels_[channel / 32] &= ~mask;
+  }
+}
+
+bool Comms::isChannelReliable(uint8_t channel) const {
+  return (reliableChannels_[channel / 32] & (1UL << (channel % 32))) != 0;
+}
+
+bool Comms::setBaud(uint32_t baud) {
+  if (!started_ || serial_ == nullptr || baud == 0) {
+    return false;
+  }
+  serial_->flush();
+  serial_->updateBaudRate(baud);
+  baud_ = baud;
+  retransmitTimeoutMs_ = retransmitTimeoutFor(baud);
+  return true;
+}
+
+bool Comms::sendPriority(const uint8_t* data, size_t length) {
+  return sendFrame(FrameType::kPriority, 0, data, length);
+}
+
 bool Comms::send(uint8_t channel, const uint8_t* data, size_t length) {
+  if (isChannelReliable(channel)) {
+    return sendReliable(channel, data, length);
+  }
   return sendFrame(FrameType::kData, channel, data, length);
 }
 
@@ -123,7 +180,9 @@ void Comms::update() {
 
   const uint32_t now = millis();
 
-  if (heartbeatIntervalMs_ > 0 && (now - lastHeartbeatSentMs_) >= heartbeatIntervalMs_) {
+  // Every frame refreshes the peer's timeout, so only an idle TX side needs
+  // a heartbeat.
+  if (heartbeatIntervalMs_ > 0 && (now - lastTxMs_) >= idleHeartbeatIntervalMs_) {
     sendHeartbeat(now);
   }
 
@@ -137,7 +196,11 @@ void Comms::update() {
     handleErrorStatus(transfer_.status);
   }
 
-  updateLinkState(now);
+  // Frames read above may be stamped after now; a stale now would wrap the
+  // heartbeat age.
+  const uint32_t after = millis();
+  serviceRetransmits(after);
+  updateLinkState(after);
 }
 
 void Comms::clearError() {
@@ -145,7 +208,8 @@ void Comms::clearError() {
   lastTransferStatus_ = 0;
 }
 
-bool Comms::sendFrame(FrameType type, uint8_t channel, const uint8_t* payload, size_t length) {
+bool Comms::sendFrame(FrameType type, uint8_t channel, const uint8_t* payload, size_t length,
+                      const uint8_t* prefix, size_t prefixLength) {
   if (!started_) {
     return false;
   }
@@ -171,23 +235,190 @@ bool Comms::sendFrame(FrameType type, uint8_t channel, const uint8_t* payload, s
   uint8_t* txBuffer = TransferBuffers::tx(transfer_);
   txBuffer[0] = static_cast<uint8_t>(type);
   txBuffer[1] = channel;
-  txBuffer[2] = static_cast<uint8_t>(length);
+  txBuffer[2] = static_cast<uint8_t>(prefixLength + length);
+  if (prefixLength > 0) {
+    memcpy(&txBuffer[kFrameOverhead], prefix, prefixLength);
+  }
   if (length > 0) {
-    memcpy(&txBuffer[kFrameOverhead], payload, length);
+    memcpy(&txBuffer[kFrameOverhead + prefixLength], payload, length);
   }
 
-  transfer_.sendData(static_cast<uint16_t>(length + kFrameOverhead));
+  transfer_.sendData(static_cast<uint16_t>(prefixLength + length + kFrameOverhead));
   lastTxMs_ = millis();
+  stats_.bytesTx += prefixLength + length + kFrameOverhead;
 
   if (type == FrameType::kHeartbeat) {
     stats_.heartbeatsTx++;
     lastHeartbeatSentMs_ = lastTxMs_;
   } else {
-    stats_.packetsTx++;
+    idleHeartbeatIntervalMs_ = heartbeatIntervalMs_;
+    if (type != FrameType::kAck) {
+      stats_.packetsTx++;
+    }
   }
   return true;
 }
 
+bool Comms::sendReliable(uint8_t channel, const uint8_t* data, size_t length) {
+  if (length > kMaxPayloadSize || (length > 0 && data == nullptr)) {
+    return sendFrame(FrameType::kReliableData, channel, data, length);  // reports the error
+  }
+  if (!started_ || txCount_ == kReliableWindow) {
+    return false;
+  }
+  TxSlot& slot = txSlots_[txNextSeq_ % kReliableWindow];
+  slot.seq = txNextSeq_++;
+  slot.channel = channel;
+  slot.size = static_cast<uint8_t>(length);
+  slot.retransmits = 0;
+  if (length > 0) {
+    memcpy(slot.data, data, length);
+  }
+  ++txCount_;
+  return transmitSlot(slot);
+}
+
+bool Comms::transmitSlot(TxSlot& slot) {
+  // The window base lets the receiver skip frames this side gave up on.
+  const uint8_t header[kReliableHeader] = {txSession_, slot.seq,
+                                           static_cast<uint8_t>(txNextSeq_ - txCount_)};
+  slot.sentMs = millis();
+  return sendFrame(FrameType::kReliableData, slot.channel, slot.data, slot.size, header,
+                   sizeof(header));
+}
+
+void Comms::serviceRetransmits(uint32_t now) {
+  while (txCount_ > 0) {
+    const TxSlot& oldest = txSlots_[static_cast<uint8_t>(txNextSeq_ - txCount_) % kReliableWindow];
+    if (oldest.retransmits < kMaxRetransmits || (now - oldest.sentMs) < retransmitTimeoutMs_) {
+      break;
+    }
+    --txCount_;
+    stats_.deliveryFailures++;
+  }
+  for (uint8_t i = 0; i < txCount_; ++i) {
+    TxSlot& slot =
+        txSlots_[static_cast<uint8_t>(txNextSeq_ - txCount_ + i) % kReliableWindow];
+    if ((now - slot.sentMs) >= retransmitTimeoutMs_ && slot.retransmits < kMaxRetransmits) {
+      ++slot.retransmits;
+      stats_.retransmits++;
+      transmitSlot(slot);
+    }
+  }
+}
+
+void Comms::handleReliable(uint8_t channel, const uint8_t* payload, size_t length) {
+  if (length < kReliableHeader) {
+    stats_.payloadErrors++;
+    return;
+  }
+  const uint8_t session = payload[0];
+  const uint8_t seq = payload[1];
+  const uint8_t base = payload[2];
+
+  if (!rxSynced_ || session != rxSession_) {
+    rxSynced_ = true;
+    rxSession_ = session;
+    rxExpected_ = base;
+    for (auto& slot : rxSlots_) {
+      slot.used = false;
+    }
+  }
+
+  auto flushInOrder = [this]() {
+    RxSlot* slot = &rxSlots_[rxExpected_ % kReliableWindow];
+    while (slot->used && slot->seq == rxExpected_) {
+      slot->used = false;
+      ++rxExpected_;
+      deliver(slot->packet);
+      slot = &rxSlots_[rxExpected_ % kReliableWindow];
+    }
+  };
+
+  if (seqBefore(rxExpected_, base)) {
+    // The sender gave up on everything before base.
+    for (auto& slot : rxSlots_) {
+      if (slot.used && seqBefore(slot.seq, base)) {
+        slot.used = false;
+      }
+    }
+    rxExpected_ = base;
+    flushInOrder();
+  }
+
+  const int8_t distance = static_cast<int8_t>(seq - rxExpected_);
+  if (distance < 0) {
+    stats_.duplicatesRx++;
+    sendAck(false);
+    return;
+  }
+  if (distance >= static_cast<int8_t>(kReliableWindow)) {
+    sendAck(true);
+    return;
+  }
+
+  Packet packet;
+  packet.channel = channel;
+  packet.size = static_cast<uint8_t>(length - kReliableHeader);
+  if (packet.size > 0) {
+    memcpy(packet.data, payload + kReliableHeader, packet.size);
+  }
+
+  if (distance > 0) {
+    RxSlot& slot = rxSlots_[seq % kReliableWindow];
+    if (slot.used && slot.seq == seq) {
+      stats_.duplicatesRx++;
+    } else {
+      slot.used = true;
+      slot.seq = seq;
+      slot.packet = packet;
+      stats_.outOfOrderRx++;
+    }
+    sendAck(true);
+    return;
+  }
+
+  ++rxExpected_;
+  deliver(packet);
+  flushInOrder();
+  sendAck(false);
+}
+
+void Comms::handleAck(const uint8_t* payload, size_t length) {
+  if (length < 3 || payload[0] != txSession_) {
+    return;
+  }
+  const uint8_t next = payload[1];
+  const bool nack = (payload[2] & kAckFlagNack) != 0;
+  while (txCount_ > 0 && seqBefore(static_cast<uint8_t>(txNextSeq_ - txCount_), next)) {
+    --txCount_;
+  }
+  if (!nack || txCount_ == 0) {
+    return;
+  }
+  // Fast retransmit of the missing frame, once; later losses wait for the
+  // timeout so a burst of NACKs does not flood the link.
+  TxSlot& oldest = txSlots_[static_cast<uint8_t>(txNextSeq_ - txCount_) % kReliableWindow];
+  if (oldest.seq == next && oldest.retransmits == 0) {
+    ++oldest.retransmits;
+    stats_.retransmits++;
+    transmitSlot(oldest);
+  }
+}
+
+void Comms::sendAck(bool nack) {
+  const uint8_t payload[3] = {rxSession_, rxExpected_,
+                              static_cast<uint8_t>(nack ? kAckFlagNack : 0)};
+  sendFrame(FrameType::kAck, 0, payload, sizeof(payload));
+}
+
+void Comms::deliver(const Packet& packet) {
+  stats_.packetsRx++;
+  if (callbacks_.onPacket) {
+    callbacks_.onPacket(packet, callbacks_.context);
+  }
+}
+
 void Comms::handleIncoming(uint16_t size) {
   if (size < kFrameOverhead) {
     stats_.payloadErrors++;
@@ -203,7 +434,7 @@ void Comms::handleIncoming(uint16_t size) {
   const uint8_t channel = rxBuffer[1];
   const uint8_t payloadSize = rxBuffer[2];
 
-  if (payloadSize > kMaxPayloadSize || payloadSize != size - kFrameOverhead) {
+  if (payloadSize > kMaxPayloadSize + kReliableHeader || payloadSize != size - kFrameOverhead) {
     stats_.payloadErrors++;
     lastError_ = Error::kSerialTransfer;
     if (callbacks_.onError) {
@@ -213,6 +444,7 @@ void Comms::handleIncoming(uint16_t size) {
   }
 
   lastRxMs_ = millis();
+  stats_.bytesRx += size;
   recordSuccessfulTransfer();
 
   if (type == FrameType::kHeartbeat) {
@@ -224,7 +456,34 @@ void Comms::handleIncoming(uint16_t size) {
     return;
   }
 
-  if (type != FrameType::kData) {
+  if (type == FrameType::kAck) {
+    lastHeartbeatSeenMs_ = lastRxMs_;
+    handleAck(&rxBuffer[kFrameOverhead], payloadSize);
+    return;
+  }
+
+  if (type == FrameType::kReliableData) {
+    lastHeartbeatSeenMs_ = lastRxMs_;
+    handleReliable(channel, &rxBuffer[kFrameOverhead], payloadSize);
+    return;
+  }
+
+  if (type == FrameType::kPriority && payloadSize <= kMaxPayloadSize) {
+    lastHeartbeatSeenMs_ = lastRxMs_;
+    Packet packet;
+    packet.channel = channel;
+    packet.size = payloadSize;
+    if (packet.size > 0) {
+      memcpy(packet.data, &rxBuffer[kFrameOverhead], packet.size);
+    }
+    stats_.packetsRx++;
+    if (callbacks_.onPriority) {
+      callbacks_.onPriority(packet, callbacks_.context);
+    }
+    return;
+  }
+
+  if (type != FrameType::kData || payloadSize > kMaxPayloadSize) {
     // Unknown frame type -> treat as payload error
     stats_.payloadErrors++;
     lastError_ = Error::kSerialTransfer;
@@ -242,11 +501,7 @@ void Comms::handleIncoming(uint16_t size) {
   if (packet.size > 0) {
     memcpy(packet.data, &rxBuffer[kFrameOverhead], packet.size);
   }
-  stats_.packetsRx++;
-
-  if (callbacks_.onPacket) {
-    callbacks_.onPacket(packet, callbacks_.context);
-  }
+  deliver(packet);
 }
 
 void Comms::handleErrorStatus(int16_t status) {
@@ -268,6 +523,14 @@ void Comms::recordSuccessfulTransfer() {
 void Comms::sendHeartbeat(uint32_t now) {
   sendFrame(FrameType::kHeartbeat, 0, nullptr, 0);
   lastHeartbeatSentMs_ = now;
+
+  // Back off while idle, but keep the base rate until the peer is heard so a
+  // reconnecting board is picked up quickly.
+  uint32_t maxIntervalMs = heartbeatIntervalMs_;
+  if (heartbeatTimeoutMs_ > 0 && linkState_ == LinkState::kActive) {
+    maxIntervalMs = std::max(heartbeatIntervalMs_, heartbeatTimeoutMs_ / kMinHeartbeatsPerTimeout);
+  }
+  idleHeartbeatIntervalMs_ = std::min(idleHeartbeatIntervalMs_ * 2, maxIntervalMs);
 }
 
 void Comms::updateLinkState(uint32_t now) {
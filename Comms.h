@@ -23,11 +23,16 @@ class Comms {
    * @brief Frame types sent across the wire.
    */
   enum class FrameType : uint8_t {
-    kData = 0x01,       //!< Application data payload
-    kHeartbeat = 0x7E,  //!< Periodic keep-alive frame
-    kAck = 0x7F         //!< Reserved for future acknowledgement support
+    kData = 0x01,          //!< Application data payload
+    kReliableData = 0x02,  //!< Sequenced payload that is acknowledged and retransmitted
+    kPriority = 0x03,      //!< Urgent payload handed over straight from the receive path
+    kHeartbeat = 0x7E,     //!< Periodic keep-alive frame
+    kAck = 0x7F            //!< Acknowledges (or requests) reliable frames
   };
 
+  /** Reliable frames that may be unacknowledged at once. */
+  static constexpr size_t kReliableWindow = 8;
+
   /**
    * @brief High-level link status derived from heartbeats and serial health.
    */
@@ -70,6 +75,7 @@ class Comms {
    */
   struct Callbacks {
     PacketCallback onPacket = nullptr;       //!< Called for application data packets
+    PacketCallback onPriority = nullptr;     //!< Called for priority frames
     HeartbeatCallback onHeartbeat = nullptr; //!< Called whenever a heartbeat is received
     ErrorCallback onError = nullptr;         //!< Called when the link enters an error state
     void* context = nullptr;                 //!< User supplied context pointer
@@ -85,6 +91,12 @@ class Comms {
     uint32_t heartbeatsRx = 0;     //!< Number of heartbeat frames received
     uint32_t crcErrors = 0;        //!< Count of CRC or framing errors from SerialTransfer
     uint32_t payloadErrors = 0;    //!< Packets discarded because of malformed headers
+    uint32_t retransmits = 0;      //!< Reliable frames sent again after a NACK or timeout
+    uint32_t duplicatesRx = 0;     //!< Reliable frames received more than once
+    uint32_t outOfOrderRx = 0;     //!< Reliable frames that arrived ahead of a gap
+    uint32_t deliveryFailures = 0; //!< Reliable frames dropped after the last retransmit
+    uint32_t bytesTx = 0;          //!< Frame bytes (header and payload) transmitted
+    uint32_t bytesRx = 0;          //!< Frame bytes (header and payload) received intact
   };
 
   Comms();
@@ -100,6 +112,20 @@ class Comms {
    */
   bool begin(HardwareSerial& serial, int rxPin, int txPin, uint32_t baud = 115200);
 
+  /**
+   * @brief Switch the UART to a new baudrate.
+   *
+   * Frames already queued are flushed at the old rate first. Framing and
+   * sequence state are kept; reliable frames lost in the switch are
+   * retransmitted.
+   */
+  bool setBaud(uint32_t baud);
+
+  /**
+   * @return The current UART baudrate.
+   */
+  uint32_t baud() const { return baud_; }
+
   /**
    * @brief Stop the link and release the UART.
    */
@@ -111,9 +137,14 @@ class Comms {
   void setCallbacks(const Callbacks& callbacks);
 
   /**
-   * @brief Set the heartbeat transmit interval.
+   * @brief Set the base heartbeat transmit interval.
    *
    * The default is 50ms which keeps latency low without saturating the UART.
+   * Any transmitted frame counts as a heartbeat for the peer, so heartbeats
+   * are only sent once nothing else went out for an interval. While the link
+   * stays idle the interval doubles per heartbeat, capped so at least
+   * kMinHeartbeatsPerTimeout fit into the heartbeat timeout; link-loss
+   * detection time is unchanged.
    */
   void setHeartbeatInterval(uint32_t intervalMs);
 
@@ -124,6 +155,16 @@ class Comms {
    */
   void setHeartbeatTimeout(uint32_t timeoutMs);
 
+  /**
+   * @brief Deliver a channel through the reliable path.
+   *
+   * Frames on reliable channels carry a sequence number, are acknowledged by
+   * the peer and retransmitted on a NACK or after a timeout. The receiver
+   * hands them to onPacket exactly once and in order. Both peers must enable
+   * the same channels.
+   */
+  void setChannelReliable(uint8_t channel, bool reliable);
+
   /**
    * @brief Send a pre-built packet structure.
    */
@@ -131,9 +172,22 @@ class Comms {
 
   /**
    * @brief Send a payload with an explicit channel identifier.
+   *
+   * On reliable channels this fails while kReliableWindow frames are still
+   * unacknowledged.
    */
   bool send(uint8_t channel, const uint8_t* data, size_t length);
 
+  /**
+   * @brief Send an urgent payload that bypasses the reliable window.
+   *
+   * Priority frames go out immediately and reach the peer's onPriority
+   * callback from inside its update(), ahead of anything the application has
+   * queued. They are not acknowledged; callers that need delivery must follow
+   * up on a regular channel.
+   */
+  bool sendPriority(const uint8_t* data, size_t length);
+
   /**
    * @brief Convenience helper that serialises a POD struct as packet payload.
    */
@@ -188,9 +242,37 @@ class Comms {
   void clearError();
 
  private:
-  static constexpr size_t kFrameOverhead = 3;  //!< bytes for type/channel/length header
+  static constexpr size_t kFrameOverhead = 3;     //!< bytes for type/channel/length header
+  static constexpr size_t kReliableHeader = 3;    //!< session, sequence and window base
+  static constexpr uint8_t kMaxRetransmits = 4;   //!< attempts after the first before giving up
+  static constexpr uint8_t kAckFlagNack = 0x01;   //!< peer is missing the acknowledged sequence
+  static constexpr uint32_t kMinHeartbeatsPerTimeout = 4;  //!< idle heartbeats per timeout window
 
-  bool sendFrame(FrameType type, uint8_t channel, const uint8_t* payload, size_t length);
+  struct TxSlot {
+    uint8_t seq;
+    uint8_t channel;
+    uint8_t size;
+    uint8_t retransmits;
+    uint32_t sentMs;
+    uint8_t data[kMaxPayloadSize];
+  };
+
+  struct RxSlot {
+    bool used;
+    uint8_t seq;
+    Packet packet;
+  };
+
+  bool sendFrame(FrameType type, uint8_t channel, const uint8_t* payload, size_t length,
+                 const uint8_t* prefix = nullptr, size_t prefixLength = 0);
+  bool isChannelReliable(uint8_t channel) const;
+  bool sendReliable(uint8_t channel, const uint8_t* data, size_t length);
+  bool transmitSlot(TxSlot& slot);
+  void serviceRetransmits(uint32_t now);
+  void handleReliable(uint8_t channel, const uint8_t* payload, size_t length);
+  void handleAck(const uint8_t* payload, size_t length);
+  void sendAck(bool nack);
+  void deliver(const Packet& packet);
   void handleIncoming(uint16_t size);
   void handleErrorStatus(int16_t status);
   void sendHeartbeat(uint32_t now);
@@ -201,7 +283,9 @@ class Comms {
   SerialTransfer transfer_;
   Callbacks callbacks_{};
   bool started_ = false;
+  uint32_t baud_ = 0;
   uint32_t heartbeatIntervalMs_ = 50;
+  uint32_t idleHeartbeatIntervalMs_ = 50;  //!< current interval, backs off while idle
   uint32_t heartbeatTimeoutMs_ = 250;
   uint32_t lastHeartbeatSentMs_ = 0;
   uint32_t lastHeartbeatSeenMs_ = 0;
@@ -211,5 +295,16 @@ class Comms {
   Error lastError_ = Error::kNone;
   int16_t lastTransferStatus_ = 0;
   LinkState linkState_ = LinkState::kIdle;
+
+  uint32_t reliableChannels_[8] = {};
+  uint32_t retransmitTimeoutMs_ = 40;
+  uint8_t txSession_ = 0;
+  uint8_t txNextSeq_ = 0;
+  uint8_t txCount_ = 0;
+  TxSlot txSlots_[kReliableWindow] = {};
+  bool rxSynced_ = false;
+  uint8_t rxSession_ = 0;
+  uint8_t rxExpected_ = 0;
+  RxSlot rxSlots_[kReliableWindow] = {};
 };
 
@@ -12,6 +12,7 @@
 #include "display_menu.h"
 #include "input.h"
 #include "motion.h"
+#include "sky_clock.h"
 #include "state.h"
 #include "storage.h"
 
@@ -82,6 +83,7 @@ void setup() {
 
 void loop() {
   comm::updateLink();
+  motion::syncCalibration();
   display_menu::update();
   display_menu::handleInput();
 
@@ -104,7 +106,7 @@ void loop() {
   if (systemState.gotoActive) {
     if (input::consumeJoystickPress()) {
       systemState.gotoActive = false;
-      motion::clearGotoRates();
+      motion::abortGoto();
       display_menu::showInfo("Goto aborted", 2000);
     }
   }
@@ -158,8 +160,12 @@ void loop() {
   }
   systemState.mountLinkReady = g_mountLinkReady;
 
+  // Setpoints collected during this tick go out as one frame.
+  comm::flushBatch();
+
   wifi_ota::update();
-  delay(20);
+  // Wake early when the sky clock has a capture window or RTC write coming.
+  delay((sky_clock::sleepMicros(20000) + 999) / 1000);
 }
 
 #elif defined(DEVICE_ROLE_MAIN)
@@ -167,10 +173,12 @@ void loop() {
 #include <Arduino.h>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 
 #include "comm.h"
 #include "config.h"
 #include "motion.h"
+#include "rpc_protocol.h"
 #include "state.h"
 #include "storage.h"
 
@@ -178,6 +186,10 @@ namespace {
 
 TaskHandle_t motorTaskHandle = nullptr;
 TaskHandle_t commandTaskHandle = nullptr;
+TaskHandle_t linkTaskHandle = nullptr;
+// Generation of the calibration last pushed by the HID, echoed in telemetry.
+// Stays 0 after boot until the HID resends its mirror.
+uint32_t g_calibrationGeneration = 0;
 
 void initDebugSerial() {
   Serial.begin(config::USB_DEBUG_BAUD);
@@ -185,161 +197,295 @@ void initDebugSerial() {
   Serial.println("[MAIN] Boot");
 }
 
-bool parseAxis(const String& value, Axis& outAxis) {
-  if (value.equalsIgnoreCase("AZ")) {
+bool axisFromWire(uint8_t value, Axis& outAxis) {
+  if (value == rpc::kAxisAz) {
     outAxis = Axis::Az;
     return true;
   }
-  if (value.equalsIgnoreCase("ALT")) {
+  if (value == rpc::kAxisAlt) {
     outAxis = Axis::Alt;
     return true;
   }
   return false;
 }
 
-String formatDouble(double value) { return String(value, 6); }
-
+// One case per opcode; ASCII requests arrive here already translated.
 void handleRequest(const comm::Request& request) {
-  const String& cmd = request.command;
-  auto paramCount = request.params.size();
+  using rpc::Opcode;
+  using rpc::Status;
 
-  auto requireParams = [&](size_t expected) {
-    if (paramCount < expected) {
-      comm::sendError(request.id, "Missing params");
+  // Decodes a fixed-size payload, answering kBadPayload on mismatch.
+  auto decode = [&](auto& payload) {
+    if (!request.decode(payload)) {
+      comm::sendResponse(request, Status::kBadPayload);
       return false;
     }
     return true;
   };
 
-  auto parseAxisParam = [&](size_t index, Axis& axis) {
-    if (!parseAxis(request.params[index], axis)) {
-      comm::sendError(request.id, "Invalid axis");
+  auto decodeAxis = [&](uint8_t value, Axis& axis) {
+    if (!axisFromWire(value, axis)) {
+      comm::sendResponse(request, Status::kInvalidAxis);
       return false;
     }
     return true;
   };
 
-  if (cmd == "SET_MANUAL_RPM") {
-    if (!requireParams(2)) return;
-    Axis axis;
-    if (!parseAxisParam(0, axis)) return;
-    float rpm = request.params[1].toFloat();
-    motion::setManualRate(axis, rpm);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "SET_MANUAL_SPS") {
-    if (!requireParams(2)) return;
-    Axis axis;
-    if (!parseAxisParam(0, axis)) return;
-    double sps = strtod(request.params[1].c_str(), nullptr);
-    motion::setManualStepsPerSecond(axis, sps);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "SET_GOTO_SPS") {
-    if (!requireParams(2)) return;
-    Axis axis;
-    if (!parseAxisParam(0, axis)) return;
-    double sps = strtod(request.params[1].c_str(), nullptr);
-    motion::setGotoStepsPerSecond(axis, sps);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "CLEAR_GOTO") {
+  switch (request.opcode) {
+    case Opcode::kSetManualRpm:
+    case Opcode::kSetManualSps:
+    case Opcode::kSetGotoSps: {
+      rpc::AxisFloat payload;
+      Axis axis;
+      if (!decode(payload) || !decodeAxis(payload.axis, axis)) return;
+      if (request.opcode == Opcode::kSetManualRpm) {
+        motion::setManualRate(axis, payload.value);
+      } else if (request.opcode == Opcode::kSetManualSps) {
+        motion::setManualStepsPerSecond(axis, payload.value);
+      } else {
+        motion::setGotoStepsPerSecond(axis, payload.value);
+      }
+      comm::sendResponse(request, Status::kOk);
+      return;
+    }
+    case Opcode::kClearGoto:
+      motion::clearGotoRates();
+      comm::sendResponse(request, Status::kOk);
+      return;
+    case Opcode::kMoveTo: {
+      rpc::MoveToRequest payload;
+      if (!decode(payload)) return;
+      GotoProfile profile{};
+      profile.maxSpeedDegPerSec = payload.maxSpeedDegPerSec;
+      profile.accelerationDegPerSec2 = payload.accelerationDegPerSec2;
+      profile.decelerationDegPerSec2 = payload.decelerationDegPerSec2;
+      MoveMode mode = payload.mode == static_cast<uint8_t>(MoveMode::Coordinated)
+                          ? MoveMode::Coordinated
+                          : MoveMode::Independent;
+      bool accepted =
+          motion::moveTo(payload.azTargetSteps, payload.altTargetSteps, profile, mode);
+      comm::sendResponse(request, accepted ? Status::kOk : Status::kRejected);
+      return;
+    }
+    case Opcode::kGetMoveActive:
+      comm::sendResponse(request, rpc::Flag{static_cast<uint8_t>(motion::isMoveActive())});
+      return;
+    case Opcode::kStopAll:
+      motion::stopAll();
+      comm::sendResponse(request, Status::kOk);
+      return;
+    case Opcode::kSetTrackingEnabled: {
+      rpc::Flag payload;
+      if (!decode(payload)) return;
+      motion::setTrackingEnabled(payload.value != 0);
+      comm::sendResponse(request, Status::kOk);
+      return;
+    }
+    case Opcode::kSetTrackingRates: {
+      rpc::TrackingRatesRequest payload;
+      if (!decode(payload)) return;
+      motion::setTrackingRates(payload.azDegPerSec, payload.altDegPerSec);
+      comm::sendResponse(request, Status::kOk);
+      return;
+    }
+    case Opcode::kSetTrackingPoly: {
+      rpc::TrackingPolyRequest payload;
+      Axis axis;
+      if (!decode(payload) || !decodeAxis(payload.axis, axis)) return;
+      TrackingPolynomial polynomial{payload.baseSteps, payload.c1, payload.c2, payload.c3,
+                                    payload.horizonMs};
+      bool accepted = motion::setTrackingPolynomial(axis, polynomial);
+      comm::sendResponse(request, accepted ? Status::kOk : Status::kRejected);
+      return;
+    }
+    case Opcode::kClearTrackingPoly:
+      motion::clearTrackingPolynomials();
+      comm::sendResponse(request, Status::kOk);
+      return;
+    case Opcode::kQueueSegments: {
+      // Variable length: header plus count segments.
+      rpc::QueueSegmentsRequest payload{};
+      if (request.payloadSize < rpc::kQueueSegmentsHeaderSize ||
+          request.payloadSize > sizeof(payload)) {
+        comm::sendResponse(request, Status::kBadPayload);
+        return;
+      }
+      memcpy(&payload, request.payload, request.payloadSize);
+      if (payload.count == 0 || payload.count > rpc::kMaxSegmentsPerRequest ||
+          request.payloadSize !=
+              rpc::kQueueSegmentsHeaderSize + payload.count * sizeof(rpc::Segment)) {
+        comm::sendResponse(request, Status::kBadPayload);
+        return;
+      }
+      Axis axis;
+      if (!decodeAxis(payload.axis, axis)) return;
+      VelocitySegment segments[rpc::kMaxSegmentsPerRequest];
+      for (size_t i = 0; i < payload.count; ++i) {
+        segments[i] = {payload.segments[i].startMs, payload.segments[i].durationMs,
+                       payload.segments[i].startStepsPerSecond,
+                       payload.segments[i].accelStepsPerSecond2};
+      }
+      if (!motion::queueSegments(axis, segments, payload.count)) {
+        comm::sendResponse(request, Status::kRejected);
+        return;
+      }
+      comm::sendResponse(
+          request, rpc::Int32Value{static_cast<int32_t>(motion::getFreeSegmentSlots(axis))});
+      return;
+    }
+    case Opcode::kClearSegments:
+      motion::clearSegments();
+      comm::sendResponse(request, Status::kOk);
+      return;
+    case Opcode::kGetSegmentSpace: {
+      rpc::AxisSelect payload;
+      Axis axis;
+      if (!decode(payload) || !decodeAxis(payload.axis, axis)) return;
+      comm::sendResponse(
+          request, rpc::Int32Value{static_cast<int32_t>(motion::getFreeSegmentSlots(axis))});
+      return;
+    }
+    case Opcode::kSetWifiEnabled: {
+      rpc::Flag payload;
+      if (!decode(payload)) return;
+      wifi_ota::setEnabled(payload.value != 0);
+      comm::sendResponse(request, Status::kOk);
+      return;
+    }
+    case Opcode::kGetStepCount: {
+      rpc::AxisSelect payload;
+      Axis axis;
+      if (!decode(payload) || !decodeAxis(payload.axis, axis)) return;
+      comm::sendResponse(request, rpc::Int64Value{motion::getStepCount(axis)});
+      return;
+    }
+    case Opcode::kSetStepCount: {
+      rpc::AxisInt64 payload;
+      Axis axis;
+      if (!decode(payload) || !decodeAxis(payload.axis, axis)) return;
+      motion::setStepCount(axis, payload.value);
+      comm::sendResponse(request, Status::kOk);
+      return;
+    }
+    case Opcode::kStepsToAz:
+    case Opcode::kStepsToAlt: {
+      rpc::Int64Value payload;
+      if (!decode(payload)) return;
+      double degrees = (request.opcode == Opcode::kStepsToAz)
+                           ? motion::stepsToAzDegrees(payload.value)
+                           : motion::stepsToAltDegrees(payload.value);
+      comm::sendResponse(request, rpc::FloatValue{static_cast<float>(degrees)});
+      return;
+    }
+    case Opcode::kAzToSteps:
+    case Opcode::kAltToSteps: {
+      rpc::FloatValue payload;
+      if (!decode(payload)) return;
+      int64_t steps = (request.opcode == Opcode::kAzToSteps)
+                          ? motion::azDegreesToSteps(payload.value)
+                          : motion::altDegreesToSteps(payload.value);
+      comm::sendResponse(request, rpc::Int64Value{steps});
+      return;
+    }
+    case Opcode::kApplyCalibration: {
+      rpc::CalibrationRequest payload;
+      if (!decode(payload)) return;
+      AxisCalibration calib{};
+      calib.stepsPerDegreeAz = payload.stepsPerDegreeAz;
+      calib.stepsPerDegreeAlt = payload.stepsPerDegreeAlt;
+      calib.azHomeOffset = payload.azHomeOffset;
+      calib.altHomeOffset = payload.altHomeOffset;
+      motion::applyCalibration(calib);
+      g_calibrationGeneration = payload.generation;
+      comm::sendResponse(request, Status::kOk);
+      return;
+    }
+    case Opcode::kSetBacklash: {
+      rpc::BacklashRequest payload;
+      if (!decode(payload)) return;
+      motion::setBacklash(BacklashConfig{payload.azSteps, payload.altSteps});
+      comm::sendResponse(request, Status::kOk);
+      return;
+    }
+    case Opcode::kSetAltLimitsEnabled: {
+      rpc::AltitudeLimitsRequest payload;
+      if (!decode(payload)) return;
+      motion::setAltitudeLimitsEnabled(payload.enabled != 0);
+      g_calibrationGeneration = payload.generation;
+      comm::sendResponse(request, Status::kOk);
+      return;
+    }
+    case Opcode::kGetBacklash: {
+      rpc::AxisSelect payload;
+      Axis axis;
+      if (!decode(payload) || !decodeAxis(payload.axis, axis)) return;
+      comm::sendResponse(request, rpc::Int32Value{motion::getBacklashSteps(axis)});
+      return;
+    }
+    case Opcode::kGetLastDir: {
+      rpc::AxisSelect payload;
+      Axis axis;
+      if (!decode(payload) || !decodeAxis(payload.axis, axis)) return;
+      comm::sendResponse(request, rpc::Int8Value{motion::getLastDirection(axis)});
+      return;
+    }
+    case Opcode::kSetLinkBaud: {
+      rpc::LinkBaudRequest payload;
+      if (!decode(payload)) return;
+      comm::switchLinkBaud(request, payload.baud);
+      return;
+    }
+    case Opcode::kGetLinkStats:
+      comm::sendResponse(request, comm::linkStats());
+      return;
+    case Opcode::kBatch:
+      comm::handleBatch(request, handleRequest);
+      return;
+  }
+  comm::sendResponse(request, Status::kUnknownOpcode);
+}
+
+// Runs in the command task from inside the link pump, so it never races
+// handleRequest.
+void handleEmergencyStop(rpc::StopScope scope) {
+  if (scope == rpc::StopScope::kGoto) {
     motion::clearGotoRates();
-    comm::sendOk(request.id, {});
-  } else if (cmd == "STOP_ALL") {
-    motion::stopAll();
-    comm::sendOk(request.id, {});
-  } else if (cmd == "SET_TRACKING_ENABLED") {
-    if (!requireParams(1)) return;
-    bool enabled = request.params[0] == "1";
-    motion::setTrackingEnabled(enabled);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "SET_TRACKING_RATES") {
-    if (!requireParams(2)) return;
-    double az = strtod(request.params[0].c_str(), nullptr);
-    double alt = strtod(request.params[1].c_str(), nullptr);
-    motion::setTrackingRates(az, alt);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "SET_WIFI_ENABLED") {
-    if (!requireParams(1)) return;
-    bool enabled = request.params[0] == "1";
-    wifi_ota::setEnabled(enabled);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "GET_STEP_COUNT") {
-    if (!requireParams(1)) return;
-    Axis axis;
-    if (!parseAxisParam(0, axis)) return;
-    int64_t count = motion::getStepCount(axis);
-    comm::sendOk(request.id, {String(count)});
-  } else if (cmd == "SET_STEP_COUNT") {
-    if (!requireParams(2)) return;
-    Axis axis;
-    if (!parseAxisParam(0, axis)) return;
-    int64_t value = strtoll(request.params[1].c_str(), nullptr, 10);
-    motion::setStepCount(axis, value);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "STEPS_TO_AZ") {
-    if (!requireParams(1)) return;
-    int64_t steps = strtoll(request.params[0].c_str(), nullptr, 10);
-    double degrees = motion::stepsToAzDegrees(steps);
-    comm::sendOk(request.id, {formatDouble(degrees)});
-  } else if (cmd == "STEPS_TO_ALT") {
-    if (!requireParams(1)) return;
-    int64_t steps = strtoll(request.params[0].c_str(), nullptr, 10);
-    double degrees = motion::stepsToAltDegrees(steps);
-    comm::sendOk(request.id, {formatDouble(degrees)});
-  } else if (cmd == "AZ_TO_STEPS") {
-    if (!requireParams(1)) return;
-    double degrees = strtod(request.params[0].c_str(), nullptr);
-    int64_t steps = motion::azDegreesToSteps(degrees);
-    comm::sendOk(request.id, {String(steps)});
-  } else if (cmd == "ALT_TO_STEPS") {
-    if (!requireParams(1)) return;
-    double degrees = strtod(request.params[0].c_str(), nullptr);
-    int64_t steps = motion::altDegreesToSteps(degrees);
-    comm::sendOk(request.id, {String(steps)});
-  } else if (cmd == "APPLY_CALIBRATION") {
-    if (!requireParams(4)) return;
-    AxisCalibration calib{};
-    calib.stepsPerDegreeAz = strtod(request.params[0].c_str(), nullptr);
-    calib.stepsPerDegreeAlt = strtod(request.params[1].c_str(), nullptr);
-    calib.azHomeOffset = strtoll(request.params[2].c_str(), nullptr, 10);
-    calib.altHomeOffset = strtoll(request.params[3].c_str(), nullptr, 10);
-    motion::applyCalibration(calib);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "SET_BACKLASH") {
-    if (!requireParams(2)) return;
-    BacklashConfig config{};
-    config.azSteps = static_cast<int32_t>(request.params[0].toInt());
-    config.altSteps = static_cast<int32_t>(request.params[1].toInt());
-    motion::setBacklash(config);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "SET_ALT_LIMITS_ENABLED") {
-    if (!requireParams(1)) return;
-    bool enabled = request.params[0] == "1";
-    motion::setAltitudeLimitsEnabled(enabled);
-    comm::sendOk(request.id, {});
-  } else if (cmd == "GET_BACKLASH") {
-    if (!requireParams(1)) return;
-    Axis axis;
-    if (!parseAxisParam(0, axis)) return;
-    comm::sendOk(request.id, {String(motion::getBacklashSteps(axis))});
-  } else if (cmd == "GET_LAST_DIR") {
-    if (!requireParams(1)) return;
-    Axis axis;
-    if (!parseAxisParam(0, axis)) return;
-    comm::sendOk(request.id, {String(motion::getLastDirection(axis))});
   } else {
-    comm::sendError(request.id, "Unknown command");
+    motion::stopAll();
   }
 }
 
+void publishTelemetry() {
+  rpc::Telemetry telemetry{};
+  telemetry.timestampMs = millis();
+  telemetry.azSteps = motion::getStepCount(Axis::Az);
+  telemetry.altSteps = motion::getStepCount(Axis::Alt);
+  telemetry.azStepsPerSecond = static_cast<float>(motion::getStepsPerSecond(Axis::Az));
+  telemetry.altStepsPerSecond = static_cast<float>(motion::getStepsPerSecond(Axis::Alt));
+  telemetry.azLastDirection = motion::getLastDirection(Axis::Az);
+  telemetry.altLastDirection = motion::getLastDirection(Axis::Alt);
+  telemetry.flags = motion::isMoveActive() ? rpc::kTelemetryMoveActive : 0;
+  telemetry.calibrationGeneration = g_calibrationGeneration;
+  comm::publishTelemetry(telemetry);
+}
+
 void commandTask(void*) {
   constexpr uint32_t kReadyIntervalMs = 500;
+  constexpr uint32_t kTelemetryIntervalMs = 1000 / config::TELEMETRY_RATE_HZ;
   uint32_t lastReadyMs = 0;
+  uint32_t lastTelemetryMs = 0;
   comm::announceReady();
   lastReadyMs = millis();
   while (true) {
-    comm::updateLink();
+    uint32_t sinceTelemetry = millis() - lastTelemetryMs;
+    if (sinceTelemetry >= kTelemetryIntervalMs) {
+      publishTelemetry();
+      lastTelemetryMs = millis();
+      sinceTelemetry = 0;
+    }
     comm::Request request;
-    if (comm::readRequest(request, 100)) {
+    // Wait no longer than the next telemetry frame is due.
+    if (comm::readRequest(request, kTelemetryIntervalMs - sinceTelemetry)) {
       handleRequest(request);
       lastReadyMs = millis();
     } else {
@@ -352,6 +498,15 @@ void commandTask(void*) {
   }
 }
 
+// Pumps the link above the command task's priority, so emergency stops are
+// handled while a request handler is still running.
+void linkTask(void*) {
+  while (true) {
+    comm::updateLink();
+    delay(1);
+  }
+}
+
 void motorTask(void*) {
   motion::motorTaskLoop();
 }
@@ -366,11 +521,13 @@ void setup() {
   motion::init();
   motion::applyCalibration(storage::getConfig().axisCalibration);
   motion::setBacklash(storage::getConfig().backlash);
+  comm::setStopHandler(handleEmergencyStop);
 
   xTaskCreatePinnedToCore(motorTask, "motor", 4096, nullptr, 2, &motorTaskHandle,
                           1);
   xTaskCreatePinnedToCore(commandTask, "cmd", 8192, nullptr, 2,
                           &commandTaskHandle, 0);
+  xTaskCreatePinnedToCore(linkTask, "link", 4096, nullptr, 3, &linkTaskHandle, 0);
   if (Serial) {
     Serial.println("[MAIN] Tasks started");
   }
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+// Integer time and angle types for the float astronomy kernel. A float Julian
+// day resolves only a quarter day and a float sidereal angle a few tenths of
+// a degree, so the kernel keeps time as microseconds since J2000.0 and fast
+// angles as fractions of a turn in unsigned 64-bit fixed point, where
+// wraparound is the modulo-360 reduction.
+namespace astro_time {
+
+constexpr int64_t kJ2000UnixSeconds = 946728000;  // 2000-01-01 12:00 UTC
+constexpr int64_t kMicrosPerSecond = 1000000;
+constexpr int64_t kMicrosPerDay = 86400 * kMicrosPerSecond;
+constexpr double kDaysPerCentury = 36525.0;
+constexpr double kTurn = 18446744073709551616.0;  // 2^64
+
+inline int64_t microsSinceJ2000(int64_t unixSeconds, int64_t micros = 0) {
+  return (unixSeconds - kJ2000UnixSeconds) * kMicrosPerSecond + micros;
+}
+
+// Julian centuries since J2000.0. Float resolves about a minute here, which is
+// enough for the slowly varying terms that use it.
+inline float centuries(int64_t microsSinceJ2000) {
+  int64_t days = microsSinceJ2000 / kMicrosPerDay;
+  int64_t rest = microsSinceJ2000 - days * kMicrosPerDay;
+  return (static_cast<float>(days) + static_cast<float>(rest) / static_cast<float>(kMicrosPerDay)) /
+         static_cast<float>(kDaysPerCentury);
+}
+
+constexpr uint64_t turnFraction(double turns) {
+  double fraction = turns - static_cast<double>(static_cast<int64_t>(turns));
+  if (fraction < 0.0) fraction += 1.0;
+  return static_cast<uint64_t>(fraction * kTurn);
+}
+
+// theta(t) = atEpoch + rate * t, modulo one turn. The per-day term drops
+// whole turns so it stays exact over centuries; the remainder of the day
+// uses a per-microsecond rate that keeps ~2^-30 relative accuracy.
+struct LinearAngle {
+  uint64_t atEpoch;
+  uint64_t perDay;
+  uint64_t perMicro;
+};
+
+constexpr LinearAngle linearAngle(double degreesAtEpoch, double degreesPerDay) {
+  return {turnFraction(degreesAtEpoch / 360.0), turnFraction(degreesPerDay / 360.0),
+          static_cast<uint64_t>(
+              static_cast<int64_t>(degreesPerDay / 360.0 / kMicrosPerDay * kTurn))};
+}
+
+inline uint64_t angleAt(const LinearAngle& angle, int64_t microsSinceJ2000) {
+  int64_t days = microsSinceJ2000 / kMicrosPerDay;
+  int64_t rest = microsSinceJ2000 - days * kMicrosPerDay;
+  if (rest < 0) {
+    rest += kMicrosPerDay;
+    --days;
+  }
+  return angle.atEpoch + static_cast<uint64_t>(days) * angle.perDay +
+         static_cast<uint64_t>(rest) * angle.perMicro;
+}
+
+inline uint64_t degreesToTurns(float degrees) {
+  return static_cast<uint64_t>(static_cast<int64_t>(degrees * (4294967296.0f / 360.0f))) << 32;
+}
+
+// [0, 360); the top 32 bits keep float's full precision.
+inline float turnsToDegrees(uint64_t turns) {
+  return static_cast<float>(static_cast<uint32_t>(turns >> 32)) * (360.0f / 4294967296.0f);
+}
+
+}  // namespace astro_time
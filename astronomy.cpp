@@ -0,0 +1,97 @@
+#include "astronomy.h"
+
+#include "config.h"
+#include "planets.h"
+#include "storage.h"
+
+namespace astronomy {
+
+namespace {
+
+float localSiderealDegreesFloat(int64_t when) {
+  return siderealDegreesAt(when, static_cast<float>(storage::getConfig().observerLongitudeDeg));
+}
+
+}  // namespace
+
+double localSiderealDegrees(int64_t when) {
+  if (config::ASTRONOMY_FLOAT_KERNEL) {
+    return localSiderealDegreesFloat(when);
+  }
+  return siderealDegrees(julianDayAt(when), storage::getConfig().observerLongitudeDeg);
+}
+
+void getObjectRaDecAt(const CatalogObject& object,
+                      int64_t when,
+                      double secondsAhead,
+                      double& raHours,
+                      double& decDegrees,
+                      int64_t* futureTime) {
+  int64_t future = when + llround(secondsAhead * astro_time::kMicrosPerSecond);
+  raHours = object.raHours;
+  decDegrees = object.decDegrees;
+
+  if (futureTime) {
+    *futureTime = future;
+  }
+
+  PlanetId planetId;
+  if (object.type.equalsIgnoreCase("planet") &&
+      planets::planetFromString(object.name, planetId)) {
+    PlanetPosition position;
+    bool computed;
+    if (config::ASTRONOMY_FLOAT_KERNEL) {
+      computed = planets::computePlanetAt(planetId, future, position);
+    } else {
+      computed = planets::computePlanet(planetId, julianDayAt(future), position);
+    }
+    if (computed) {
+      raHours = position.raHours;
+      decDegrees = position.decDegrees;
+    }
+  }
+}
+
+bool raDecToAltAz(int64_t when,
+                  double raHours,
+                  double decDegrees,
+                  double& azimuthDeg,
+                  double& altitudeDeg) {
+  const double latitudeDeg = storage::getConfig().observerLatitudeDeg;
+  if (config::ASTRONOMY_FLOAT_KERNEL) {
+    float az;
+    float alt;
+    bool visible = equatorialToHorizontal(localSiderealDegreesFloat(when),
+                                          static_cast<float>(raHours),
+                                          static_cast<float>(decDegrees),
+                                          static_cast<float>(latitudeDeg), az, alt);
+    azimuthDeg = az;
+    altitudeDeg = alt;
+    return visible;
+  }
+  return equatorialToHorizontal(localSiderealDegrees(when), raHours, decDegrees, latitudeDeg,
+                                azimuthDeg, altitudeDeg);
+}
+
+bool altAzToRaDec(int64_t when,
+                  double azimuthDeg,
+                  double altitudeDeg,
+                  double& raHours,
+                  double& decDegrees) {
+  const double latitudeDeg = storage::getConfig().observerLatitudeDeg;
+  if (config::ASTRONOMY_FLOAT_KERNEL) {
+    float ra;
+    float dec;
+    horizontalToEquatorial(localSiderealDegreesFloat(when), static_cast<float>(azimuthDeg),
+                           static_cast<float>(altitudeDeg), static_cast<float>(latitudeDeg),
+                           ra, dec);
+    raHours = ra;
+    decDegrees = dec;
+    return true;
+  }
+  horizontalToEquatorial(localSiderealDegrees(when), azimuthDeg, altitudeDeg, latitudeDeg,
+                         raHours, decDegrees);
+  return true;
+}
+
+}  // namespace astronomy
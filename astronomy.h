@@ -0,0 +1,170 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cmath>
+
+#include "astro_time.h"
+#include "catalog.h"
+
+// Coordinate transforms behind the goto, tracking and catalog screens. The
+// kernels are templates on the scalar type so host benchmarks can build float
+// and operation-counting variants. Math calls stay unqualified so such types
+// are found by argument lookup. config::ASTRONOMY_FLOAT_KERNEL selects whether
+// the entry points below run them in double or float.
+namespace astronomy {
+
+constexpr double kJ2000 = 2451545.0;
+constexpr double kDaysPerCentury = 36525.0;
+
+template <typename Real>
+Real degToRad(Real degrees) {
+  return degrees * Real(DEG_TO_RAD);
+}
+
+template <typename Real>
+Real radToDeg(Real radians) {
+  return radians * Real(RAD_TO_DEG);
+}
+
+template <typename Real>
+Real wrapAngle360(Real degrees) {
+  using std::fmod;
+  Real wrapped = fmod(degrees, Real(360.0));
+  if (wrapped < Real(0.0)) wrapped += Real(360.0);
+  return wrapped;
+}
+
+template <typename Real>
+Real wrapAngle180(Real degrees) {
+  using std::fmod;
+  Real wrapped = fmod(degrees + Real(180.0), Real(360.0));
+  if (wrapped < Real(0.0)) wrapped += Real(360.0);
+  return wrapped - Real(180.0);
+}
+
+// Local mean sidereal time in degrees (IAU 1982 polynomial).
+template <typename Real>
+Real siderealDegrees(Real julianDay, Real longitudeDeg) {
+  Real days = julianDay - Real(kJ2000);
+  Real T = days / Real(kDaysPerCentury);
+  Real lst = Real(280.46061837) + Real(360.98564736629) * days + Real(0.000387933) * T * T -
+             (T * T * T) / Real(38710000.0) + longitudeDeg;
+  return wrapAngle360(lst);
+}
+
+// Bennett's formula, applied between -1 and 90 degrees.
+template <typename Real>
+Real applyAtmosphericRefraction(Real geometricAltitudeDeg) {
+  using std::tan;
+  if (geometricAltitudeDeg < Real(-1.0) || geometricAltitudeDeg > Real(90.0)) {
+    return geometricAltitudeDeg;
+  }
+  Real altitudeWithOffset = geometricAltitudeDeg + Real(10.3) / (geometricAltitudeDeg + Real(5.11));
+  Real refractionArcMinutes = Real(1.02) / tan(degToRad(altitudeWithOffset));
+  return geometricAltitudeDeg + refractionArcMinutes / Real(60.0);
+}
+
+// Both transforms go through atan2 of the full direction vector rather than
+// asin/acos, which lose precision near the zenith, the poles and due
+// north/south; the float kernel depends on that.
+
+// Returns false when the refracted altitude is more than 5 degrees below the
+// horizon.
+template <typename Real>
+bool equatorialToHorizontal(Real lstDeg, Real raHours, Real decDegrees, Real latitudeDeg,
+                            Real& azimuthDeg, Real& altitudeDeg) {
+  using std::atan2;
+  using std::cos;
+  using std::sin;
+  using std::sqrt;
+  Real raDeg = raHours * Real(15.0);
+  Real haRad = degToRad(wrapAngle180(lstDeg - raDeg));
+  Real latRad = degToRad(latitudeDeg);
+  Real decRad = degToRad(decDegrees);
+  Real sinLat = sin(latRad);
+  Real cosLat = cos(latRad);
+  Real sinDec = sin(decRad);
+  Real cosDec = cos(decRad);
+  Real cosHa = cos(haRad);
+
+  // Direction in the horizon frame: east, north, up.
+  Real east = -cosDec * sin(haRad);
+  Real north = sinDec * cosLat - cosDec * sinLat * cosHa;
+  Real up = sinDec * sinLat + cosDec * cosLat * cosHa;
+  Real geometricAltitudeDeg = radToDeg(atan2(up, sqrt(east * east + north * north)));
+
+  azimuthDeg = wrapAngle360(radToDeg(atan2(east, north)));
+  altitudeDeg = applyAtmosphericRefraction(geometricAltitudeDeg);
+  return altitudeDeg > Real(-5.0);
+}
+
+template <typename Real>
+void horizontalToEquatorial(Real lstDeg, Real azimuthDeg, Real altitudeDeg, Real latitudeDeg,
+                            Real& raHours, Real& decDegrees) {
+  using std::atan2;
+  using std::cos;
+  using std::sin;
+  using std::sqrt;
+  Real latRad = degToRad(latitudeDeg);
+  Real altRad = degToRad(altitudeDeg);
+  Real azRad = degToRad(azimuthDeg);
+  Real sinLat = sin(latRad);
+  Real cosLat = cos(latRad);
+  Real sinAlt = sin(altRad);
+  Real cosAlt = cos(altRad);
+  Real cosAz = cos(azRad);
+
+  Real sinDec = sinAlt * sinLat + cosAlt * cosLat * cosAz;
+  Real cosDecSinHa = -sin(azRad) * cosAlt;
+  Real cosDecCosHa = sinAlt * cosLat - cosAlt * sinLat * cosAz;
+  Real decRad = atan2(sinDec, sqrt(cosDecSinHa * cosDecSinHa + cosDecCosHa * cosDecCosHa));
+  Real haDeg = wrapAngle180(radToDeg(atan2(cosDecSinHa, cosDecCosHa)));
+
+  Real raDeg = wrapAngle360(lstDeg - haDeg);
+  raHours = raDeg / Real(15.0);
+  decDegrees = radToDeg(decRad);
+}
+
+inline double julianDayAt(int64_t microsSinceJ2000) {
+  return kJ2000 + microsSinceJ2000 / static_cast<double>(astro_time::kMicrosPerDay);
+}
+
+constexpr astro_time::LinearAngle kSiderealAngle =
+    astro_time::linearAngle(280.46061837, 360.98564736629);
+
+// Float kernel counterpart of siderealDegrees(): the linear term runs in fixed
+// point, the century terms and the longitude in float.
+inline float siderealDegreesAt(int64_t microsSinceJ2000, float longitudeDeg) {
+  float T = astro_time::centuries(microsSinceJ2000);
+  float slowDeg = 0.000387933f * T * T - (T * T * T) / 38710000.0f + longitudeDeg;
+  return astro_time::turnsToDegrees(astro_time::angleAt(kSiderealAngle, microsSinceJ2000) +
+                                    astro_time::degreesToTurns(slowDeg));
+}
+
+// Observer-aware entry points. Times are microseconds since J2000.0 UTC, as
+// sky_clock::nowMicrosSinceJ2000() returns them; latitude and longitude come
+// from the stored configuration. The float kernel stays within
+// kFloatKernelErrorArcsec of the double one (host/test).
+
+constexpr double kFloatKernelErrorArcsec = 2.0;
+
+double localSiderealDegrees(int64_t microsSinceJ2000);
+void getObjectRaDecAt(const CatalogObject& object,
+                      int64_t when,
+                      double secondsAhead,
+                      double& raHours,
+                      double& decDegrees,
+                      int64_t* futureTime);
+bool raDecToAltAz(int64_t when,
+                  double raHours,
+                  double decDegrees,
+                  double& azimuthDeg,
+                  double& altitudeDeg);
+bool altAzToRaDec(int64_t when,
+                  double azimuthDeg,
+                  double altitudeDeg,
+                  double& raHours,
+                  double& decDegrees);
+
+}  // namespace astronomy
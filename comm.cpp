@@ -3,13 +3,13 @@
 #include <Arduino.h>
 #include <HardwareSerial.h>
 #include <algorithm>
-#include <deque>
-#include <utility>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
 
-#if defined(DEVICE_ROLE_HID)
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
-#endif
 
 #include "Comms.h"
 
@@ -18,87 +18,654 @@ namespace {
 HardwareSerial uartLink(static_cast<int>(config::COMM_UART_NUM));
 Comms commsLink;
 uint16_t nextRequestId = 1;
-#if defined(DEVICE_ROLE_HID)
-SemaphoreHandle_t rpcMutex = nullptr;
-constexpr uint8_t kMaxCallRetries = 3;
-#endif
+
+// Guards the link, the HID's pending table and the main board's request
+// queues. Recursive because callbacks run while the pumping task holds it and
+// may queue follow-up requests or answers.
+SemaphoreHandle_t linkMutex = nullptr;
+
+class LinkLock {
+ public:
+  LinkLock() : locked_(linkMutex && xSemaphoreTakeRecursive(linkMutex, portMAX_DELAY) == pdTRUE) {}
+  ~LinkLock() {
+    if (locked_) {
+      xSemaphoreGiveRecursive(linkMutex);
+    }
+  }
+
+ private:
+  bool locked_;
+};
 
 constexpr uint8_t kAsciiChannel = 1;
-constexpr size_t kMaxQueuedLines = 16;
+constexpr char kReadyLine[] = "READY";
 
-std::deque<String> lineQueue;
+// Either board returns to COMM_BAUD when nothing has decoded for this long,
+// which also covers the other side rebooting at the default rate.
+constexpr uint32_t kBaudFallbackMs = 600;
+constexpr size_t kFastBaudCount =
+    sizeof(config::COMM_FAST_BAUDS) / sizeof(config::COMM_FAST_BAUDS[0]);
 
-void pumpLink() { commsLink.update(); }
+bool revertBaudIfSilent() {
+  if (commsLink.baud() == config::COMM_BAUD ||
+      (millis() - commsLink.lastRxTime()) < kBaudFallbackMs) {
+    return false;
+  }
+  commsLink.setBaud(config::COMM_BAUD);
+  if (Serial) {
+    Serial.printf("[COMM] Link quiet, back to %lu baud\n",
+                  static_cast<unsigned long>(config::COMM_BAUD));
+  }
+  return true;
+}
 
-void dropPendingInput() {
-  lineQueue.clear();
-  commsLink.clearError();
+// Bytes per second in each direction over the last full second.
+struct Throughput {
+  uint32_t windowStartMs;
+  uint32_t bytesTx;
+  uint32_t bytesRx;
+  uint32_t txPerSecond;
+  uint32_t rxPerSecond;
+};
+
+Throughput throughput{};
+
+void sampleThroughput() {
+  uint32_t elapsed = millis() - throughput.windowStartMs;
+  if (elapsed < 1000) {
+    return;
+  }
+  Comms::Stats stats = commsLink.stats();
+  throughput.txPerSecond =
+      static_cast<uint32_t>((uint64_t{stats.bytesTx - throughput.bytesTx} * 1000) / elapsed);
+  throughput.rxPerSecond =
+      static_cast<uint32_t>((uint64_t{stats.bytesRx - throughput.bytesRx} * 1000) / elapsed);
+  throughput.bytesTx = stats.bytesTx;
+  throughput.bytesRx = stats.bytesRx;
+  throughput.windowStartMs += elapsed;
 }
 
-bool readLine(String& line, uint32_t timeoutMs) {
-  uint32_t start = millis();
-  while (true) {
-    pumpLink();
-    if (!lineQueue.empty()) {
-      line = lineQueue.front();
-      lineQueue.pop_front();
+#if defined(DEVICE_ROLE_HID)
+// A retransmission is answered from the main board's response cache, so it
+// is only sent while the first answer is still there (see isReplayable).
+constexpr uint8_t kMaxCallAttempts = 5;
+constexpr size_t kMaxPendingCalls = 6;
+
+// A request in flight. The encoded frame is kept so a timed out attempt can
+// be retransmitted under the same id.
+struct PendingCall {
+  bool active;
+  uint16_t id;
+  rpc::Opcode opcode;
+  uint8_t attempts;
+  uint32_t firstSentMs;
+  uint32_t sentMs;
+  uint32_t sentUs;
+  uint32_t timeoutMs;
+  comm::ResponseCallback callback;
+  void* context;
+  uint8_t frameSize;
+  uint8_t frame[Comms::kMaxPayloadSize];
+};
+
+PendingCall pendingCalls[kMaxPendingCalls];
+uint8_t pendingHighWater = 0;
+comm::CommandStats commandStatistics[rpc::kOpcodeCount] = {};
+
+// Main board counters from the last kGetLinkStats answer.
+constexpr uint32_t kRemoteStatsIntervalMs = 1000;
+rpc::LinkStats remoteLinkStats{};
+bool remoteLinkStatsValid = false;
+bool remoteLinkStatsPending = false;
+uint32_t remoteLinkStatsRequestedMs = 0;
+
+comm::CommandStats* statsFor(rpc::Opcode opcode) {
+  size_t index = static_cast<size_t>(opcode);
+  return (index >= 1 && index <= rpc::kOpcodeCount) ? &commandStatistics[index - 1] : nullptr;
+}
+
+void recordRtt(rpc::Opcode opcode, uint32_t rttUs) {
+  comm::CommandStats* stats = statsFor(opcode);
+  if (stats == nullptr) {
+    return;
+  }
+  size_t bucket = 0;
+  while (bucket < comm::kRttBucketCount - 1 && rttUs > comm::kRttBucketLimitsUs[bucket]) {
+    ++bucket;
+  }
+  if (stats->rtt[bucket] < UINT16_MAX) {
+    ++stats->rtt[bucket];
+  }
+}
+
+// The main board only sends READY on the ASCII channel; nothing else there
+// is meant for the HID.
+bool readyPending = false;
+bool mainReadySeen = false;
+
+// The HID drives rate negotiation. candidate indexes COMM_FAST_BAUDS, with
+// kFastBaudCount standing for COMM_BAUD; a rate that failed is not retried
+// until the HID restarts.
+constexpr uint32_t kBaudCheckWindowMs = 1000;
+constexpr uint32_t kMaxCrcErrorsPerWindow = 3;
+constexpr uint32_t kBaudRetryDelayMs = 2 * kBaudFallbackMs;
+
+enum class BaudStage : uint8_t { kIdle, kProposed, kRunning };
+
+struct BaudNegotiation {
+  BaudStage stage;
+  uint8_t candidate;
+  uint8_t current;
+  uint32_t windowStartMs;
+  uint32_t windowCrcErrors;
+  uint32_t nextAttemptMs;
+};
+
+BaudNegotiation baudNegotiation{BaudStage::kIdle, 0, kFastBaudCount, 0, 0, 0};
+
+// Frames older than a few periods mean the main board stopped publishing
+// (or predates telemetry); readers then fall back to polling.
+constexpr uint32_t kTelemetryMaxAgeMs = 3 * (1000 / config::TELEMETRY_RATE_HZ);
+
+struct TelemetryCache {
+  bool valid;
+  uint32_t receivedMs;
+  rpc::Telemetry frame;
+  bool barrierActive;
+  uint16_t barrierId;
+};
+
+TelemetryCache telemetryCache{};
+
+// Only the newest emergency stop is timed.
+uint16_t stopSequence = 0;
+uint32_t stopSentUs = 0;
+bool stopAwaitingEcho = false;
+comm::StopStats stopStatistics{};
+
+
+void finishCall(PendingCall& call, comm::CallResult result, rpc::Status status,
+                const uint8_t* payload, size_t size) {
+  comm::ResponseCallback callback = call.callback;
+  void* context = call.context;
+  call.active = false;
+  if (callback) {
+    callback(comm::Response{result, status, payload, size}, context);
+  }
+}
+
+void dispatchResponse(const Comms::Packet& packet) {
+  rpc::ResponseHeader header;
+  if (packet.size < sizeof(header)) {
+    return;
+  }
+  memcpy(&header, packet.data, sizeof(header));
+  for (auto& call : pendingCalls) {
+    if (!call.active || call.id != header.id || call.opcode != header.opcode) {
+      continue;
+    }
+    comm::CallResult result = (header.status == rpc::Status::kOk) ? comm::CallResult::kOk
+                                                                 : comm::CallResult::kRejected;
+    recordRtt(call.opcode, micros() - call.sentUs);
+    finishCall(call, result, header.status, packet.data + sizeof(header),
+               packet.size - sizeof(header));
+    return;
+  }
+  // Late answer to a call that already timed out.
+}
+
+// Retransmitting is only safe while no newer request with the same opcode is
+// outstanding, otherwise a stale setpoint could overtake a fresh one.
+bool isSuperseded(const PendingCall& call) {
+  for (const auto& other : pendingCalls) {
+    if (other.active && &other != &call && other.opcode == call.opcode &&
+        static_cast<int16_t>(other.id - call.id) > 0) {
       return true;
     }
-    if (timeoutMs != 0) {
-      uint32_t now = millis();
-      if ((now - start) >= timeoutMs) {
-        return false;
+  }
+  return false;
+}
+
+// The main board still holds the answer to call: fewer than kReplayDepth
+// newer ids were issued and the first attempt is recent enough. Otherwise the
+// retry would run non-idempotent commands (moves, segments) a second time.
+bool isReplayable(const PendingCall& call, uint32_t now) {
+  return static_cast<uint16_t>(nextRequestId - call.id) <= rpc::kReplayDepth &&
+         (now - call.firstSentMs) < rpc::kReplayMaxAgeMs;
+}
+
+void serviceCalls() {
+  uint32_t now = millis();
+  for (auto& call : pendingCalls) {
+    if (!call.active || (now - call.sentMs) < call.timeoutMs) {
+      continue;
+    }
+    comm::CommandStats* stats = statsFor(call.opcode);
+    if (call.attempts < kMaxCallAttempts && !isSuperseded(call) && isReplayable(call, now)) {
+      ++call.attempts;
+      call.sentMs = now;
+      call.sentUs = micros();
+      if (stats) {
+        ++stats->retries;
+      }
+      if (Serial) {
+        Serial.printf("[COMM] Retrying opcode %u (attempt %u)\n",
+                      static_cast<unsigned>(call.opcode), call.attempts);
+      }
+      if (commsLink.send(rpc::kChannel, call.frame, call.frameSize)) {
+        continue;
       }
     }
-    delay(1);
+    if (stats) {
+      ++stats->timeouts;
+    }
+    finishCall(call, comm::CallResult::kTimeout, rpc::Status::kOk, nullptr, 0);
   }
 }
 
-bool sendLine(const String& line) {
-  const size_t length = static_cast<size_t>(line.length());
-  if (length > Comms::kMaxPayloadSize) {
+void storeTelemetry(const Comms::Packet& packet) {
+  rpc::Telemetry frame;
+  if (packet.size != sizeof(frame)) {
+    return;
+  }
+  memcpy(&frame, packet.data, sizeof(frame));
+  if (frame.version != rpc::kVersion) {
+    return;
+  }
+  telemetryCache.frame = frame;
+  telemetryCache.receivedMs = millis();
+  telemetryCache.valid = true;
+}
+
+uint32_t candidateBaud(uint8_t index) {
+  return index < kFastBaudCount ? config::COMM_FAST_BAUDS[index] : config::COMM_BAUD;
+}
+
+void handleBaudResponse(const comm::Response& response, void* context) {
+  uint8_t index = static_cast<uint8_t>(reinterpret_cast<uintptr_t>(context));
+  BaudNegotiation& negotiation = baudNegotiation;
+  if (response.result == comm::CallResult::kOk) {
+    // Runs before the frame is acknowledged, so the ACK already goes out at
+    // the new rate the main board switched to after answering.
+    commsLink.setBaud(candidateBaud(index));
+    negotiation.stage = BaudStage::kRunning;
+    negotiation.current = index;
+    negotiation.candidate = index;
+    negotiation.windowStartMs = millis();
+    negotiation.windowCrcErrors = commsLink.stats().crcErrors;
     if (Serial) {
-      Serial.println("[COMM] TX line too long for packet buffer");
+      Serial.printf("[COMM] Link running at %lu baud\n",
+                    static_cast<unsigned long>(candidateBaud(index)));
     }
-    return false;
+    return;
   }
-  if (!commsLink.send(kAsciiChannel,
-                      reinterpret_cast<const uint8_t*>(line.c_str()), length)) {
-    if (Serial) {
-      Serial.println("[COMM] Failed to queue packet for transmission");
+  // Firmware without negotiation answers kUnknownOpcode: stay where we are.
+  negotiation.candidate = (response.status == rpc::Status::kUnknownOpcode)
+                              ? kFastBaudCount
+                              : static_cast<uint8_t>(index + 1);
+  negotiation.stage =
+      negotiation.current == kFastBaudCount ? BaudStage::kIdle : BaudStage::kRunning;
+  negotiation.nextAttemptMs = millis() + kBaudRetryDelayMs;
+}
+
+void proposeBaud(uint8_t index) {
+  baudNegotiation.stage = BaudStage::kProposed;
+  rpc::LinkBaudRequest request{candidateBaud(index)};
+  if (!comm::callAsync(rpc::Opcode::kSetLinkBaud, request, handleBaudResponse,
+                       reinterpret_cast<void*>(static_cast<uintptr_t>(index)))) {
+    comm::Response failed{comm::CallResult::kTimeout, rpc::Status::kOk, nullptr, 0};
+    handleBaudResponse(failed, reinterpret_cast<void*>(static_cast<uintptr_t>(index)));
+  }
+}
+
+void serviceLinkBaud() {
+  BaudNegotiation& negotiation = baudNegotiation;
+  uint32_t now = millis();
+  if (revertBaudIfSilent()) {
+    negotiation.stage = BaudStage::kIdle;
+    negotiation.candidate = std::min<uint8_t>(negotiation.current + 1, kFastBaudCount);
+    negotiation.current = kFastBaudCount;
+    negotiation.nextAttemptMs = now + kBaudRetryDelayMs;
+    return;
+  }
+  switch (negotiation.stage) {
+    case BaudStage::kProposed:
+      return;
+    case BaudStage::kIdle:
+      if (mainReadySeen && negotiation.candidate < kFastBaudCount && commsLink.isActive() &&
+          static_cast<int32_t>(now - negotiation.nextAttemptMs) >= 0) {
+        proposeBaud(negotiation.candidate);
+      }
+      return;
+    case BaudStage::kRunning: {
+      if ((now - negotiation.windowStartMs) < kBaudCheckWindowMs) {
+        return;
+      }
+      uint32_t crcErrors = commsLink.stats().crcErrors;
+      uint32_t errors = crcErrors - negotiation.windowCrcErrors;
+      negotiation.windowStartMs = now;
+      negotiation.windowCrcErrors = crcErrors;
+      // Step down one rate; the answer still arrives at the current one.
+      if (errors > kMaxCrcErrorsPerWindow && negotiation.current < kFastBaudCount) {
+        proposeBaud(static_cast<uint8_t>(negotiation.current + 1));
+      }
+      return;
+    }
+  }
+}
+
+// Setters deferred until the next flush, packed as kBatch entries. Sent
+// batches keep their callbacks (and payload, for main boards that predate
+// kBatch) until the answer arrives.
+struct BatchedCallback {
+  comm::ResponseCallback callback;
+  void* context;
+};
+
+struct Batch {
+  bool active;
+  uint8_t count;
+  uint8_t size;
+  uint8_t payload[rpc::kMaxPayloadSize];
+  BatchedCallback callbacks[rpc::kMaxBatchCommands];
+};
+
+Batch openBatch{};
+Batch sentBatches[kMaxPendingCalls];
+bool batchSupported = true;
+
+void notifyBatched(const BatchedCallback& entry, comm::CallResult result, rpc::Status status) {
+  if (entry.callback) {
+    entry.callback(comm::Response{result, status, nullptr, 0}, entry.context);
+  }
+}
+
+void sendBatchedIndividually(const Batch& batch) {
+  size_t offset = 0;
+  for (uint8_t i = 0; i < batch.count; ++i) {
+    auto opcode = static_cast<rpc::Opcode>(batch.payload[offset]);
+    uint8_t size = batch.payload[offset + 1];
+    const BatchedCallback& entry = batch.callbacks[i];
+    if (!comm::callAsync(opcode, batch.payload + offset + rpc::kBatchEntryHeaderSize, size,
+                         entry.callback, entry.context)) {
+      notifyBatched(entry, comm::CallResult::kTimeout, rpc::Status::kOk);
+    }
+    offset += rpc::kBatchEntryHeaderSize + size;
+  }
+}
+
+void handleBatchResponse(const comm::Response& response, void* context) {
+  auto* sent = static_cast<Batch*>(context);
+  Batch batch = *sent;
+  sent->active = false;
+  if (response.result == comm::CallResult::kRejected &&
+      response.status == rpc::Status::kUnknownOpcode) {
+    batchSupported = false;
+    sendBatchedIndividually(batch);
+    return;
+  }
+  size_t answered = 0;
+  if (response.result == comm::CallResult::kOk && response.size > 0) {
+    answered = std::min<size_t>(response.payload[0], response.size - 1);
+  }
+  for (uint8_t i = 0; i < batch.count; ++i) {
+    const BatchedCallback& entry = batch.callbacks[i];
+    if (i >= answered) {
+      comm::CallResult result = response.result == comm::CallResult::kOk
+                                    ? comm::CallResult::kRejected
+                                    : response.result;
+      notifyBatched(entry, result, response.status);
+      continue;
     }
+    auto status = static_cast<rpc::Status>(response.payload[1 + i]);
+    notifyBatched(entry,
+                status == rpc::Status::kOk ? comm::CallResult::kOk : comm::CallResult::kRejected,
+                status);
+  }
+}
+
+// Called with the link lock held. The open batch is emptied before anything
+// is sent, so the nested callAsync does not flush it again.
+void flushOpenBatch() {
+  if (openBatch.count == 0) {
+    return;
+  }
+  Batch* slot = std::find_if(std::begin(sentBatches), std::end(sentBatches),
+                             [](const Batch& entry) { return !entry.active; });
+  if (openBatch.count == 1 || !batchSupported || slot == std::end(sentBatches)) {
+    Batch batch = openBatch;
+    openBatch.count = 0;
+    openBatch.size = 0;
+    sendBatchedIndividually(batch);
+    return;
+  }
+  *slot = openBatch;
+  slot->active = true;
+  openBatch.count = 0;
+  openBatch.size = 0;
+  if (!comm::callAsync(rpc::Opcode::kBatch, slot->payload, slot->size, handleBatchResponse,
+                       slot)) {
+    slot->active = false;
+    for (uint8_t i = 0; i < slot->count; ++i) {
+      notifyBatched(slot->callbacks[i], comm::CallResult::kTimeout, rpc::Status::kOk);
+    }
+  }
+}
+
+// Called with the link lock held.
+void dropOpenBatch() {
+  Batch batch = openBatch;
+  openBatch.count = 0;
+  openBatch.size = 0;
+  for (uint8_t i = 0; i < batch.count; ++i) {
+    notifyBatched(batch.callbacks[i], comm::CallResult::kCancelled, rpc::Status::kOk);
+  }
+}
+
+void storeRemoteLinkStats(const comm::Response& response, void*) {
+  remoteLinkStatsPending = false;
+  if (response.result == comm::CallResult::kOk && response.size == sizeof(remoteLinkStats)) {
+    memcpy(&remoteLinkStats, response.payload, sizeof(remoteLinkStats));
+    remoteLinkStatsValid = true;
+  }
+}
+
+void pumpLink() {
+  LinkLock lock;
+  commsLink.update();
+  serviceCalls();
+  serviceLinkBaud();
+  sampleThroughput();
+}
+
+struct SyncCall {
+  volatile bool done;
+  bool success;
+  rpc::Status status;
+  void* response;
+  size_t responseSize;
+};
+
+void completeSyncCall(const comm::Response& result, void* context) {
+  auto* call = static_cast<SyncCall*>(context);
+  call->status = result.status;
+  call->success = result.result == comm::CallResult::kOk && result.size == call->responseSize;
+  if (call->success && result.size > 0) {
+    memcpy(call->response, result.payload, result.size);
+  }
+  call->done = true;
+}
+#elif defined(DEVICE_ROLE_MAIN)
+constexpr size_t kMaxQueuedFrames = 8;
+
+struct Frame {
+  uint8_t size;
+  uint8_t data[Comms::kMaxPayloadSize];
+};
+
+Frame frameQueue[kMaxQueuedFrames];
+size_t frameHead = 0;
+size_t frameCount = 0;
+uint16_t lastRequestId = 0;
+
+// ASCII requests from older HID firmware, kept in preallocated buffers with
+// room for a terminating NUL.
+constexpr size_t kMaxQueuedLines = 8;
+constexpr size_t kMaxAsciiParams = 40;
+
+struct LineBuffer {
+  uint8_t length;
+  char data[Comms::kMaxPayloadSize + 1];
+};
+
+LineBuffer lineQueue[kMaxQueuedLines];
+size_t lineHead = 0;
+size_t lineCount = 0;
+
+comm::StopHandler stopHandler = nullptr;
+
+// Status answered by the command handler for the current kBatch entry.
+rpc::Status batchStatus = rpc::Status::kOk;
+
+bool isLinkBaud(uint32_t baud) {
+  return baud == config::COMM_BAUD ||
+         std::find(std::begin(config::COMM_FAST_BAUDS), std::end(config::COMM_FAST_BAUDS),
+                   baud) != std::end(config::COMM_FAST_BAUDS);
+}
+
+// Answers to recent binary requests. The HID retransmits under the original
+// id when a response is lost; replaying the stored answer keeps the command
+// from running twice. The HID keeps its retries inside rpc::kReplayDepth and
+// rpc::kReplayMaxAgeMs. The payload hash guards against ids reused after a
+// HID reboot.
+constexpr size_t kResponseCacheSize = rpc::kReplayDepth;
+constexpr uint32_t kResponseCacheMaxAgeMs = rpc::kReplayMaxAgeMs;
+
+struct CachedResponse {
+  bool valid;
+  uint16_t id;
+  rpc::Opcode opcode;
+  uint32_t requestHash;
+  uint32_t sentMs;
+  uint8_t size;
+  uint8_t frame[Comms::kMaxPayloadSize];
+};
+
+CachedResponse responseCache[kResponseCacheSize];
+size_t responseCacheNext = 0;
+
+uint8_t frameQueueHighWater = 0;
+uint8_t lineQueueHighWater = 0;
+uint32_t replayedRequests = 0;
+
+// Runs in the link task, so priority frames reach handlePriority() while the
+// command task is still busy with a request.
+void pumpLink() {
+  LinkLock lock;
+  commsLink.update();
+  revertBaudIfSilent();
+  sampleThroughput();
+}
+
+void pushFrame(const Comms::Packet& packet) {
+  if (frameCount == kMaxQueuedFrames) {
+    frameHead = (frameHead + 1) % kMaxQueuedFrames;
+    --frameCount;
+  }
+  Frame& frame = frameQueue[(frameHead + frameCount) % kMaxQueuedFrames];
+  frame.size = packet.size;
+  memcpy(frame.data, packet.data, packet.size);
+  ++frameCount;
+  frameQueueHighWater = std::max(frameQueueHighWater, static_cast<uint8_t>(frameCount));
+}
+
+bool popFrame(Frame& frame) {
+  if (frameCount == 0) {
     return false;
   }
+  frame = frameQueue[frameHead];
+  frameHead = (frameHead + 1) % kMaxQueuedFrames;
+  --frameCount;
   return true;
 }
 
+void pushLine(const Comms::Packet& packet) {
+  if (lineCount == kMaxQueuedLines) {
+    lineHead = (lineHead + 1) % kMaxQueuedLines;
+    --lineCount;
+  }
+  LineBuffer& line = lineQueue[(lineHead + lineCount) % kMaxQueuedLines];
+  line.length = packet.size;
+  memcpy(line.data, packet.data, packet.size);
+  ++lineCount;
+  lineQueueHighWater = std::max(lineQueueHighWater, static_cast<uint8_t>(lineCount));
+}
+
+LineBuffer* frontLine() { return lineCount > 0 ? &lineQueue[lineHead] : nullptr; }
+
+void dropLine() {
+  lineHead = (lineHead + 1) % kMaxQueuedLines;
+  --lineCount;
+}
+#endif
+
 void handlePacket(const Comms::Packet& packet, void*) {
+  if (packet.channel == rpc::kChannel) {
+#if defined(DEVICE_ROLE_HID)
+    dispatchResponse(packet);
+#else
+    pushFrame(packet);
+#endif
+    return;
+  }
+#if defined(DEVICE_ROLE_HID)
+  if (packet.channel == rpc::kTelemetryChannel) {
+    storeTelemetry(packet);
+    return;
+  }
+#endif
   if (packet.channel != kAsciiChannel) {
     return;
   }
-  String line;
-  line.reserve(packet.size);
-  for (uint8_t i = 0; i < packet.size; ++i) {
-    line += static_cast<char>(packet.data[i]);
+#if defined(DEVICE_ROLE_HID)
+  if (packet.size == sizeof(kReadyLine) - 1 &&
+      memcmp(packet.data, kReadyLine, packet.size) == 0) {
+    readyPending = true;
+    mainReadySeen = true;
+  }
+#else
+  pushLine(packet);
+#endif
+}
+
+// Called from Comms::update(). On the main board that runs in the link task,
+// so the stop neither waits for the request handler in progress nor for the
+// frames still queued. Those queued requests run after the stop; the regular
+// request the HID posts behind it restores the stopped state.
+void handlePriority(const Comms::Packet& packet, void*) {
+  rpc::EmergencyStop stop;
+  if (packet.size != sizeof(stop)) {
+    return;
+  }
+  memcpy(&stop, packet.data, sizeof(stop));
+  if (stop.version != rpc::kVersion) {
+    return;
   }
-  if (line.equals("READY")) {
-    for (const auto& existing : lineQueue) {
-      if (existing.equals("READY")) {
-        return;  // Already queued a READY notification.
-      }
-    }
+#if defined(DEVICE_ROLE_HID)
+  if (!stopAwaitingEcho || stop.sequence != stopSequence) {
+    return;
   }
-  if (lineQueue.size() >= kMaxQueuedLines) {
-    auto readyIt = std::find_if(lineQueue.begin(), lineQueue.end(), [](const String& value) {
-      return value.equals("READY");
-    });
-    if (readyIt != lineQueue.end()) {
-      lineQueue.erase(readyIt);
-    } else {
-      lineQueue.pop_front();
-    }
+  stopAwaitingEcho = false;
+  uint32_t latency = micros() - stopSentUs;
+  stopStatistics.echoed++;
+  stopStatistics.lastLatencyUs = latency;
+  stopStatistics.maxLatencyUs = std::max(stopStatistics.maxLatencyUs, latency);
+#else
+  if (stopHandler) {
+    stopHandler(stop.scope);
   }
-  lineQueue.push_back(std::move(line));
+  commsLink.sendPriority(packet.data, packet.size);
+#endif
 }
 
 void handleHeartbeat(void*) {
@@ -128,43 +695,522 @@ void handleError(Comms::Error error, int8_t rawStatus, void*) {
   }
 }
 
-void splitFields(const String& line, std::vector<String>& fields) {
-  fields.clear();
-  int start = 0;
-  while (start <= line.length()) {
-    int idx = line.indexOf('|', start);
-    if (idx < 0) {
-      fields.push_back(line.substring(start));
+#if defined(DEVICE_ROLE_MAIN)
+bool sendLine(const char* line, size_t length) {
+  LinkLock lock;
+  if (length > Comms::kMaxPayloadSize) {
+    if (Serial) {
+      Serial.println("[COMM] TX line too long for packet buffer");
+    }
+    return false;
+  }
+  if (!commsLink.send(kAsciiChannel, reinterpret_cast<const uint8_t*>(line), length)) {
+    if (Serial) {
+      Serial.println("[COMM] Failed to queue packet for transmission");
+    }
+    return false;
+  }
+  return true;
+}
+
+// Appends "|value" to a response line; the caller checks length against the
+// packet size before sending.
+void appendField(char* line, size_t& length, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+void appendField(char* line, size_t& length, const char* format, ...) {
+  if (length >= Comms::kMaxPayloadSize) {
+    return;
+  }
+  line[length++] = '|';
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(line + length, Comms::kMaxPayloadSize + 1 - length, format, args);
+  va_end(args);
+  length += static_cast<size_t>(std::max(written, 0));
+}
+
+// View of one field of an ASCII line, NUL terminated in place.
+struct Field {
+  const char* data;
+  uint8_t length;
+
+  bool operator==(const char* other) const { return strcmp(data, other) == 0; }
+};
+
+// Splits text at '|' in place. Every field ends up NUL terminated inside
+// text, which must hold length + 1 bytes. Returns capacity + 1 when there
+// are more fields than fit.
+size_t splitFields(char* text, size_t length, Field* fields, size_t capacity) {
+  size_t count = 0;
+  size_t start = 0;
+  for (size_t i = 0; i <= length; ++i) {
+    if (i < length && text[i] != '|') {
+      continue;
+    }
+    if (count == capacity) {
+      return capacity + 1;
+    }
+    text[i] = '\0';
+    fields[count++] = Field{text + start, static_cast<uint8_t>(i - start)};
+    start = i + 1;
+  }
+  return count;
+}
+
+// Legacy ASCII spelling of every opcode. ASCII requests are translated into
+// the opcode's binary payload, so the main board has a single handler per
+// command. params and result describe the fields in payload order:
+//   a  axis name (AZ/ALT) as uint8    b  flag, "1" = set, as uint8
+//   c  int8    i  int32    u  uint32    l  int64    f  float    d  double
+//   ?  the remaining fields are optional and default to zero
+//   [...]  uint8 count followed by that many repetitions of the group,
+//          consuming all remaining fields
+// Entries are in opcode order so responses find their format by index.
+struct AsciiCommand {
+  const char* name;
+  rpc::Opcode opcode;
+  const char* params;
+  const char* result;
+};
+
+constexpr AsciiCommand kAsciiCommands[] = {
+    {"SET_MANUAL_RPM", rpc::Opcode::kSetManualRpm, "af", ""},
+    {"SET_MANUAL_SPS", rpc::Opcode::kSetManualSps, "af", ""},
+    {"SET_GOTO_SPS", rpc::Opcode::kSetGotoSps, "af", ""},
+    {"CLEAR_GOTO", rpc::Opcode::kClearGoto, "", ""},
+    {"MOVE_TO", rpc::Opcode::kMoveTo, "llfffc", ""},  // Mode 0 independent, 1 coordinated.
+    {"GET_MOVE_ACTIVE", rpc::Opcode::kGetMoveActive, "", "b"},
+    {"STOP_ALL", rpc::Opcode::kStopAll, "", ""},
+    {"SET_TRACKING_ENABLED", rpc::Opcode::kSetTrackingEnabled, "b", ""},
+    {"SET_TRACKING_RATES", rpc::Opcode::kSetTrackingRates, "ff", ""},
+    {"SET_TRACKING_POLY", rpc::Opcode::kSetTrackingPoly, "aulfff", ""},
+    {"CLEAR_TRACKING_POLY", rpc::Opcode::kClearTrackingPoly, "", ""},
+    {"QUEUE_SEGMENTS", rpc::Opcode::kQueueSegments, "a[uuff]", "i"},
+    {"CLEAR_SEGMENTS", rpc::Opcode::kClearSegments, "", ""},
+    {"GET_SEGMENT_SPACE", rpc::Opcode::kGetSegmentSpace, "a", "i"},
+    {"SET_WIFI_ENABLED", rpc::Opcode::kSetWifiEnabled, "b", ""},
+    {"GET_STEP_COUNT", rpc::Opcode::kGetStepCount, "a", "l"},
+    {"SET_STEP_COUNT", rpc::Opcode::kSetStepCount, "al", ""},
+    {"STEPS_TO_AZ", rpc::Opcode::kStepsToAz, "l", "f"},
+    {"STEPS_TO_ALT", rpc::Opcode::kStepsToAlt, "l", "f"},
+    {"AZ_TO_STEPS", rpc::Opcode::kAzToSteps, "f", "l"},
+    {"ALT_TO_STEPS", rpc::Opcode::kAltToSteps, "f", "l"},
+    {"APPLY_CALIBRATION", rpc::Opcode::kApplyCalibration, "ddll?u", ""},
+    {"SET_BACKLASH", rpc::Opcode::kSetBacklash, "ii", ""},
+    {"SET_ALT_LIMITS_ENABLED", rpc::Opcode::kSetAltLimitsEnabled, "b?u", ""},
+    {"GET_BACKLASH", rpc::Opcode::kGetBacklash, "a", "i"},
+    {"GET_LAST_DIR", rpc::Opcode::kGetLastDir, "a", "c"},
+    {"SET_LINK_BAUD", rpc::Opcode::kSetLinkBaud, "u", ""},
+    {"GET_LINK_STATS", rpc::Opcode::kGetLinkStats, "", "uuuuuuuuubb"},
+    {"BATCH", rpc::Opcode::kBatch, "", "b"},  // Binary only; always empty in ASCII.
+};
+
+constexpr size_t kAsciiCommandCount = sizeof(kAsciiCommands) / sizeof(kAsciiCommands[0]);
+
+constexpr bool asciiCommandsInOpcodeOrder() {
+  for (size_t i = 0; i < kAsciiCommandCount; ++i) {
+    if (static_cast<size_t>(kAsciiCommands[i].opcode) != i + 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(asciiCommandsInOpcodeOrder(), "kAsciiCommands must follow rpc::Opcode order");
+
+constexpr uint32_t hashName(const char* name, size_t length) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+  }
+  return hash;
+}
+
+constexpr size_t nameLength(const char* name) {
+  size_t length = 0;
+  while (name[length] != '\0') {
+    ++length;
+  }
+  return length;
+}
+
+// Open-addressed hash index over the command names, built at compile time.
+constexpr size_t kCommandIndexSize = 64;
+constexpr uint8_t kNoCommand = 0xFF;
+
+struct CommandIndex {
+  uint8_t slots[kCommandIndexSize];
+};
+
+constexpr CommandIndex buildCommandIndex() {
+  CommandIndex index{};
+  for (auto& slot : index.slots) {
+    slot = kNoCommand;
+  }
+  for (size_t i = 0; i < kAsciiCommandCount; ++i) {
+    const char* name = kAsciiCommands[i].name;
+    size_t slot = hashName(name, nameLength(name)) % kCommandIndexSize;
+    while (index.slots[slot] != kNoCommand) {
+      slot = (slot + 1) % kCommandIndexSize;
+    }
+    index.slots[slot] = static_cast<uint8_t>(i);
+  }
+  return index;
+}
+
+static_assert(kAsciiCommandCount < kCommandIndexSize / 2, "Command index too full");
+
+constexpr CommandIndex kCommandIndex = buildCommandIndex();
+
+const AsciiCommand* findAsciiCommand(const Field& name) {
+  size_t slot = hashName(name.data, name.length) % kCommandIndexSize;
+  while (kCommandIndex.slots[slot] != kNoCommand) {
+    const AsciiCommand& command = kAsciiCommands[kCommandIndex.slots[slot]];
+    if (name == command.name) {
+      return &command;
+    }
+    slot = (slot + 1) % kCommandIndexSize;
+  }
+  return nullptr;
+}
+
+const AsciiCommand* asciiCommandFor(rpc::Opcode opcode) {
+  size_t index = static_cast<size_t>(opcode);
+  if (index == 0 || index > kAsciiCommandCount) {
+    return nullptr;
+  }
+  return &kAsciiCommands[index - 1];
+}
+
+class PayloadWriter {
+ public:
+  explicit PayloadWriter(comm::Request& request) : request_(request) { request_.payloadSize = 0; }
+
+  template <typename T>
+  bool put(T value) {
+    if (request_.payloadSize + sizeof(T) > sizeof(request_.payload)) {
+      return false;
+    }
+    memcpy(request_.payload + request_.payloadSize, &value, sizeof(T));
+    request_.payloadSize += sizeof(T);
+    return true;
+  }
+
+ private:
+  comm::Request& request_;
+};
+
+// Parses one field (or writes a zero when field is null) of the given type.
+rpc::Status encodeField(char type, const Field* field, PayloadWriter& out) {
+  const char* text = field ? field->data : "0";
+  bool stored = false;
+  switch (type) {
+    case 'a': {
+      uint8_t axis = rpc::kAxisAz;
+      if (field && strcasecmp(text, "ALT") == 0) {
+        axis = rpc::kAxisAlt;
+      } else if (field && strcasecmp(text, "AZ") != 0) {
+        return rpc::Status::kInvalidAxis;
+      }
+      stored = out.put<uint8_t>(axis);
+      break;
+    }
+    case 'b':
+      stored = out.put<uint8_t>(strcmp(text, "1") == 0 ? 1 : 0);
+      break;
+    case 'c':
+      stored = out.put<int8_t>(static_cast<int8_t>(strtol(text, nullptr, 10)));
+      break;
+    case 'i':
+      stored = out.put<int32_t>(static_cast<int32_t>(strtol(text, nullptr, 10)));
+      break;
+    case 'u':
+      stored = out.put<uint32_t>(static_cast<uint32_t>(strtoul(text, nullptr, 10)));
+      break;
+    case 'l':
+      stored = out.put<int64_t>(static_cast<int64_t>(strtoll(text, nullptr, 10)));
+      break;
+    case 'f':
+      stored = out.put<float>(strtof(text, nullptr));
+      break;
+    case 'd':
+      stored = out.put<double>(strtod(text, nullptr));
+      break;
+    default:
+      break;
+  }
+  return stored ? rpc::Status::kOk : rpc::Status::kBadPayload;
+}
+
+rpc::Status encodeAsciiParams(const char* format, const Field* fields, size_t count,
+                              comm::Request& request) {
+  PayloadWriter out(request);
+  bool optional = false;
+  size_t next = 0;
+  for (const char* type = format; *type != '\0'; ++type) {
+    if (*type == '?') {
+      optional = true;
+      continue;
+    }
+    if (*type == '[') {
+      const char* group = type + 1;
+      const char* groupEnd = strchr(group, ']');
+      size_t groupSize = static_cast<size_t>(groupEnd - group);
+      size_t remaining = count - next;
+      if (remaining == 0 || remaining % groupSize != 0 || remaining / groupSize > UINT8_MAX ||
+          !out.put<uint8_t>(static_cast<uint8_t>(remaining / groupSize))) {
+        return rpc::Status::kBadPayload;
+      }
+      while (next < count) {
+        for (const char* member = group; member != groupEnd; ++member) {
+          rpc::Status status = encodeField(*member, &fields[next++], out);
+          if (status != rpc::Status::kOk) {
+            return status;
+          }
+        }
+      }
+      type = groupEnd;
+      continue;
+    }
+    const Field* field = next < count ? &fields[next++] : nullptr;
+    if (field == nullptr && !optional) {
+      return rpc::Status::kBadPayload;
+    }
+    rpc::Status status = encodeField(*type, field, out);
+    if (status != rpc::Status::kOk) {
+      return status;
+    }
+  }
+  return rpc::Status::kOk;
+}
+
+template <typename T>
+bool readValue(const uint8_t* payload, size_t size, size_t& offset, T& value) {
+  if (offset + sizeof(T) > size) {
+    return false;
+  }
+  memcpy(&value, payload + offset, sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+// Appends one result field of the given type; false once the payload is
+// exhausted.
+bool appendResultField(char type, const uint8_t* payload, size_t size, size_t& offset,
+                       char* line, size_t& length) {
+  switch (type) {
+    case 'b': {
+      uint8_t value;
+      if (!readValue(payload, size, offset, value)) return false;
+      appendField(line, length, "%u", value);
+      return true;
+    }
+    case 'c': {
+      int8_t value;
+      if (!readValue(payload, size, offset, value)) return false;
+      appendField(line, length, "%d", value);
+      return true;
+    }
+    case 'i': {
+      int32_t value;
+      if (!readValue(payload, size, offset, value)) return false;
+      appendField(line, length, "%ld", static_cast<long>(value));
+      return true;
+    }
+    case 'u': {
+      uint32_t value;
+      if (!readValue(payload, size, offset, value)) return false;
+      appendField(line, length, "%lu", static_cast<unsigned long>(value));
+      return true;
+    }
+    case 'l': {
+      int64_t value;
+      if (!readValue(payload, size, offset, value)) return false;
+      appendField(line, length, "%lld", static_cast<long long>(value));
+      return true;
+    }
+    case 'f': {
+      float value;
+      if (!readValue(payload, size, offset, value)) return false;
+      appendField(line, length, "%.6f", static_cast<double>(value));
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+// Formats a binary response as the RESP line older HID firmware expects.
+void sendAsciiResponse(const comm::Request& request, rpc::Status status, const uint8_t* payload,
+                       size_t size) {
+  char line[Comms::kMaxPayloadSize + 1];
+  size_t length = 0;
+  if (status != rpc::Status::kOk) {
+    length = static_cast<size_t>(snprintf(line, sizeof(line), "RESP|%u|ERR", request.id));
+    appendField(line, length, "%s", rpc::statusName(status));
+    sendLine(line, length);
+    return;
+  }
+  length = static_cast<size_t>(snprintf(line, sizeof(line), "RESP|%u|OK", request.id));
+  const AsciiCommand* command = asciiCommandFor(request.opcode);
+  size_t offset = 0;
+  for (const char* type = command ? command->result : ""; *type != '\0'; ++type) {
+    if (!appendResultField(*type, payload, size, offset, line, length)) {
       break;
     }
-    fields.push_back(line.substring(start, idx));
-    start = idx + 1;
+  }
+  sendLine(line, length);
+}
+
+bool decodeBinaryRequest(const Frame& frame, comm::Request& request) {
+  rpc::RequestHeader header;
+  if (frame.size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, frame.data, sizeof(header));
+  request.binary = true;
+  request.batched = false;
+  request.id = header.id;
+  request.opcode = header.opcode;
+  request.payloadSize = static_cast<uint8_t>(frame.size - sizeof(header));
+  memcpy(request.payload, frame.data + sizeof(header), request.payloadSize);
+  if (header.version != rpc::kVersion) {
+    comm::sendResponse(request, rpc::Status::kUnsupportedVersion);
+    return false;
+  }
+  return true;
+}
+
+uint32_t hashRequest(const comm::Request& request) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < request.payloadSize; ++i) {
+    hash = (hash ^ request.payload[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void cacheResponse(const comm::Request& request, const uint8_t* frame, size_t size) {
+  CachedResponse& entry = responseCache[responseCacheNext];
+  responseCacheNext = (responseCacheNext + 1) % kResponseCacheSize;
+  entry.id = request.id;
+  entry.opcode = request.opcode;
+  entry.requestHash = hashRequest(request);
+  entry.sentMs = millis();
+  entry.size = static_cast<uint8_t>(size);
+  memcpy(entry.frame, frame, size);
+  entry.valid = true;
+}
+
+bool replayCachedResponse(const comm::Request& request) {
+  uint32_t now = millis();
+  uint32_t hash = hashRequest(request);
+  for (auto& entry : responseCache) {
+    if (!entry.valid || entry.id != request.id || entry.opcode != request.opcode ||
+        entry.requestHash != hash || (now - entry.sentMs) > kResponseCacheMaxAgeMs) {
+      continue;
+    }
+    entry.sentMs = now;
+    ++replayedRequests;
+    commsLink.send(rpc::kChannel, entry.frame, entry.size);
+    return true;
+  }
+  return false;
+}
+
+// Translates REQ|id|COMMAND|params... into the opcode and binary payload.
+// The line is tokenised in its queue slot.
+bool decodeAsciiRequest(LineBuffer& line, comm::Request& request) {
+  constexpr size_t kHeaderFields = 3;  // REQ|id|command
+  constexpr size_t kMaxFields = kHeaderFields + kMaxAsciiParams;
+  line.data[line.length] = '\0';
+  Field fields[kMaxFields];
+  size_t count = splitFields(line.data, line.length, fields, kMaxFields);
+  if (count < kHeaderFields || !(fields[0] == "REQ")) {
+    return false;
+  }
+  request.binary = false;
+  request.batched = false;
+  request.id = static_cast<uint16_t>(strtoul(fields[1].data, nullptr, 10));
+  request.payloadSize = 0;
+  const AsciiCommand* command = findAsciiCommand(fields[2]);
+  if (command == nullptr) {
+    comm::sendResponse(request, rpc::Status::kUnknownOpcode);
+    return false;
+  }
+  request.opcode = command->opcode;
+  rpc::Status status = rpc::Status::kBadPayload;
+  if (count <= kMaxFields) {
+    status = encodeAsciiParams(command->params, fields + kHeaderFields, count - kHeaderFields,
+                               request);
+  }
+  if (status != rpc::Status::kOk) {
+    comm::sendResponse(request, status);
+    return false;
+  }
+  return true;
+}
+// Binary frames are served before queued ASCII lines. Replayed and
+// undecodable requests are answered here and skipped. The link task fills
+// the queues, so they are only touched under the link lock.
+bool takeRequest(comm::Request& request) {
+  LinkLock lock;
+  while (true) {
+    Frame frame;
+    if (popFrame(frame)) {
+      if (decodeBinaryRequest(frame, request) && !replayCachedResponse(request)) {
+        lastRequestId = request.id;
+        return true;
+      }
+      continue;
+    }
+    LineBuffer* line = frontLine();
+    if (line == nullptr) {
+      return false;
+    }
+    bool decoded = decodeAsciiRequest(*line, request);
+    dropLine();
+    if (decoded) {
+      return true;
+    }
   }
 }
+#endif
 
 }  // namespace
 
 namespace comm {
 
 void initLink() {
-  lineQueue.clear();
-  nextRequestId = 1;
+#if defined(DEVICE_ROLE_MAIN)
+  frameHead = 0;
+  frameCount = 0;
+  lineHead = 0;
+  lineCount = 0;
+#else
+  readyPending = false;
+#endif
+  // A random first id keeps a rebooted HID from colliding with responses the
+  // main board still has cached for the previous session.
+  nextRequestId = static_cast<uint16_t>(random(1, 0x10000));
   commsLink.begin(uartLink, config::COMM_RX_PIN, config::COMM_TX_PIN,
                   config::COMM_BAUD);
   commsLink.setHeartbeatInterval(50);
   commsLink.setHeartbeatTimeout(500);
+  // RPC frames are acknowledged at the link layer; the ASCII channel stays
+  // plain so older HID firmware can still talk to this board.
+  commsLink.setChannelReliable(rpc::kChannel, true);
 
   Comms::Callbacks callbacks{};
   callbacks.onPacket = handlePacket;
+  callbacks.onPriority = handlePriority;
   callbacks.onHeartbeat = handleHeartbeat;
   callbacks.onError = handleError;
   commsLink.setCallbacks(callbacks);
   commsLink.clearError();
-#if defined(DEVICE_ROLE_HID)
-  if (rpcMutex == nullptr) {
-    rpcMutex = xSemaphoreCreateMutex();
+  if (linkMutex == nullptr) {
+    linkMutex = xSemaphoreCreateRecursiveMutex();
   }
-#endif
 }
 
 void updateLink() { pumpLink(); }
@@ -174,134 +1220,191 @@ void updateLink() { pumpLink(); }
 bool waitForReady(uint32_t timeoutMs) {
   uint32_t start = millis();
   while (true) {
-    uint32_t remaining = 0;
-    if (timeoutMs != 0) {
-      uint32_t elapsed = millis() - start;
-      if (elapsed >= timeoutMs) {
-        return false;
+    pumpLink();
+    {
+      LinkLock lock;
+      if (readyPending) {
+        readyPending = false;
+        return true;
       }
-      remaining = timeoutMs - elapsed;
     }
-    String line;
-    if (!readLine(line, remaining)) {
+    if (timeoutMs != 0 && (millis() - start) >= timeoutMs) {
       return false;
     }
-    if (line == "READY") {
-      return true;
-    }
+    delay(1);
   }
 }
 
-bool call(const char* command, std::initializer_list<String> params,
-          std::vector<String>* payload, String* error, uint32_t timeoutMs) {
-  class MutexLock {
-   public:
-    explicit MutexLock(SemaphoreHandle_t handle) : handle_(handle), locked_(false) {
-      if (handle_) {
-        locked_ = xSemaphoreTake(handle_, portMAX_DELAY) == pdTRUE;
+bool callAsync(rpc::Opcode opcode, const void* request, size_t requestSize,
+               ResponseCallback callback, void* context, uint32_t timeoutMs) {
+  if (requestSize > rpc::kMaxPayloadSize || (requestSize > 0 && request == nullptr)) {
+    return false;
+  }
+  {
+    // Deferred setters were issued first and must reach the main board first.
+    LinkLock lock;
+    flushOpenBatch();
+  }
+  uint32_t start = millis();
+  while (true) {
+    {
+      LinkLock lock;
+      auto slot = std::find_if(std::begin(pendingCalls), std::end(pendingCalls),
+                               [](const PendingCall& entry) { return !entry.active; });
+      if (slot != std::end(pendingCalls)) {
+        rpc::RequestHeader header{rpc::kVersion, opcode, nextRequestId++};
+        memcpy(slot->frame, &header, sizeof(header));
+        if (requestSize > 0) {
+          memcpy(slot->frame + sizeof(header), request, requestSize);
+        }
+        slot->frameSize = static_cast<uint8_t>(sizeof(header) + requestSize);
+        if (!commsLink.send(rpc::kChannel, slot->frame, slot->frameSize)) {
+          return false;
+        }
+        slot->id = header.id;
+        slot->opcode = opcode;
+        slot->attempts = 1;
+        slot->firstSentMs = millis();
+        slot->sentMs = slot->firstSentMs;
+        slot->sentUs = micros();
+        slot->timeoutMs = timeoutMs;
+        slot->callback = callback;
+        slot->context = context;
+        slot->active = true;
+        uint8_t active = static_cast<uint8_t>(
+            std::count_if(std::begin(pendingCalls), std::end(pendingCalls),
+                          [](const PendingCall& entry) { return entry.active; }));
+        pendingHighWater = std::max(pendingHighWater, active);
+        return true;
       }
     }
-    ~MutexLock() {
-      if (locked_ && handle_) {
-        xSemaphoreGive(handle_);
-      }
+    // All slots busy: wait for a response or timeout to free one.
+    pumpLink();
+    if ((millis() - start) >= timeoutMs) {
+      return false;
     }
-    bool locked() const { return locked_; }
+    delay(1);
+  }
+}
 
-   private:
-    SemaphoreHandle_t handle_;
-    bool locked_;
-  } lock(rpcMutex);
-  if (!lock.locked()) {
-    if (error) {
-      *error = "Mutex";
-    }
+bool defer(rpc::Opcode opcode, const void* request, size_t requestSize,
+           ResponseCallback callback, void* context) {
+  constexpr size_t kMaxEntrySize = rpc::kMaxPayloadSize - rpc::kBatchEntryHeaderSize;
+  if (requestSize > kMaxEntrySize || (requestSize > 0 && request == nullptr)) {
     return false;
   }
-  String lastError = "Timeout";
-  for (uint8_t attempt = 0; attempt < kMaxCallRetries; ++attempt) {
-    if (payload) {
-      payload->clear();
-    }
-    uint16_t id = nextRequestId++;
-    String line = "REQ|" + String(id) + "|" + String(command);
-    for (const auto& param : params) {
-      line += "|";
-      line += param;
-    }
-    if (attempt > 0 && Serial) {
-      Serial.printf("[COMM] Retrying %s (attempt %u, last error: %s)\n", command,
-                    attempt + 1, lastError.c_str());
-    }
-    if (!sendLine(line)) {
-      lastError = "Send";
-      break;
-    }
+  if (!rpc::isBatchable(opcode)) {
+    return callAsync(opcode, request, requestSize, callback, context);
+  }
+  LinkLock lock;
+  if (openBatch.count == rpc::kMaxBatchCommands ||
+      openBatch.size + rpc::kBatchEntryHeaderSize + requestSize > rpc::kMaxPayloadSize) {
+    flushOpenBatch();
+  }
+  uint8_t* entry = openBatch.payload + openBatch.size;
+  entry[0] = static_cast<uint8_t>(opcode);
+  entry[1] = static_cast<uint8_t>(requestSize);
+  if (requestSize > 0) {
+    memcpy(entry + rpc::kBatchEntryHeaderSize, request, requestSize);
+  }
+  openBatch.size = static_cast<uint8_t>(openBatch.size + rpc::kBatchEntryHeaderSize + requestSize);
+  openBatch.callbacks[openBatch.count++] = BatchedCallback{callback, context};
+  return true;
+}
 
-    uint32_t start = millis();
-    while (true) {
-      uint32_t remaining = 0;
-      if (timeoutMs != 0) {
-        uint32_t elapsed = millis() - start;
-        if (elapsed >= timeoutMs) {
-          lastError = "Timeout";
-          break;
-        }
-        remaining = timeoutMs - elapsed;
-      }
-      String response;
-      if (!readLine(response, remaining)) {
-        lastError = "Timeout";
-        break;
-      }
-      if (response == "READY") {
-        continue;
-      }
-      std::vector<String> fields;
-      splitFields(response, fields);
-      if (fields.empty()) {
-        lastError = "Protocol";
-        continue;
-      }
-      if (fields[0] != "RESP") {
-        lastError = "Protocol";
-        continue;
-      }
-      if (fields.size() < 3) {
-        lastError = "Protocol";
-        continue;
-      }
-      uint16_t respId = static_cast<uint16_t>(fields[1].toInt());
-      if (respId != id) {
-        lastError = "Protocol";
-        continue;
-      }
-      const String& status = fields[2];
-      if (status == "OK") {
-        if (payload) {
-          payload->assign(fields.begin() + 3, fields.end());
-        }
-        return true;
-      }
-      if (fields.size() > 3) {
-        lastError = fields[3];
-      } else {
-        lastError = "Error";
-      }
-      break;
+void flushBatch() {
+  LinkLock lock;
+  flushOpenBatch();
+}
+
+bool call(rpc::Opcode opcode, const void* request, size_t requestSize, void* response,
+          size_t responseSize, rpc::Status* status, uint32_t timeoutMs) {
+  SyncCall pending{false, false, rpc::Status::kOk, response, responseSize};
+  if (!callAsync(opcode, request, requestSize, completeSyncCall, &pending, timeoutMs)) {
+    return false;
+  }
+  // Only this caller waits; other tasks keep issuing requests meanwhile and
+  // whoever pumps the link completes them.
+  while (!pending.done) {
+    pumpLink();
+    if (!pending.done) {
+      delay(1);
     }
+  }
+  if (status) {
+    *status = pending.status;
+  }
+  return pending.success;
+}
 
-    dropPendingInput();
-    if (lastError != "Timeout" && lastError != "Protocol") {
-      break;
+bool readTelemetry(rpc::Telemetry& telemetry) {
+  LinkLock lock;
+  if (!telemetryCache.valid || (millis() - telemetryCache.receivedMs) > kTelemetryMaxAgeMs) {
+    return false;
+  }
+  if (telemetryCache.barrierActive) {
+    if (static_cast<int16_t>(telemetryCache.frame.lastRequestId - telemetryCache.barrierId) < 0) {
+      return false;
     }
-    waitForReady(200);
+    telemetryCache.barrierActive = false;
   }
+  telemetry = telemetryCache.frame;
+  return true;
+}
+
+void invalidateTelemetry() {
+  LinkLock lock;
+  telemetryCache.barrierActive = true;
+  telemetryCache.barrierId = static_cast<uint16_t>(nextRequestId - 1);
+}
+
+void sendEmergencyStop(rpc::StopScope scope) {
+  LinkLock lock;
+  // The stop overtakes everything queued on the main board, so setpoints
+  // still collected for this tick would run after it and restart motion.
+  dropOpenBatch();
+  rpc::EmergencyStop stop{rpc::kVersion, scope, ++stopSequence};
+  stopSentUs = micros();
+  stopAwaitingEcho = true;
+  stopStatistics.sent++;
+  commsLink.sendPriority(reinterpret_cast<const uint8_t*>(&stop), sizeof(stop));
+}
 
-  if (error) {
-    *error = lastError;
+StopStats stopStats() {
+  LinkLock lock;
+  return stopStatistics;
+}
+
+LinkStats linkStats() {
+  LinkLock lock;
+  uint32_t now = millis();
+  if (!remoteLinkStatsPending && (now - remoteLinkStatsRequestedMs) >= kRemoteStatsIntervalMs) {
+    remoteLinkStatsRequestedMs = now;
+    remoteLinkStatsPending =
+        callAsync(rpc::Opcode::kGetLinkStats, nullptr, 0, storeRemoteLinkStats, nullptr);
   }
-  return false;
+  LinkStats stats{};
+  stats.link = commsLink.stats();
+  stats.baud = commsLink.baud();
+  stats.txBytesPerSecond = throughput.txPerSecond;
+  stats.rxBytesPerSecond = throughput.rxPerSecond;
+  stats.pendingHighWater = pendingHighWater;
+  for (const auto& command : commandStatistics) {
+    for (size_t i = 0; i < kRttBucketCount; ++i) {
+      stats.rtt[i] += command.rtt[i];
+    }
+    stats.retries += command.retries;
+    stats.timeouts += command.timeouts;
+  }
+  stats.remoteValid = remoteLinkStatsValid;
+  stats.remote = remoteLinkStats;
+  return stats;
+}
+
+CommandStats commandStats(rpc::Opcode opcode) {
+  LinkLock lock;
+  const CommandStats* stats = statsFor(opcode);
+  return stats ? *stats : CommandStats{};
 }
 
 bool isLinkActive() {
@@ -311,47 +1414,119 @@ bool isLinkActive() {
 
 #elif defined(DEVICE_ROLE_MAIN)
 
-void announceReady() { sendLine("READY"); }
+void announceReady() { sendLine(kReadyLine, sizeof(kReadyLine) - 1); }
 
 bool readRequest(Request& request, uint32_t timeoutMs) {
+  uint32_t start = millis();
   while (true) {
-    String line;
-    if (!readLine(line, timeoutMs)) {
-      return false;
-    }
-    if (line == "READY") {
-      continue;
-    }
-    std::vector<String> fields;
-    splitFields(line, fields);
-    if (fields.empty()) {
-      continue;
-    }
-    if (fields[0] != "REQ") {
-      continue;
+    if (takeRequest(request)) {
+      return true;
     }
-    if (fields.size() < 3) {
-      continue;
+    if (timeoutMs != 0 && (millis() - start) >= timeoutMs) {
+      return false;
     }
-    request.id = static_cast<uint16_t>(fields[1].toInt());
-    request.command = fields[2];
-    request.params.assign(fields.begin() + 3, fields.end());
-    return true;
+    delay(1);
+  }
+}
+
+void sendResponse(const Request& request, rpc::Status status, const void* payload,
+                  size_t size) {
+  if (request.batched) {
+    batchStatus = status;
+    return;
+  }
+  if (size > rpc::kMaxPayloadSize || (size > 0 && payload == nullptr)) {
+    status = rpc::Status::kBadPayload;
+    size = 0;
   }
+  if (!request.binary) {
+    sendAsciiResponse(request, status, static_cast<const uint8_t*>(payload), size);
+    return;
+  }
+  rpc::ResponseHeader header{rpc::kVersion, request.opcode, request.id, status};
+  uint8_t buffer[Comms::kMaxPayloadSize];
+  memcpy(buffer, &header, sizeof(header));
+  if (size > 0) {
+    memcpy(buffer + sizeof(header), payload, size);
+  }
+  LinkLock lock;
+  cacheResponse(request, buffer, sizeof(header) + size);
+  commsLink.send(rpc::kChannel, buffer, sizeof(header) + size);
+}
+
+// The lock keeps the link task from sending between the answer and the switch.
+void switchLinkBaud(const Request& request, uint32_t baud) {
+  LinkLock lock;
+  if (!isLinkBaud(baud)) {
+    sendResponse(request, rpc::Status::kRejected);
+    return;
+  }
+  sendResponse(request, rpc::Status::kOk);
+  commsLink.setBaud(baud);
+  if (Serial) {
+    Serial.printf("[COMM] Link running at %lu baud\n", static_cast<unsigned long>(baud));
+  }
+}
+
+rpc::LinkStats linkStats() {
+  LinkLock lock;
+  Comms::Stats stats = commsLink.stats();
+  rpc::LinkStats result{};
+  result.baud = commsLink.baud();
+  result.crcErrors = stats.crcErrors;
+  result.payloadErrors = stats.payloadErrors;
+  result.retransmits = stats.retransmits;
+  result.duplicatesRx = stats.duplicatesRx;
+  result.deliveryFailures = stats.deliveryFailures;
+  result.replayedRequests = replayedRequests;
+  result.txBytesPerSecond = throughput.txPerSecond;
+  result.rxBytesPerSecond = throughput.rxPerSecond;
+  result.frameQueueHighWater = frameQueueHighWater;
+  result.lineQueueHighWater = lineQueueHighWater;
+  return result;
 }
 
-void sendOk(uint16_t id, std::initializer_list<String> payload) {
-  String line = "RESP|" + String(id) + "|OK";
-  for (const auto& value : payload) {
-    line += "|";
-    line += value;
+void handleBatch(const Request& request, void (*handler)(const Request&)) {
+  uint8_t statuses[1 + rpc::kMaxBatchCommands];
+  uint8_t count = 0;
+  size_t offset = 0;
+  Request command{};
+  command.id = request.id;
+  command.binary = true;
+  command.batched = true;
+  while (offset < request.payloadSize) {
+    if (count == rpc::kMaxBatchCommands ||
+        offset + rpc::kBatchEntryHeaderSize > request.payloadSize ||
+        offset + rpc::kBatchEntryHeaderSize + request.payload[offset + 1] >
+            request.payloadSize) {
+      sendResponse(request, rpc::Status::kBadPayload);
+      return;
+    }
+    command.opcode = static_cast<rpc::Opcode>(request.payload[offset]);
+    command.payloadSize = request.payload[offset + 1];
+    memcpy(command.payload, request.payload + offset + rpc::kBatchEntryHeaderSize,
+           command.payloadSize);
+    offset += rpc::kBatchEntryHeaderSize + command.payloadSize;
+    batchStatus = rpc::Status::kRejected;
+    if (!rpc::isBatchable(command.opcode)) {
+      batchStatus = rpc::Status::kBadPayload;
+    } else {
+      handler(command);
+    }
+    statuses[1 + count++] = static_cast<uint8_t>(batchStatus);
   }
-  sendLine(line);
+  statuses[0] = count;
+  sendResponse(request, rpc::Status::kOk, statuses, 1 + count);
 }
 
-void sendError(uint16_t id, const String& message) {
-  String line = "RESP|" + String(id) + "|ERR|" + message;
-  sendLine(line);
+void setStopHandler(StopHandler handler) { stopHandler = handler; }
+
+void publishTelemetry(rpc::Telemetry& telemetry) {
+  telemetry.version = rpc::kVersion;
+  telemetry.lastRequestId = lastRequestId;
+  LinkLock lock;
+  commsLink.send(rpc::kTelemetryChannel, reinterpret_cast<const uint8_t*>(&telemetry),
+                 sizeof(telemetry));
 }
 
 #endif
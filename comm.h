@@ -2,17 +2,34 @@
 
 #include <Arduino.h>
 
-#include <initializer_list>
-#include <vector>
+#include <cstring>
 
 #include "config.h"
+#include "rpc_protocol.h"
 
 namespace comm {
 
+// Every request reaches the handler as an opcode with its packed payload.
+// binary is false for ASCII lines from HID firmware that predates the binary
+// protocol; those are translated on receipt and answered in ASCII. batched
+// marks a command unpacked from a kBatch request, whose answer is collected
+// into the batch response.
 struct Request {
   uint16_t id;
-  String command;
-  std::vector<String> params;
+  bool binary;
+  bool batched;
+  rpc::Opcode opcode;
+  uint8_t payloadSize;
+  uint8_t payload[rpc::kMaxPayloadSize];
+
+  template <typename T>
+  bool decode(T& out) const {
+    if (payloadSize != sizeof(T)) {
+      return false;
+    }
+    memcpy(&out, payload, sizeof(T));
+    return true;
+  }
 };
 
 void initLink();
@@ -20,16 +37,164 @@ void updateLink();
 
 #if defined(DEVICE_ROLE_HID)
 bool waitForReady(uint32_t timeoutMs);
-bool call(const char* command, std::initializer_list<String> params,
-          std::vector<String>* payload = nullptr, String* error = nullptr,
+
+enum class CallResult : uint8_t {
+  kOk,
+  kRejected,  // The main board answered with an error status.
+  kTimeout,   // No answer after all retransmissions.
+  kCancelled, // Dropped unsent from the open batch by an emergency stop.
+};
+
+// Payload points into the receive buffer and is only valid inside the callback.
+struct Response {
+  CallResult result;
+  rpc::Status status;
+  const uint8_t* payload;
+  size_t size;
+};
+
+using ResponseCallback = void (*)(const Response& response, void* context);
+
+// Queues a request without waiting for its answer. Up to six requests can be
+// in flight; responses are matched by request id and the callback runs from
+// whichever task pumps the link next (updateLink or a waiting call). Blocks
+// only while the pending table is full. Returns false if nothing was sent.
+bool callAsync(rpc::Opcode opcode, const void* request, size_t requestSize,
+               ResponseCallback callback = nullptr, void* context = nullptr,
+               uint32_t timeoutMs = config::COMM_RESPONSE_TIMEOUT_MS);
+
+template <typename Req>
+bool callAsync(rpc::Opcode opcode, const Req& request, ResponseCallback callback,
+               void* context) {
+  return callAsync(opcode, &request, sizeof(Req), callback, context);
+}
+
+// Collects a setter for the next flushBatch(), which sends everything
+// collected as a single kBatch frame. Any other request flushes first, so
+// commands still reach the main board in call order. The callback gets the
+// command's own status. Opcodes rpc::isBatchable() refuses go out at once.
+bool defer(rpc::Opcode opcode, const void* request, size_t requestSize,
+           ResponseCallback callback = nullptr, void* context = nullptr);
+
+template <typename Req>
+bool defer(rpc::Opcode opcode, const Req& request, ResponseCallback callback, void* context) {
+  return defer(opcode, &request, sizeof(Req), callback, context);
+}
+
+void flushBatch();
+
+// Sends a binary request and waits for its response. responseSize must match
+// the payload the main board returns; status receives the remote status when
+// the main board rejected the request.
+bool call(rpc::Opcode opcode, const void* request, size_t requestSize, void* response,
+          size_t responseSize, rpc::Status* status = nullptr,
           uint32_t timeoutMs = config::COMM_RESPONSE_TIMEOUT_MS);
+
+inline bool call(rpc::Opcode opcode) { return call(opcode, nullptr, 0, nullptr, 0); }
+
+template <typename Req>
+bool call(rpc::Opcode opcode, const Req& request) {
+  return call(opcode, &request, sizeof(Req), nullptr, 0);
+}
+
+template <typename Req, typename Resp>
+bool call(rpc::Opcode opcode, const Req& request, Resp& response) {
+  return call(opcode, &request, sizeof(Req), &response, sizeof(Resp));
+}
+
+template <typename Resp>
+bool query(rpc::Opcode opcode, Resp& response) {
+  return call(opcode, nullptr, 0, &response, sizeof(Resp));
+}
+
+// Latest telemetry pushed by the main board. Returns false when no frame
+// arrived recently or the newest one predates the request that was last sent
+// before invalidateTelemetry(); callers then poll instead.
+bool readTelemetry(rpc::Telemetry& telemetry);
+void invalidateTelemetry();
+
+// Stops motion on the main board ahead of any queued request, without
+// waiting for the request it is handling at that moment. Setpoints still in
+// the open batch are dropped with kCancelled rather than sent, since they
+// would run after the stop. The frame is not retransmitted, so callers still
+// post the matching regular request.
+void sendEmergencyStop(rpc::StopScope scope);
+
+// Round trip from sendEmergencyStop to the main board's echo: an upper bound
+// on the time until its rates were zeroed.
+struct StopStats {
+  uint32_t sent;
+  uint32_t echoed;
+  uint32_t lastLatencyUs;
+  uint32_t maxLatencyUs;
+};
+
+StopStats stopStats();
+
 bool isLinkActive();
+
+// RTT histogram buckets, upper bounds in microseconds; the last bucket
+// collects everything slower.
+constexpr size_t kRttBucketCount = 8;
+constexpr uint32_t kRttBucketLimitsUs[kRttBucketCount - 1] = {500,   1000,  2000, 5000,
+                                                              10000, 20000, 50000};
+
+// Per opcode. rtt is measured from the last (re)transmission to the answer.
+struct CommandStats {
+  uint16_t rtt[kRttBucketCount];
+  uint16_t retries;
+  uint16_t timeouts;
+};
+
+struct LinkStats {
+  Comms::Stats link;
+  uint32_t baud;
+  uint32_t txBytesPerSecond;
+  uint32_t rxBytesPerSecond;
+  uint8_t pendingHighWater;
+  uint32_t rtt[kRttBucketCount];  // Summed over all opcodes.
+  uint32_t retries;
+  uint32_t timeouts;
+  bool remoteValid;
+  rpc::LinkStats remote;
+};
+
+// This board's counters plus the main board's last kGetLinkStats answer,
+// which is refreshed in the background at most once a second.
+LinkStats linkStats();
+CommandStats commandStats(rpc::Opcode opcode);
 #elif defined(DEVICE_ROLE_MAIN)
 void announceReady();
+// Takes the next queued request. The queues are filled by updateLink(), which
+// the main board runs in its own task.
 bool readRequest(Request& request,
                  uint32_t timeoutMs = config::COMM_RESPONSE_TIMEOUT_MS);
-void sendOk(uint16_t id, std::initializer_list<String> payload = {});
-void sendError(uint16_t id, const String& message);
+void sendResponse(const Request& request, rpc::Status status, const void* payload = nullptr,
+                  size_t size = 0);
+
+template <typename T>
+void sendResponse(const Request& request, const T& payload) {
+  sendResponse(request, rpc::Status::kOk, &payload, sizeof(T));
+}
+
+// Runs handler on every command packed into a kBatch request, in order, and
+// answers with their statuses.
+void handleBatch(const Request& request, void (*handler)(const Request&));
+
+// Counters for the kGetLinkStats answer.
+rpc::LinkStats linkStats();
+
+// Fills in version and lastRequestId and pushes the frame.
+void publishTelemetry(rpc::Telemetry& telemetry);
+
+// Answers a kSetLinkBaud request and switches the UART once the answer is on
+// the wire. Rates other than COMM_BAUD and COMM_FAST_BAUDS are rejected.
+void switchLinkBaud(const Request& request, uint32_t baud);
+
+// Called for emergency stops from the receive path in the link task, while
+// the command task may still be inside a request handler.
+using StopHandler = void (*)(rpc::StopScope scope);
+void setStopHandler(StopHandler handler);
 #endif
 
 }  // namespace comm
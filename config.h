@@ -51,8 +51,13 @@ constexpr uint8_t COMM_RX_PIN = 16;
 #error "Unsupported device role"
 #endif
 
+// Both boards start at COMM_BAUD; after READY the HID negotiates the first
+// of COMM_FAST_BAUDS (highest first) that runs without CRC errors.
 constexpr uint32_t COMM_BAUD = 115200;
-constexpr uint32_t COMM_RESPONSE_TIMEOUT_MS = 200;
+constexpr uint32_t COMM_FAST_BAUDS[] = {2000000, 921600, 460800};
+constexpr uint32_t COMM_RESPONSE_TIMEOUT_MS = 120;
+// Main board telemetry push rate (20-50 Hz)
+constexpr uint32_t TELEMETRY_RATE_HZ = 25;
 constexpr uint32_t USB_DEBUG_BAUD = 115200;
 
 // Motion configuration
@@ -64,6 +69,13 @@ constexpr float GEAR_RATIO = 4.0f; // 1:4 reduction motor:telescope
 constexpr float JOYSTICK_DEADZONE = 0.03f;
 constexpr int JOYSTICK_X_DIRECTION = 1;  // Use -1 to invert the azimuth axis
 constexpr int JOYSTICK_Y_DIRECTION = 1;  // Use -1 to invert the altitude axis
+// Tracking: send short-horizon position fits to the main board (true) or
+// stream proportional rate corrections from the HID (false)
+constexpr bool TRACKING_POLYNOMIAL_FEED = true;
+// Astronomy: run sidereal time, coordinate transforms and planet positions in
+// float on fixed-point time (true) or in double (false). The ESP32 FPU is
+// single precision; the float kernel stays well below one microstep (~10").
+constexpr bool ASTRONOMY_FLOAT_KERNEL = true;
 
 // Display configuration
 constexpr uint8_t OLED_WIDTH = 128;
@@ -14,12 +14,15 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 
+#include "astronomy.h"
 #include "catalog.h"
 #include "comm.h"
 #include "config.h"
 #include "input.h"
 #include "motion.h"
+#include "motion_profile.h"
 #include "planets.h"
+#include "sky_clock.h"
 #include "state.h"
 #include "storage.h"
 #include "text_utils.h"
@@ -87,38 +90,19 @@ struct AxisCalibrationState {
 
 AxisCalibrationState axisCal{0, 0, 0, 0, 0};
 
-struct GotoProfileSteps {
-  double maxSpeedAz;
-  double accelerationAz;
-  double decelerationAz;
-  double maxSpeedAlt;
-  double accelerationAlt;
-  double decelerationAlt;
-};
-
-struct AxisGotoRuntime {
-  int64_t finalTarget;
-  int64_t compensatedTarget;
-  double currentSpeed;
-  int8_t desiredDirection;
-  bool compensationPending;
-  bool reachedFinalTarget;
-};
-
 struct GotoRuntimeState {
   bool active;
-  AxisGotoRuntime az;
-  AxisGotoRuntime alt;
-  GotoProfileSteps profile;
   double estimatedDurationSec;
-  uint32_t lastUpdateMs;
-  DateTime startTime;
+  uint32_t lastPollMs;
+  int64_t startTime;  // microseconds since J2000
   double targetRaHours;
   double targetDecDegrees;
   int targetCatalogIndex;
   bool resumeTracking;
 };
 
+constexpr uint32_t kGotoPollIntervalMs = 100;
+
 struct TrackingState {
   bool active;
   double targetRaHours;
@@ -130,12 +114,9 @@ struct TrackingState {
 };
 
 GotoRuntimeState gotoRuntime{false,
-                             {0, 0, 0.0, 0, false, false},
-                             {0, 0, 0.0, 0, false, false},
-                             {0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
                              0.0,
                              0,
-                             DateTime(),
+                             0,
                              0.0,
                              0.0,
                              -1,
@@ -143,6 +124,27 @@ GotoRuntimeState gotoRuntime{false,
 
 TrackingState tracking{false, 0.0, 0.0, -1, 0.0, 0.0, false};
 
+// Polynomial tracking feed: a cubic through four samples spanning the
+// horizon, refreshed well before the main board runs past its end.
+constexpr uint32_t kTrackingFeedHorizonSec = 30;
+constexpr uint32_t kTrackingFeedRefreshMs = 10000;
+
+struct TrackingFeedState {
+  bool sent;
+  bool refreshPending;
+  uint32_t lastSentMs;
+};
+
+TrackingFeedState trackingFeed{false, true, 0};
+
+// Rate tracking: the target's own alt/az rate is sent as feed-forward and
+// the proportional term only trims the residual, so updates can be sparse.
+constexpr double kTrackingGain = 0.4;
+constexpr double kMaxTrackingSpeed = 3.0;
+constexpr int32_t kFeedForwardHalfSpanSec = 30;
+constexpr uint32_t kTrackingRateRefreshMs = 1000;
+uint32_t trackingRateSentMs = 0;
+
 enum class SpeedEditMode { Goto, Panning };
 
 struct SpeedProfileState {
@@ -199,6 +201,8 @@ String gotoTargetName;
 
 int mainMenuIndex = 0;
 int mainMenuScroll = 0;
+// Status details: 0 = mount state, 1 = link diagnostics.
+int statusDetailsPage = 0;
 constexpr const char* kMainMenuItems[] = {"Status",
                                           "Polar Align",
                                           "Start Tracking",
@@ -282,9 +286,8 @@ void drawHeader() {
   display.setTextColor(SSD1306_WHITE);
   display.setCursor(0, 0);
   display.print("NERDSTAR");
-  if (rtcAvailable) {
-    time_t utcEpoch = rtc.now().unixtime();
-    DateTime now = time_utils::applyTimezone(utcEpoch);
+  if (sky_clock::status().source != sky_clock::Source::None) {
+    DateTime now = time_utils::applyTimezone(sky_clock::nowUtcEpoch());
     char buffer[20];
     snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", now.hour(), now.minute(), now.second());
     int16_t x1, y1;
@@ -429,188 +432,160 @@ bool fetchInfoMessage(String& message) {
   return active;
 }
 
-double degToRad(double degrees) { return degrees * DEG_TO_RAD; }
-
-double radToDeg(double radians) { return radians * RAD_TO_DEG; }
-
-double wrapAngle360(double degrees) {
-  double wrapped = fmod(degrees, 360.0);
-  if (wrapped < 0.0) wrapped += 360.0;
-  return wrapped;
-}
-
-double wrapAngle180(double degrees) {
-  double wrapped = fmod(degrees + 180.0, 360.0);
-  if (wrapped < 0.0) wrapped += 360.0;
-  return wrapped - 180.0;
-}
+using astronomy::altAzToRaDec;
+using astronomy::getObjectRaDecAt;
+using astronomy::raDecToAltAz;
+using astronomy::wrapAngle180;
+using astronomy::wrapAngle360;
 
 double shortestAngularDistance(double from, double to) {
   double diff = wrapAngle180(to - from);
   return diff;
 }
 
-double applyAtmosphericRefraction(double geometricAltitudeDeg) {
-  if (geometricAltitudeDeg < -1.0 || geometricAltitudeDeg > 90.0) {
-    return geometricAltitudeDeg;
+// Local wall-clock time from the sky clock, without touching the bus.
+DateTime currentDateTime() {
+  if (sky_clock::status().source == sky_clock::Source::None) {
+    return DateTime(2024, 1, 1, 0, 0, 0);
   }
+  return time_utils::applyTimezone(sky_clock::nowUtcEpoch());
+}
 
-  double altitudeWithOffset =
-      geometricAltitudeDeg + 10.3 / (geometricAltitudeDeg + 5.11);
-  double refractionArcMinutes =
-      1.02 / tan(degToRad(altitudeWithOffset));
-  return geometricAltitudeDeg + refractionArcMinutes / 60.0;
+// Timestamp for the astronomy entry points: sub-millisecond and monotonic.
+int64_t currentSkyTime() {
+  if (sky_clock::status().source == sky_clock::Source::None) {
+    return astro_time::microsSinceJ2000(time_utils::toUtcEpoch(DateTime(2024, 1, 1, 0, 0, 0)));
+  }
+  return sky_clock::nowMicrosSinceJ2000();
 }
 
-DateTime currentDateTime() {
-  const SystemConfig& config = storage::getConfig();
+bool readRtcSeconds(time_t& utcEpoch) {
+  if (!rtcAvailable) {
+    return false;
+  }
+  MutexLock lock(i2cMutex);
+  if (!lock.locked()) {
+    return false;
+  }
+  utcEpoch = static_cast<time_t>(rtc.now().unixtime());
+  return true;
+}
+
+// Called by the sky clock just after a second boundary: the DS3231 restarts
+// its second when the seconds register is written.
+bool writeRtcSeconds(time_t utcEpoch) {
   if (rtcAvailable) {
     MutexLock lock(i2cMutex);
-    if (lock.locked()) {
-      time_t utcEpoch = rtc.now().unixtime();
-      return time_utils::applyTimezone(utcEpoch);
+    if (!lock.locked()) {
+      return false;
     }
+    rtc.adjust(DateTime(utcEpoch));
   }
-  if (config.lastRtcEpoch != 0) {
-    return time_utils::applyTimezone(static_cast<time_t>(config.lastRtcEpoch));
-  }
-  return DateTime(2024, 1, 1, 0, 0, 0);
-}
-
-DateTime toUtc(const DateTime& local) {
-  time_t epoch = time_utils::toUtcEpoch(local);
-  return DateTime(epoch);
-}
-
-double hourFraction(const DateTime& time) {
-  return time.hour() + time.minute() / 60.0 + time.second() / 3600.0;
-}
-
-double localSiderealDegrees(const DateTime& time) {
-  DateTime utc = toUtc(time);
-  double jd = planets::julianDay(utc.year(), utc.month(), utc.day(), hourFraction(utc));
-  double T = (jd - 2451545.0) / 36525.0;
-  double lst = 280.46061837 + 360.98564736629 * (jd - 2451545.0) +
-               0.000387933 * T * T - (T * T * T) / 38710000.0 +
-               storage::getConfig().observerLongitudeDeg;
-  return wrapAngle360(lst);
-}
-
-void getObjectRaDecAt(const CatalogObject& object,
-                      const DateTime& when,
-                      double secondsAhead,
-                      double& raHours,
-                      double& decDegrees,
-                      DateTime* futureTime) {
-  DateTime future = when + TimeSpan(0, 0, 0, static_cast<int32_t>(secondsAhead));
-  double fractional = secondsAhead - floor(secondsAhead);
-  raHours = object.raHours;
-  decDegrees = object.decDegrees;
-
-  if (futureTime) {
-    *futureTime = future;
-  }
-
-  PlanetId planetId;
-  if (object.type.equalsIgnoreCase("planet") &&
-      planets::planetFromString(object.name, planetId)) {
-    DateTime futureUtc = toUtc(future);
-    double jd = planets::julianDay(
-        futureUtc.year(), futureUtc.month(), futureUtc.day(), hourFraction(futureUtc) + fractional / 3600.0);
-    PlanetPosition position;
-    if (planets::computePlanet(planetId, jd, position)) {
-      raHours = position.raHours;
-      decDegrees = position.decDegrees;
-    }
-  }
-}
-
-bool raDecToAltAz(const DateTime& when,
-                  double raHours,
-                  double decDegrees,
-                  double& azimuthDeg,
-                  double& altitudeDeg) {
-  double lstDeg = localSiderealDegrees(when);
-  double raDeg = raHours * 15.0;
-  double haDeg = wrapAngle180(lstDeg - raDeg);
-  double latRad = degToRad(storage::getConfig().observerLatitudeDeg);
-  double haRad = degToRad(haDeg);
-  double decRad = degToRad(decDegrees);
-
-  double sinAlt = sin(decRad) * sin(latRad) + cos(decRad) * cos(latRad) * cos(haRad);
-  sinAlt = std::clamp(sinAlt, -1.0, 1.0);
-  double geometricAltitudeDeg = radToDeg(asin(sinAlt));
-
-  double cosAz = (sin(decRad) - sinAlt * sin(latRad)) /
-                 (cos(degToRad(geometricAltitudeDeg)) * cos(latRad));
-  cosAz = std::clamp(cosAz, -1.0, 1.0);
-  double azRad = acos(cosAz);
-  if (sin(haRad) > 0) {
-    azRad = 2 * PI - azRad;
-  }
-  azimuthDeg = wrapAngle360(radToDeg(azRad));
-  altitudeDeg = applyAtmosphericRefraction(geometricAltitudeDeg);
-  return altitudeDeg > -5.0;  // allow slight tolerance below horizon
-}
-
-bool altAzToRaDec(const DateTime& when,
-                  double azimuthDeg,
-                  double altitudeDeg,
-                  double& raHours,
-                  double& decDegrees) {
-  double lstDeg = localSiderealDegrees(when);
-  double latRad = degToRad(storage::getConfig().observerLatitudeDeg);
-  double altRad = degToRad(altitudeDeg);
-  double azRad = degToRad(azimuthDeg);
-
-  double sinDec = sin(altRad) * sin(latRad) + cos(altRad) * cos(latRad) * cos(azRad);
-  sinDec = std::clamp(sinDec, -1.0, 1.0);
-  double decRad = asin(sinDec);
-
-  double sinHa = -sin(azRad) * cos(altRad);
-  double cosHa = cos(altRad) * sin(latRad) - sin(altRad) * cos(latRad) * cos(azRad);
-  double haRad = atan2(sinHa, cosHa);
-  double haDeg = wrapAngle180(radToDeg(haRad));
-
-  double raDeg = wrapAngle360(lstDeg - haDeg);
-  raHours = raDeg / 15.0;
-  decDegrees = radToDeg(decRad);
+  storage::setRtcEpoch(static_cast<uint32_t>(utcEpoch));
   return true;
 }
 
-GotoProfileSteps toProfileSteps(const GotoProfile& profile, const AxisCalibration& cal) {
-  GotoProfileSteps result{};
-  result.maxSpeedAz = profile.maxSpeedDegPerSec * cal.stepsPerDegreeAz;
-  result.accelerationAz = profile.accelerationDegPerSec2 * cal.stepsPerDegreeAz;
-  result.decelerationAz = profile.decelerationDegPerSec2 * cal.stepsPerDegreeAz;
-  result.maxSpeedAlt = profile.maxSpeedDegPerSec * cal.stepsPerDegreeAlt;
-  result.accelerationAlt = profile.accelerationDegPerSec2 * cal.stepsPerDegreeAlt;
-  result.decelerationAlt = profile.decelerationDegPerSec2 * cal.stepsPerDegreeAlt;
-  return result;
+// storage::init() runs after init(), so the stored epoch seeds the clock on
+// the first pass. The bus is held across a capture so display refreshes do
+// not widen the bracketing reads.
+void serviceSkyClock() {
+  static bool seeded = false;
+  if (!seeded) {
+    seeded = true;
+    uint32_t stored = storage::getConfig().lastRtcEpoch;
+    if (stored != 0 && sky_clock::status().source == sky_clock::Source::None) {
+      sky_clock::set(static_cast<time_t>(stored), sky_clock::Source::Stored);
+    }
+  }
+  if (!sky_clock::captureDue()) {
+    return;
+  }
+  MutexLock lock(i2cMutex);
+  if (lock.locked()) {
+    sky_clock::update();
+  }
 }
 
-double computeTravelTimeSteps(double distanceSteps,
-                              double maxSpeed,
-                              double accel,
-                              double decel) {
-  double distance = fabs(distanceSteps);
-  if (distance < 1.0) {
-    return 0.0;
+// "<0.5", ">50": bucket limits are whole tenths of a millisecond and at most
+// 50 ms, so a label is no longer than five characters.
+static_assert(comm::kRttBucketLimitsUs[comm::kRttBucketCount - 2] < 100000,
+              "RTT labels are sized for limits below 100 ms");
+
+void formatRttLimit(char relation, uint32_t limitUs, char* buffer, size_t size) {
+  unsigned tenths = static_cast<unsigned>(limitUs / 100) % 1000;
+  if (tenths % 10 == 0) {
+    snprintf(buffer, size, "%c%u", relation, tenths / 10);
+  } else {
+    snprintf(buffer, size, "%c%u.%u", relation, tenths / 10, tenths % 10);
   }
-  maxSpeed = std::max(maxSpeed, 1.0);
-  accel = std::max(accel, 1.0);
-  decel = std::max(decel, 1.0);
-  double distAccel = (maxSpeed * maxSpeed) / (2.0 * accel);
-  double distDecel = (maxSpeed * maxSpeed) / (2.0 * decel);
-  if (distance >= distAccel + distDecel) {
-    double cruise = distance - distAccel - distDecel;
-    return maxSpeed / accel + maxSpeed / decel + cruise / maxSpeed;
+}
+
+// Upper bound of the RTT bucket holding the given percentile, in ms.
+void formatRttPercentile(const comm::LinkStats& stats, uint32_t percent, char* buffer,
+                         size_t size) {
+  uint32_t total = 0;
+  for (uint32_t count : stats.rtt) {
+    total += count;
+  }
+  if (total == 0) {
+    snprintf(buffer, size, "-");
+    return;
+  }
+  uint32_t threshold = (total * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (size_t i = 0; i < comm::kRttBucketCount - 1; ++i) {
+    seen += stats.rtt[i];
+    if (seen >= threshold) {
+      formatRttLimit('<', comm::kRttBucketLimitsUs[i], buffer, size);
+      return;
+    }
+  }
+  formatRttLimit('>', comm::kRttBucketLimitsUs[comm::kRttBucketCount - 2], buffer, size);
+}
+
+void drawLinkStats() {
+  comm::LinkStats stats = comm::linkStats();
+  comm::StopStats stop = comm::stopStats();
+  char p50[8];
+  char p95[8];
+  formatRttPercentile(stats, 50, p50, sizeof(p50));
+  formatRttPercentile(stats, 95, p95, sizeof(p95));
+
+  constexpr int kStatusTop = 10;
+  int row = 0;
+  auto nextLine = [&]() { display.setCursor(0, lineY(kStatusTop, row++)); };
+  nextLine();
+  display.printf("Baud %lu Pend %u", static_cast<unsigned long>(stats.baud),
+                 stats.pendingHighWater);
+  nextLine();
+  display.printf("I/O %.1f/%.1f kB/s", stats.txBytesPerSecond / 1000.0,
+                 stats.rxBytesPerSecond / 1000.0);
+  nextLine();
+  display.printf("RTT p50%s p95%sms", p50, p95);
+  nextLine();
+  display.printf("Rtry %lu TO %lu Rtx %lu", static_cast<unsigned long>(stats.retries),
+                 static_cast<unsigned long>(stats.timeouts),
+                 static_cast<unsigned long>(stats.link.retransmits));
+  nextLine();
+  if (stats.remoteValid) {
+    display.printf("CRC %lu/%lu Q %u/%u", static_cast<unsigned long>(stats.link.crcErrors),
+                   static_cast<unsigned long>(stats.remote.crcErrors),
+                   stats.remote.frameQueueHighWater, stats.remote.lineQueueHighWater);
+  } else {
+    display.printf("CRC %lu Main: -", static_cast<unsigned long>(stats.link.crcErrors));
   }
-  double peakSpeed = sqrt((2.0 * distance * accel * decel) / (accel + decel));
-  return peakSpeed / accel + peakSpeed / decel;
+  nextLine();
+  display.printf("Stop %.1f max %.1fms", stop.lastLatencyUs / 1000.0,
+                 stop.maxLatencyUs / 1000.0);
+  nextLine();
+  display.print("Turn=Page Joy=Close");
 }
 
 void drawStatus(bool diagnostics) {
+  if (diagnostics && statusDetailsPage == 1) {
+    drawLinkStats();
+    return;
+  }
   double azDeg = 0.0;
   double altDeg = 0.0;
   if (orientationKnown) {
@@ -1047,7 +1022,7 @@ void drawCatalogItemDetail() {
   display.setCursor(90, 10);
   display.printf("%d/%d", catalogTypeObjectIndex + 1, localCount);
 
-  DateTime now = currentDateTime();
+  int64_t now = currentSkyTime();
   double ra;
   double dec;
   getObjectRaDecAt(*object, now, 0.0, ra, dec, nullptr);
@@ -1663,23 +1638,7 @@ void enterSetupMenu() {
 }
 
 void enterRtcEditor() {
-  DateTime now;
-  const SystemConfig& config = storage::getConfig();
-  if (rtcAvailable) {
-    MutexLock lock(i2cMutex);
-    if (lock.locked()) {
-      time_t utcEpoch = rtc.now().unixtime();
-      now = time_utils::applyTimezone(utcEpoch);
-    } else if (config.lastRtcEpoch != 0) {
-      now = time_utils::applyTimezone(static_cast<time_t>(config.lastRtcEpoch));
-    } else {
-      now = DateTime(2024, 1, 1, 0, 0, 0);
-    }
-  } else if (config.lastRtcEpoch != 0) {
-    now = time_utils::applyTimezone(static_cast<time_t>(config.lastRtcEpoch));
-  } else {
-    now = DateTime(2024, 1, 1, 0, 0, 0);
-  }
+  DateTime now = currentDateTime();
   rtcEdit = {now.year(),      now.month(),      now.day(),
              now.hour(),      now.minute(),     now.second(),
              storage::getConfig().dstMode, 0, 0};
@@ -1696,6 +1655,7 @@ void applyRtcEdit() {
       rtc.adjust(DateTime(utcEpoch));
     }
   }
+  sky_clock::set(utcEpoch, sky_clock::Source::Manual);
   storage::setDstMode(rtcEdit.dstMode);
   storage::setRtcEpoch(static_cast<uint32_t>(utcEpoch));
   showInfo("RTC updated");
@@ -1764,105 +1724,28 @@ void handleAxisCalibrationClick() {
   }
 }
 
-AxisGotoRuntime initAxisRuntime(Axis axis, int64_t targetSteps) {
-  AxisGotoRuntime runtime{};
-  runtime.finalTarget = targetSteps;
-  runtime.compensatedTarget = targetSteps;
-  runtime.currentSpeed = 0.0;
-  runtime.desiredDirection = 0;
-  runtime.compensationPending = false;
-  runtime.reachedFinalTarget = false;
-
-  int64_t current = motion::getStepCount(axis);
-  int64_t diff = targetSteps - current;
-  if (diff == 0) {
-    runtime.reachedFinalTarget = true;
-    return runtime;
-  }
-
-  runtime.desiredDirection = diff >= 0 ? 1 : -1;
-  int8_t lastDir = motion::getLastDirection(axis);
-  int32_t backlash = motion::getBacklashSteps(axis);
-  if (backlash > 0 && lastDir != 0 && lastDir != runtime.desiredDirection) {
-    runtime.compensatedTarget = targetSteps + runtime.desiredDirection * backlash;
-    runtime.compensationPending = true;
-  }
-  return runtime;
-}
-
-bool updateAxisGoto(Axis axis,
-                    AxisGotoRuntime& runtime,
-                    double dt,
-                    const GotoProfileSteps& profile) {
-  if (runtime.reachedFinalTarget) {
-    motion::setGotoStepsPerSecond(axis, 0.0);
-    return true;
-  }
-
-  int64_t current = motion::getStepCount(axis);
-  int64_t error = runtime.compensatedTarget - current;
-  double absError = fabs(static_cast<double>(error));
-  double direction = (error >= 0) ? 1.0 : -1.0;
-
-  double maxSpeed = std::max(axis == Axis::Az ? profile.maxSpeedAz : profile.maxSpeedAlt, 1.0);
-  double accel = std::max(axis == Axis::Az ? profile.accelerationAz : profile.accelerationAlt, 1.0);
-  double decel = std::max(axis == Axis::Az ? profile.decelerationAz : profile.decelerationAlt, 1.0);
-
-  double speed = runtime.currentSpeed;
-  double distanceToStop = (speed * speed) / (2.0 * decel);
-
-  if (absError <= 1.0 && speed < 1.0) {
-    motion::setGotoStepsPerSecond(axis, 0.0);
-    if (runtime.compensationPending) {
-      runtime.compensationPending = false;
-      runtime.compensatedTarget = runtime.finalTarget;
-      runtime.currentSpeed = 0.0;
-      return false;
-    }
-    runtime.reachedFinalTarget = true;
-    return true;
-  }
-
-  if (absError <= distanceToStop + 1.0) {
-    speed -= decel * dt;
-    if (speed < 0.0) speed = 0.0;
-  } else {
-    speed += accel * dt;
-    if (speed > maxSpeed) speed = maxSpeed;
-  }
-
-  if (speed < 1.0 && absError > 2.0) {
-    speed = std::min(maxSpeed, speed + accel * dt);
-  }
-
-  double commanded = speed * direction;
-  motion::setGotoStepsPerSecond(axis, commanded);
-  runtime.currentSpeed = speed;
-  return false;
-}
-
 bool computeTargetAltAz(const CatalogObject& object,
-                        const DateTime& start,
+                        int64_t start,
                         double secondsAhead,
                         double& raHours,
                         double& decDegrees,
                         double& azDeg,
                         double& altDeg,
-                        DateTime& targetTime) {
+                        int64_t& targetTime) {
   getObjectRaDecAt(object, start, secondsAhead, raHours, decDegrees, &targetTime);
   return raDecToAltAz(targetTime, raHours, decDegrees, azDeg, altDeg);
 }
 
 bool computeManualTarget(double raHours,
                          double decDegrees,
-                         const DateTime& start,
+                         int64_t start,
                          double secondsAhead,
                          double& outRaHours,
                          double& outDecDegrees,
                          double& azDeg,
                          double& altDeg,
-                         DateTime& targetTime) {
-  targetTime = start + TimeSpan(0, 0, 0, static_cast<int32_t>(secondsAhead));
+                         int64_t& targetTime) {
+  targetTime = start + llround(secondsAhead * astro_time::kMicrosPerSecond);
   outRaHours = raHours;
   outDecDegrees = decDegrees;
   return raDecToAltAz(targetTime, raHours, decDegrees, azDeg, altDeg);
@@ -1884,7 +1767,7 @@ bool planGotoTarget(const String& targetName, int targetCatalogIndex, ComputeFn
     abortGoto();
   }
 
-  DateTime now = currentDateTime();
+  int64_t now = currentSkyTime();
   double currentAz = motion::stepsToAzDegrees(motion::getStepCount(Axis::Az));
   double currentAlt = motion::stepsToAltDegrees(motion::getStepCount(Axis::Alt));
 
@@ -1892,27 +1775,29 @@ bool planGotoTarget(const String& targetName, int targetCatalogIndex, ComputeFn
   double decNow;
   double azNow;
   double altNow;
-  DateTime timeNow;
+  int64_t timeNow;
   if (!computeTarget(now, 0.0, raNow, decNow, azNow, altNow, timeNow) ||
       altNow < motion::getMinAltitudeDegrees()) {
     showInfo("Below horizon");
     return false;
   }
 
-  GotoProfileSteps profile = toProfileSteps(storage::getConfig().gotoProfile, cal);
+  // Coordinated moves end both axes at the slower axis' travel time, so that
+  // is the arrival instant used for the lead-time calculation.
+  const GotoProfile& gotoProfile = storage::getConfig().gotoProfile;
+  motion_profile::AxisLimits azLimits = motion_profile::toAxisLimits(gotoProfile, cal.stepsPerDegreeAz);
+  motion_profile::AxisLimits altLimits = motion_profile::toAxisLimits(gotoProfile, cal.stepsPerDegreeAlt);
   double azDiffNow = shortestAngularDistance(currentAz, azNow) * cal.stepsPerDegreeAz;
   double altDiffNow = (altNow - currentAlt) * cal.stepsPerDegreeAlt;
-  double durationAz =
-      computeTravelTimeSteps(azDiffNow, profile.maxSpeedAz, profile.accelerationAz, profile.decelerationAz);
-  double durationAlt =
-      computeTravelTimeSteps(altDiffNow, profile.maxSpeedAlt, profile.accelerationAlt, profile.decelerationAlt);
+  double durationAz = motion_profile::computeTravelTimeSteps(azDiffNow, azLimits);
+  double durationAlt = motion_profile::computeTravelTimeSteps(altDiffNow, altLimits);
   double estimatedDuration = std::max(durationAz, durationAlt) + 1.0;
 
   double raFuture;
   double decFuture;
   double azFuture;
   double altFuture;
-  DateTime arrivalTime;
+  int64_t arrivalTime;
   if (!computeTarget(now, estimatedDuration, raFuture, decFuture, azFuture, altFuture, arrivalTime) ||
       altFuture < motion::getMinAltitudeDegrees()) {
     showInfo("Below horizon");
@@ -1927,18 +1812,20 @@ bool planGotoTarget(const String& targetName, int targetCatalogIndex, ComputeFn
       std::clamp(altFuture, motion::getMinAltitudeDegrees(), motion::getMaxAltitudeDegrees());
   int64_t targetAltSteps = motion::altDegreesToSteps(clampedAltFuture);
 
+  // A rejected move keeps tracking running; only a started goto replaces it.
+  if (!motion::moveTo(targetAzSteps, targetAltSteps, gotoProfile, MoveMode::Coordinated)) {
+    showInfo("Goto failed");
+    return false;
+  }
+  stopTracking();
+
   gotoRuntime.active = true;
-  gotoRuntime.az = initAxisRuntime(Axis::Az, targetAzSteps);
-  gotoRuntime.alt = initAxisRuntime(Axis::Alt, targetAltSteps);
-  gotoRuntime.profile = profile;
   double azDiffRemaining = static_cast<double>(targetAzSteps - currentAzSteps);
   double altDiffRemaining = static_cast<double>(targetAltSteps - currentAltSteps);
-  double durationAzFuture =
-      computeTravelTimeSteps(azDiffRemaining, profile.maxSpeedAz, profile.accelerationAz, profile.decelerationAz);
-  double durationAltFuture =
-      computeTravelTimeSteps(altDiffRemaining, profile.maxSpeedAlt, profile.accelerationAlt, profile.decelerationAlt);
+  double durationAzFuture = motion_profile::computeTravelTimeSteps(azDiffRemaining, azLimits);
+  double durationAltFuture = motion_profile::computeTravelTimeSteps(altDiffRemaining, altLimits);
   gotoRuntime.estimatedDurationSec = std::max(durationAzFuture, durationAltFuture) + 1.0;
-  gotoRuntime.lastUpdateMs = millis();
+  gotoRuntime.lastPollMs = millis();
   gotoRuntime.startTime = now;
   gotoRuntime.targetRaHours = raFuture;
   gotoRuntime.targetDecDegrees = decFuture;
@@ -1949,8 +1836,6 @@ bool planGotoTarget(const String& targetName, int targetCatalogIndex, ComputeFn
   systemState.azGotoTarget = targetAzSteps;
   systemState.altGotoTarget = targetAltSteps;
   gotoTargetName = sanitizeForDisplay(targetName);
-  motion::clearGotoRates();
-  stopTracking();
   showInfo("Goto started");
   return true;
 }
@@ -1967,12 +1852,13 @@ void finalizeTrackingTarget(int catalogIndex,
   tracking.offsetAzDeg = wrapAngle180(motion::stepsToAzDegrees(motion::getStepCount(Axis::Az)) - azDeg);
   tracking.offsetAltDeg = motion::stepsToAltDegrees(motion::getStepCount(Axis::Alt)) - altDeg;
   tracking.userAdjusting = false;
+  trackingFeed.refreshPending = true;
   systemState.trackingActive = true;
   motion::setTrackingEnabled(true);
 }
 
 bool startTrackingCurrentOrientation() {
-  DateTime now = currentDateTime();
+  int64_t now = currentSkyTime();
   double currentAz = motion::stepsToAzDegrees(motion::getStepCount(Axis::Az));
   double currentAlt = motion::stepsToAltDegrees(motion::getStepCount(Axis::Alt));
   double raHours = 0.0;
@@ -2004,7 +1890,7 @@ void completeGotoSuccess() {
 
   double azDeg = 0.0;
   double altDeg = 0.0;
-  DateTime now = currentDateTime();
+  int64_t now = currentSkyTime();
   double ra = gotoRuntime.targetRaHours;
   double dec = gotoRuntime.targetDecDegrees;
   raDecToAltAz(now, ra, dec, azDeg, altDeg);
@@ -2012,13 +1898,131 @@ void completeGotoSuccess() {
 }
 
 void abortGoto() {
-  motion::clearGotoRates();
+  motion::abortGoto();
   gotoRuntime.active = false;
   systemState.gotoActive = false;
   gotoRuntime.resumeTracking = true;
   stopTracking();
 }
 
+bool trackingTargetAltAz(int64_t when, double& azDeg, double& altDeg) {
+  double ra = tracking.targetRaHours;
+  double dec = tracking.targetDecDegrees;
+  if (tracking.targetCatalogIndex >= 0 &&
+      tracking.targetCatalogIndex < static_cast<int>(catalog::size())) {
+    const CatalogObject* object = catalog::get(static_cast<size_t>(tracking.targetCatalogIndex));
+    if (object) {
+      getObjectRaDecAt(*object, when, 0.0, ra, dec, nullptr);
+    }
+  }
+  return raDecToAltAz(when, ra, dec, azDeg, altDeg);
+}
+
+// Newton forward differences through samples at tau = 0, 1/3, 2/3 and 1,
+// expanded into powers of tau. Samples are steps relative to originSteps.
+TrackingPolynomial fitTrackingPolynomial(int64_t originSteps, const double samples[4]) {
+  double d1 = samples[1] - samples[0];
+  double d2 = samples[2] - 2.0 * samples[1] + samples[0];
+  double d3 = samples[3] - 3.0 * samples[2] + 3.0 * samples[1] - samples[0];
+  TrackingPolynomial polynomial{};
+  polynomial.baseSteps = originSteps + static_cast<int64_t>(llround(samples[0]));
+  polynomial.c1 = 3.0 * (d1 - d2 / 2.0 + d3 / 3.0);
+  polynomial.c2 = 9.0 * (d2 - d3) / 2.0;
+  polynomial.c3 = 27.0 * d3 / 6.0;
+  polynomial.horizonMs = kTrackingFeedHorizonSec * 1000;
+  return polynomial;
+}
+
+bool sendTrackingFeed(int64_t now,
+                      int64_t azSteps,
+                      int64_t altSteps,
+                      double currentAz,
+                      double currentAlt) {
+  const AxisCalibration& cal = storage::getConfig().axisCalibration;
+  double azSamples[4];
+  double altSamples[4];
+  double previousAz = currentAz;
+  double azTravel = 0.0;
+  for (int i = 0; i < 4; ++i) {
+    int64_t when = now + i * kTrackingFeedHorizonSec * astro_time::kMicrosPerSecond / 3;
+    double azDeg = 0.0;
+    double altDeg = 0.0;
+    if (!trackingTargetAltAz(when, azDeg, altDeg)) {
+      return false;
+    }
+    double desiredAz = wrapAngle360(azDeg + tracking.offsetAzDeg);
+    double desiredAlt = std::clamp(altDeg + tracking.offsetAltDeg,
+                                   motion::getMinAltitudeDegrees(),
+                                   motion::getMaxAltitudeDegrees());
+    azTravel += shortestAngularDistance(previousAz, desiredAz);
+    previousAz = desiredAz;
+    azSamples[i] = azTravel * cal.stepsPerDegreeAz;
+    altSamples[i] = (desiredAlt - currentAlt) * cal.stepsPerDegreeAlt;
+  }
+  return motion::setTrackingPolynomial(Axis::Az, fitTrackingPolynomial(azSteps, azSamples)) &&
+         motion::setTrackingPolynomial(Axis::Alt, fitTrackingPolynomial(altSteps, altSamples));
+}
+
+// Central difference over +-kFeedForwardHalfSpanSec.
+bool trackingFeedForward(int64_t now, double& azRate, double& altRate) {
+  const int64_t halfSpan = kFeedForwardHalfSpanSec * astro_time::kMicrosPerSecond;
+  double azBefore = 0.0;
+  double altBefore = 0.0;
+  double azAfter = 0.0;
+  double altAfter = 0.0;
+  if (!trackingTargetAltAz(now - halfSpan, azBefore, altBefore) ||
+      !trackingTargetAltAz(now + halfSpan, azAfter, altAfter)) {
+    return false;
+  }
+  double span = 2.0 * kFeedForwardHalfSpanSec;
+  azRate = shortestAngularDistance(azBefore, azAfter) / span;
+  altRate = (altAfter - altBefore) / span;
+  return true;
+}
+
+void updateTrackingFeed() {
+  if (systemState.joystickActive) {
+    tracking.userAdjusting = true;
+    if (trackingFeed.sent) {
+      motion::clearTrackingPolynomials();
+      trackingFeed.sent = false;
+    }
+    return;
+  }
+
+  uint32_t nowMs = millis();
+  if (!tracking.userAdjusting && !trackingFeed.refreshPending &&
+      (nowMs - trackingFeed.lastSentMs) < kTrackingFeedRefreshMs) {
+    return;
+  }
+
+  int64_t now = currentSkyTime();
+  int64_t azSteps = motion::getStepCount(Axis::Az);
+  int64_t altSteps = motion::getStepCount(Axis::Alt);
+  double currentAz = motion::stepsToAzDegrees(azSteps);
+  double currentAlt = motion::stepsToAltDegrees(altSteps);
+  if (tracking.userAdjusting) {
+    tracking.userAdjusting = false;
+    double azDeg = 0.0;
+    double altDeg = 0.0;
+    if (trackingTargetAltAz(now, azDeg, altDeg)) {
+      tracking.offsetAzDeg = wrapAngle180(currentAz - azDeg);
+      tracking.offsetAltDeg = currentAlt - altDeg;
+    }
+  }
+
+  trackingFeed.refreshPending = false;
+  trackingFeed.lastSentMs = nowMs;
+  trackingFeed.sent = sendTrackingFeed(now, azSteps, altSteps, currentAz, currentAlt);
+  if (!trackingFeed.sent) {
+    motion::clearTrackingPolynomials();
+    systemState.trackingActive = false;
+    return;
+  }
+  motion::setTrackingEnabled(true);
+  systemState.trackingActive = true;
+}
+
 void updateTracking() {
   if (gotoRuntime.active || systemState.gotoActive) {
     motion::setTrackingRates(0.0, 0.0);
@@ -2033,20 +2037,22 @@ void updateTracking() {
     return;
   }
 
-  DateTime now = currentDateTime();
-  double ra = tracking.targetRaHours;
-  double dec = tracking.targetDecDegrees;
-  if (tracking.targetCatalogIndex >= 0 &&
-      tracking.targetCatalogIndex < static_cast<int>(catalog::size())) {
-    const CatalogObject* object = catalog::get(static_cast<size_t>(tracking.targetCatalogIndex));
-    if (object) {
-      getObjectRaDecAt(*object, now, 0.0, ra, dec, nullptr);
-    }
+  if (config::TRACKING_POLYNOMIAL_FEED) {
+    updateTrackingFeed();
+    return;
   }
 
+  uint32_t nowMs = millis();
+  bool adjustChanged = systemState.joystickActive != tracking.userAdjusting;
+  if (!adjustChanged && !trackingFeed.refreshPending &&
+      (nowMs - trackingRateSentMs) < kTrackingRateRefreshMs) {
+    return;
+  }
+
+  int64_t now = currentSkyTime();
   double azDeg = 0.0;
   double altDeg = 0.0;
-  if (!raDecToAltAz(now, ra, dec, azDeg, altDeg)) {
+  if (!trackingTargetAltAz(now, azDeg, altDeg)) {
     motion::setTrackingRates(0.0, 0.0);
     systemState.trackingActive = false;
     return;
@@ -2069,15 +2075,22 @@ void updateTracking() {
     desiredAlt = altDeg + tracking.offsetAltDeg;
   }
 
-  double errorAz = shortestAngularDistance(currentAz, desiredAz);
-  double errorAlt = desiredAlt - currentAlt;
-  constexpr double kTrackingGain = 0.4;
-  constexpr double kMaxTrackingSpeed = 3.0;
-  double azRate = std::clamp(errorAz * kTrackingGain, -kMaxTrackingSpeed, kMaxTrackingSpeed);
-  double altRate = std::clamp(errorAlt * kTrackingGain, -kMaxTrackingSpeed, kMaxTrackingSpeed);
+  double azRate = 0.0;
+  double altRate = 0.0;
+  trackingFeedForward(now, azRate, altRate);
+  // While the joystick moves the view only the sky motion is followed; the
+  // offset is recaptured on release.
+  if (!tracking.userAdjusting) {
+    azRate += shortestAngularDistance(currentAz, desiredAz) * kTrackingGain;
+    altRate += (desiredAlt - currentAlt) * kTrackingGain;
+  }
+  azRate = std::clamp(azRate, -kMaxTrackingSpeed, kMaxTrackingSpeed);
+  altRate = std::clamp(altRate, -kMaxTrackingSpeed, kMaxTrackingSpeed);
 
   motion::setTrackingRates(azRate, altRate);
   motion::setTrackingEnabled(true);
+  trackingRateSentMs = nowMs;
+  trackingFeed.refreshPending = false;
   systemState.trackingActive = true;
 }
 
@@ -2096,42 +2109,39 @@ void updateGoto() {
     return;
   }
 
+  // The main board runs the ramp itself; the HID only polls for completion.
   uint32_t nowMs = millis();
-  double dt = (nowMs - gotoRuntime.lastUpdateMs) / 1000.0;
-  gotoRuntime.lastUpdateMs = nowMs;
-  if (dt <= 0.0) {
+  if ((nowMs - gotoRuntime.lastPollMs) < kGotoPollIntervalMs) {
     return;
   }
+  gotoRuntime.lastPollMs = nowMs;
 
-  bool azDone = updateAxisGoto(Axis::Az, gotoRuntime.az, dt, gotoRuntime.profile);
-  bool altDone = updateAxisGoto(Axis::Alt, gotoRuntime.alt, dt, gotoRuntime.profile);
-
-  if (azDone && altDone) {
+  if (!motion::isMoveActive()) {
     completeGotoSuccess();
   }
 }
 
 bool startGotoToObject(const CatalogObject& object, int catalogIndex) {
-  auto compute = [&](const DateTime& start,
+  auto compute = [&](int64_t start,
                      double secondsAhead,
                      double& raHours,
                      double& decDegrees,
                      double& azDeg,
                      double& altDeg,
-                     DateTime& targetTime) {
+                     int64_t& targetTime) {
     return computeTargetAltAz(object, start, secondsAhead, raHours, decDegrees, azDeg, altDeg, targetTime);
   };
   return planGotoTarget(object.name, catalogIndex, compute);
 }
 
 bool startGotoToCoordinates(double raHours, double decDegrees, const String& label) {
-  auto compute = [&](const DateTime& start,
+  auto compute = [&](int64_t start,
                      double secondsAhead,
                      double& outRa,
                      double& outDec,
                      double& azDeg,
                      double& altDeg,
-                     DateTime& targetTime) {
+                     int64_t& targetTime) {
     return computeManualTarget(raHours, decDegrees, start, secondsAhead, outRa, outDec, azDeg, altDeg, targetTime);
   };
   return planGotoTarget(label, -1, compute);
@@ -2150,23 +2160,27 @@ bool startParkPosition() {
 
   stopTracking();
 
-  GotoProfileSteps profile = toProfileSteps(storage::getConfig().gotoProfile, cal);
+  const GotoProfile& gotoProfile = storage::getConfig().gotoProfile;
   int64_t currentAzSteps = motion::getStepCount(Axis::Az);
   int64_t currentAltSteps = motion::getStepCount(Axis::Alt);
   int64_t targetAzSteps = currentAzSteps;
   int64_t targetAltSteps = motion::altDegreesToSteps(motion::getMaxAltitudeDegrees());
 
+  if (!motion::moveTo(targetAzSteps, targetAltSteps, gotoProfile, MoveMode::Coordinated)) {
+    showInfo("Park failed");
+    return false;
+  }
+
   gotoRuntime.active = true;
-  gotoRuntime.az = initAxisRuntime(Axis::Az, targetAzSteps);
-  gotoRuntime.alt = initAxisRuntime(Axis::Alt, targetAltSteps);
-  gotoRuntime.profile = profile;
-  double durationAz = computeTravelTimeSteps(static_cast<double>(targetAzSteps - currentAzSteps),
-                                             profile.maxSpeedAz, profile.accelerationAz, profile.decelerationAz);
-  double durationAlt = computeTravelTimeSteps(static_cast<double>(targetAltSteps - currentAltSteps),
-                                              profile.maxSpeedAlt, profile.accelerationAlt, profile.decelerationAlt);
+  double durationAz = motion_profile::computeTravelTimeSteps(
+      static_cast<double>(targetAzSteps - currentAzSteps),
+      motion_profile::toAxisLimits(gotoProfile, cal.stepsPerDegreeAz));
+  double durationAlt = motion_profile::computeTravelTimeSteps(
+      static_cast<double>(targetAltSteps - currentAltSteps),
+      motion_profile::toAxisLimits(gotoProfile, cal.stepsPerDegreeAlt));
   gotoRuntime.estimatedDurationSec = std::max(durationAz, durationAlt) + 1.0;
-  gotoRuntime.lastUpdateMs = millis();
-  gotoRuntime.startTime = currentDateTime();
+  gotoRuntime.lastPollMs = millis();
+  gotoRuntime.startTime = currentSkyTime();
   gotoRuntime.targetRaHours = 0.0;
   gotoRuntime.targetDecDegrees = motion::getMaxAltitudeDegrees();
   gotoRuntime.targetCatalogIndex = -1;
@@ -2176,7 +2190,6 @@ bool startParkPosition() {
   systemState.azGotoTarget = targetAzSteps;
   systemState.altGotoTarget = targetAltSteps;
   gotoTargetName = sanitizeForDisplay("Park");
-  motion::clearGotoRates();
   showInfo("Parking");
   return true;
 }
@@ -2219,6 +2232,7 @@ void handleMainMenuInput(int delta) {
   switch (mainMenuIndex) {
     case 0:
       systemState.menuMode = MenuMode::Status;
+      statusDetailsPage = 0;
       setUiState(UiState::StatusDetails);
       break;
     case 1:
@@ -2368,10 +2382,12 @@ void handleSetupMenuInput(int delta) {
       }
       bool enable = !wifi_ota::isEnabled();
       wifi_ota::setEnabled(enable);
-      String error;
-      if (!comm::call("SET_WIFI_ENABLED", {enable ? "1" : "0"}, nullptr, &error)) {
+      rpc::Flag request{static_cast<uint8_t>(enable ? 1 : 0)};
+      rpc::Status status = rpc::Status::kOk;
+      if (!comm::call(rpc::Opcode::kSetWifiEnabled, &request, sizeof(request), nullptr, 0,
+                      &status)) {
         String message = "Main WiFi: ";
-        message += error.isEmpty() ? "failed" : error;
+        message += (status == rpc::Status::kOk) ? "failed" : rpc::statusName(status);
         showInfo(message, 2000);
       } else if (enable) {
         showInfo(String("WiFi: ") + wifi_ota::ssid(), 2500);
@@ -2687,19 +2703,14 @@ void handlePolarAlignInput() {
 
 }  // namespace
 
-void applyNetworkTime(time_t utcEpoch) {
-  if (rtcAvailable) {
-    MutexLock lock(i2cMutex);
-    if (lock.locked()) {
-      rtc.adjust(DateTime(utcEpoch));
-    }
-  }
-  storage::setRtcEpoch(static_cast<uint32_t>(utcEpoch));
-}
+// The sky clock calls writeRtcSeconds() once it reaches a second boundary.
+void applyNetworkTime() { sky_clock::requestWrite(); }
 
 void stopTracking() {
   tracking.active = false;
   tracking.userAdjusting = false;
+  trackingFeed.sent = false;
+  trackingFeed.refreshPending = true;
   systemState.trackingActive = false;
   motion::setTrackingEnabled(false);
   motion::setTrackingRates(0.0, 0.0);
@@ -2741,6 +2752,8 @@ void init() {
 
     rtcAvailable = rtc.begin();
   };
+  sky_clock::setReader(readRtcSeconds);
+  sky_clock::setWriter(writeRtcSeconds);
 
   {
     MutexLock lock(i2cMutex);
@@ -2827,7 +2840,10 @@ void handleStatusScreenInput() {
   }
 }
 
-void handleStatusDetailsInput() {
+void handleStatusDetailsInput(int delta) {
+  if (delta != 0) {
+    statusDetailsPage = (statusDetailsPage + 1) % 2;
+  }
   if (input::consumeJoystickPress()) {
     systemState.menuMode = MenuMode::Status;
     setUiState(UiState::StatusScreen);
@@ -2849,7 +2865,7 @@ void handleInput() {
       handleStatusScreenInput();
       break;
     case UiState::StatusDetails:
-      handleStatusDetailsInput();
+      handleStatusDetailsInput(delta);
       break;
     case UiState::StartupLockPrompt:
       handleStartupLockPromptInput(delta);
@@ -2918,7 +2934,7 @@ void completePolarAlignment() {
   stopTracking();
   double azDeg = 0.0;
   double altDeg = 0.0;
-  DateTime now = currentDateTime();
+  int64_t now = currentSkyTime();
   if (raDecToAltAz(now, config::POLARIS_RA_HOURS, config::POLARIS_DEC_DEGREES, azDeg, altDeg)) {
     motion::setStepCount(Axis::Az, motion::azDegreesToSteps(azDeg));
     motion::setStepCount(Axis::Alt, motion::altDegreesToSteps(altDeg));
@@ -2941,7 +2957,10 @@ void startPolarAlignment() {
   showInfo("Use joystick", 2000);
 }
 
-void update() { updateGoto(); }
+void update() {
+  serviceSkyClock();
+  updateGoto();
+}
 
 }  // namespace display_menu
 
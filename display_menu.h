@@ -25,7 +25,7 @@ void startPolarAlignment();
 void update();
 void setSdAvailable(bool available);
 void stopTracking();
-void applyNetworkTime(time_t utcEpoch);
+void applyNetworkTime();
 
 } // namespace display_menu
 
@@ -0,0 +1,434 @@
+// Microbenchmarks for the astronomy code the HID runs every UI tick. Each
+// function is timed with the double kernel and the float kernel
+// (config::ASTRONOMY_FLOAT_KERNEL), over sweeps of times and sky positions;
+// float rows also show the worst deviation from double in arcseconds.
+//
+// Usage: astro_bench [--calls N] [--rounds N] [--count-ops]
+//
+// Timing reports the best of --rounds rounds of --calls calls, in ns/call,
+// plus heap allocations per call. --count-ops instead runs the kernels on
+// operation-counting scalars: on the ESP32 every double add, multiply,
+// divide and comparison is a soft-float library call and every double libm
+// call runs in software, while float arithmetic uses the FPU. The time
+// conversion ahead of the double kernel (julianDayAt) and the float kernel's
+// sidereal time, which is fixed point plus a few float terms, are not counted.
+//
+// Allocation counts come from the host String, whose small-string buffer
+// (15 chars) is larger than the ESP32 core's, so short names that copy
+// without allocating here may still hit the heap on the target.
+
+#include <Arduino.h>
+#include <RTClib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "astro_time.h"
+#include "astronomy.h"
+#include "catalog.h"
+#include "config.h"
+#include "planets.h"
+#include "planets_kernel.h"
+#include "storage.h"
+#include "time_utils.h"
+
+namespace {
+
+uint64_t allocations = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* p = malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kInputCount = 4096;
+constexpr PlanetId kPlanets[] = {PlanetId::Mercury, PlanetId::Venus,  PlanetId::Mars,
+                                 PlanetId::Jupiter, PlanetId::Saturn, PlanetId::Uranus,
+                                 PlanetId::Neptune};
+constexpr const char* kPlanetNames[] = {"Mercury", "Venus",  "Mars",   "Jupiter",
+                                        "Saturn",  "Uranus", "Neptune"};
+
+struct Options {
+  size_t calls = 200000;
+  int rounds = 5;
+  bool countOps = false;
+};
+
+// Operation counts per scalar type.
+struct OpCounts {
+  uint64_t arithmetic = 0;
+  uint64_t compare = 0;
+  uint64_t libm = 0;
+};
+
+template <typename T>
+OpCounts opCounts;
+
+// Scalar that counts what it does. Construction from a constant is free, as
+// it is folded at compile time on the target.
+template <typename T>
+class Counted {
+ public:
+  Counted() = default;
+  explicit Counted(double value) : value_(static_cast<T>(value)) {}
+  T value() const { return value_; }
+
+  friend Counted operator+(Counted a, Counted b) { return arithmetic(a.value_ + b.value_); }
+  friend Counted operator-(Counted a, Counted b) { return arithmetic(a.value_ - b.value_); }
+  friend Counted operator*(Counted a, Counted b) { return arithmetic(a.value_ * b.value_); }
+  friend Counted operator/(Counted a, Counted b) { return arithmetic(a.value_ / b.value_); }
+  // A sign flip, not a library call.
+  friend Counted operator-(Counted a) { return Counted(-a.value_); }
+  Counted& operator+=(Counted o) { return *this = *this + o; }
+  Counted& operator-=(Counted o) { return *this = *this - o; }
+
+  friend bool operator<(Counted a, Counted b) { return compared(a.value_ < b.value_); }
+  friend bool operator>(Counted a, Counted b) { return compared(a.value_ > b.value_); }
+
+  friend Counted sin(Counted a) { return libm(std::sin(a.value_)); }
+  friend Counted cos(Counted a) { return libm(std::cos(a.value_)); }
+  friend Counted tan(Counted a) { return libm(std::tan(a.value_)); }
+  friend Counted asin(Counted a) { return libm(std::asin(a.value_)); }
+  friend Counted acos(Counted a) { return libm(std::acos(a.value_)); }
+  friend Counted sqrt(Counted a) { return libm(std::sqrt(a.value_)); }
+  friend Counted atan2(Counted a, Counted b) { return libm(std::atan2(a.value_, b.value_)); }
+  friend Counted fmod(Counted a, Counted b) { return libm(std::fmod(a.value_, b.value_)); }
+  friend Counted fabs(Counted a) { return Counted(std::fabs(a.value_)); }
+
+ private:
+  static Counted arithmetic(T value) {
+    ++opCounts<T>.arithmetic;
+    return Counted(value);
+  }
+  static bool compared(bool result) {
+    ++opCounts<T>.compare;
+    return result;
+  }
+  static Counted libm(T value) {
+    ++opCounts<T>.libm;
+    return Counted(value);
+  }
+
+  T value_{};
+};
+
+template <typename Real>
+double toDouble(Real value) {
+  return static_cast<double>(value);
+}
+
+template <typename T>
+double toDouble(Counted<T> value) {
+  return static_cast<double>(value.value());
+}
+
+struct Input {
+  DateTime local;
+  double julianDay;
+  int64_t microsSinceJ2000;
+  double raHours;
+  double decDegrees;
+  double azimuthDeg;
+  double altitudeDeg;
+  size_t planet;
+};
+
+std::vector<Input> inputs;
+std::vector<CatalogObject> objects;
+
+// Deterministic sweep: local times over 2024-2031, every sky position above
+// -5 degrees and every planet.
+void buildInputs() {
+  uint32_t seed = 12345;
+  auto next = [&seed](double low, double high) {
+    seed = seed * 1664525u + 1013904223u;
+    return low + (high - low) * (seed / 4294967296.0);
+  };
+  const uint32_t start = DateTime(2024, 1, 1, 0, 0, 0).unixtime();
+  for (size_t i = 0; i < kInputCount; ++i) {
+    Input input;
+    input.local = DateTime(start + static_cast<uint32_t>(next(0.0, 7.0 * 365.25 * 86400.0)));
+    input.microsSinceJ2000 =
+        astro_time::microsSinceJ2000(time_utils::toUtcEpoch(input.local));
+    input.julianDay = astronomy::julianDayAt(input.microsSinceJ2000);
+    input.raHours = next(0.0, 24.0);
+    input.decDegrees = next(-89.0, 89.0);
+    input.azimuthDeg = next(0.0, 360.0);
+    input.altitudeDeg = next(-5.0, 89.0);
+    input.planet = i % (sizeof(kPlanets) / sizeof(kPlanets[0]));
+    inputs.push_back(input);
+  }
+  for (const char* name : kPlanetNames) {
+    CatalogObject object;
+    object.name = name;
+    object.type = "Planet";
+    objects.push_back(object);
+  }
+  CatalogObject star;
+  star.name = "Vega";
+  star.type = "Star";
+  star.raHours = 18.6156;
+  star.decDegrees = 38.7837;
+  objects.push_back(star);
+}
+
+double latitude() { return storage::getConfig().observerLatitudeDeg; }
+double longitude() { return storage::getConfig().observerLongitudeDeg; }
+
+// Angular separation in arcseconds between two directions given as
+// (longitude, latitude) in degrees.
+double separationArcsec(double lon1, double lat1, double lon2, double lat2) {
+  const double d2r = DEG_TO_RAD;
+  double sinDLat = sin((lat2 - lat1) * d2r / 2.0);
+  double sinDLon = sin((lon2 - lon1) * d2r / 2.0);
+  double h = sinDLat * sinDLat + cos(lat1 * d2r) * cos(lat2 * d2r) * sinDLon * sinDLon;
+  return 2.0 * asin(std::min(1.0, sqrt(h))) * RAD_TO_DEG * 3600.0;
+}
+
+template <typename Real>
+constexpr bool kDoubleKernel = std::is_same_v<Real, double> || std::is_same_v<Real, Counted<double>>;
+
+// localSiderealDegrees() as each kernel builds it: the double kernel goes
+// through the Julian day, the float kernel through fixed-point time.
+template <typename Real>
+Real siderealAt(const Input& input) {
+  if constexpr (kDoubleKernel<Real>) {
+    return astronomy::siderealDegrees(Real(astronomy::julianDayAt(input.microsSinceJ2000)),
+                                      Real(longitude()));
+  } else {
+    return Real(astronomy::siderealDegreesAt(input.microsSinceJ2000,
+                                             static_cast<float>(longitude())));
+  }
+}
+
+template <typename Real>
+void altAzAt(const Input& input, double& az, double& alt) {
+  Real azimuth;
+  Real altitude;
+  astronomy::equatorialToHorizontal(siderealAt<Real>(input), Real(input.raHours),
+                                    Real(input.decDegrees), Real(latitude()), azimuth,
+                                    altitude);
+  az = toDouble(azimuth);
+  alt = toDouble(altitude);
+}
+
+template <typename Real>
+void raDecAt(const Input& input, double& ra, double& dec) {
+  Real raHours;
+  Real decDegrees;
+  astronomy::horizontalToEquatorial(siderealAt<Real>(input), Real(input.azimuthDeg),
+                                    Real(input.altitudeDeg), Real(latitude()), raHours,
+                                    decDegrees);
+  ra = toDouble(raHours);
+  dec = toDouble(decDegrees);
+}
+
+template <typename Real>
+void planetAt(const Input& input, double& ra, double& dec) {
+  using planets::kernel::meanLongitudeDegAt;
+  const PlanetId planet = kPlanets[input.planet];
+  planets::kernel::Position<Real> position;
+  if constexpr (kDoubleKernel<Real>) {
+    Real T = (Real(input.julianDay) - Real(astronomy::kJ2000)) / Real(astronomy::kDaysPerCentury);
+    position = planets::kernel::computeGeocentric(planet, T);
+  } else {
+    const int64_t micros = input.microsSinceJ2000;
+    position = planets::kernel::computeGeocentric(
+        planet, Real(astro_time::centuries(micros)), Real(meanLongitudeDegAt(planet, micros)),
+        Real(meanLongitudeDegAt(PlanetId::Earth, micros)));
+  }
+  ra = toDouble(position.raHours);
+  dec = toDouble(position.decDegrees);
+}
+
+// One call of a benchmarked function on input i; returns a value to sink.
+using Call = std::function<double(const Input& input, size_t i)>;
+// Deviation of a float row from the double reference, in arcseconds.
+using Error = std::function<double(const Input& input)>;
+
+struct Case {
+  const char* name;
+  const char* variant;
+  Call call;
+  Error error;
+};
+
+using PairAt = void (*)(const Input& input, double& first, double& second);
+
+template <typename Real>
+void siderealPair(const Input& input, double& lst, double& unused) {
+  lst = toDouble(siderealAt<Real>(input));
+  unused = 0.0;
+}
+
+// Double and float rows of a function returning a direction; hoursScale turns
+// the first value into degrees.
+template <PairAt doubleAt, PairAt floatAt>
+void addCases(std::vector<Case>& cases, const char* name, double hoursScale) {
+  auto call = [](PairAt at) {
+    return [at](const Input& in, size_t) {
+      double a;
+      double b;
+      at(in, a, b);
+      return a + b;
+    };
+  };
+  cases.push_back({name, "double", call(doubleAt), nullptr});
+  cases.push_back({name, "float", call(floatAt), [hoursScale](const Input& in) {
+                     double a;
+                     double b;
+                     double refA;
+                     double refB;
+                     floatAt(in, a, b);
+                     doubleAt(in, refA, refB);
+                     return separationArcsec(a * hoursScale, b, refA * hoursScale, refB);
+                   }});
+}
+
+std::vector<Case> buildCases() {
+  std::vector<Case> cases;
+  addCases<siderealPair<double>, siderealPair<float>>(cases, "localSiderealDegrees", 1.0);
+  addCases<altAzAt<double>, altAzAt<float>>(cases, "raDecToAltAz", 1.0);
+  addCases<raDecAt<double>, raDecAt<float>>(cases, "altAzToRaDec", 15.0);
+  // The firmware entry point, in whichever kernel config.h selects.
+  cases.push_back({"getObjectRaDecAt", config::ASTRONOMY_FLOAT_KERNEL ? "float" : "double",
+                   [](const Input& in, size_t i) {
+                     double ra;
+                     double dec;
+                     astronomy::getObjectRaDecAt(objects[i % objects.size()], in.microsSinceJ2000,
+                                                 0.0, ra, dec, nullptr);
+                     return ra + dec;
+                   },
+                   nullptr});
+  addCases<planetAt<double>, planetAt<float>>(cases, "computePlanet", 15.0);
+  cases.push_back({"applyTimezone", "int",
+                   [](const Input& in, size_t) {
+                     return double(time_utils::applyTimezone(in.local.unixtime()).unixtime());
+                   },
+                   nullptr});
+  return cases;
+}
+
+volatile double sinkHole = 0.0;
+
+void timeCase(const Case& benchCase, const Options& options) {
+  double bestNs = 1e300;
+  uint64_t allocationsPerRound = 0;
+  for (int round = 0; round < options.rounds; ++round) {
+    double sink = 0.0;
+    const uint64_t allocationsBefore = allocations;
+    const Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < options.calls; ++i) {
+      sink += benchCase.call(inputs[i % inputs.size()], i);
+    }
+    const double elapsedNs =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    allocationsPerRound = allocations - allocationsBefore;
+    bestNs = std::min(bestNs, elapsedNs);
+    sinkHole = sinkHole + sink;
+  }
+
+  char error[24] = "-";
+  if (benchCase.error) {
+    double maxError = 0.0;
+    for (const Input& in : inputs) {
+      maxError = std::max(maxError, benchCase.error(in));
+    }
+    snprintf(error, sizeof(error), "%.2f", maxError);
+  }
+  printf("%-22s %-7s %10.1f %10.3f %14s\n", benchCase.name, benchCase.variant,
+         bestNs / options.calls, static_cast<double>(allocationsPerRound) / options.calls, error);
+}
+
+// Runs body once per input and prints per-call counts: soft-float calls are
+// double arithmetic, comparisons and libm; FPU ops are float arithmetic and
+// comparisons; float libm runs in software on top of the FPU.
+template <typename Body>
+void countRow(const char* name, const char* variant, Body body) {
+  opCounts<double> = OpCounts{};
+  opCounts<float> = OpCounts{};
+  for (const Input& in : inputs) {
+    body(in);
+  }
+  const OpCounts& d = opCounts<double>;
+  const OpCounts& f = opCounts<float>;
+  const double calls = static_cast<double>(inputs.size());
+  printf("%-22s %-7s %10.1f %10.1f %10.1f\n", name, variant,
+         (d.arithmetic + d.compare + d.libm) / calls, (f.arithmetic + f.compare) / calls,
+         f.libm / calls);
+}
+
+template <typename T>
+void countKernels(const char* variant) {
+  using Real = Counted<T>;
+  double a;
+  double b;
+  countRow("localSiderealDegrees", variant,
+           [](const Input& in) { sinkHole = sinkHole + toDouble(siderealAt<Real>(in)); });
+  countRow("raDecToAltAz", variant, [&](const Input& in) { altAzAt<Real>(in, a, b); });
+  countRow("altAzToRaDec", variant, [&](const Input& in) { raDecAt<Real>(in, a, b); });
+  countRow("computePlanet", variant, [&](const Input& in) { planetAt<Real>(in, a, b); });
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const char* name = argv[i];
+    if (strcmp(name, "--count-ops") == 0) {
+      options.countOps = true;
+    } else if (strcmp(name, "--calls") == 0 && i + 1 < argc) {
+      options.calls = static_cast<size_t>(atol(argv[++i]));
+    } else if (strcmp(name, "--rounds") == 0 && i + 1 < argc) {
+      options.rounds = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "Unknown option %s\n", name);
+    }
+  }
+  options.calls = std::max<size_t>(options.calls, 1);
+  options.rounds = std::max(options.rounds, 1);
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+  storage::init();
+  buildInputs();
+
+  if (options.countOps) {
+    printf("Operations per call (after the date conversion)\n");
+    printf("%-22s %-7s %10s %10s %10s\n", "function", "type", "soft-float", "fpu ops",
+           "float libm");
+    countKernels<double>("double");
+    countKernels<float>("float");
+    return 0;
+  }
+
+  printf("%zu calls x %d rounds over %zu inputs\n", options.calls, options.rounds, inputs.size());
+  printf("%-22s %-7s %10s %10s %14s\n", "function", "type", "ns/call", "allocs", "max err arcsec");
+  for (const Case& benchCase : buildCases()) {
+    timeCase(benchCase, options);
+  }
+  return 0;
+}
@@ -0,0 +1,10 @@
+#include <Arduino.h>
+
+// Arduino core entry point: setup() once, then loop() forever on the main
+// thread, which stands in for the ESP32 loopTask.
+int main() {
+  setup();
+  while (true) {
+    loop();
+  }
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Starts both host roles on a fresh pty pair and passes once the HID reports
+# the mount link ready and the negotiated fast baudrate.
+# Usage: link_smoke.sh <nerdstar_main> <nerdstar_hid>
+set -u
+
+main_bin=$1
+hid_bin=$2
+work=$(mktemp -d)
+trap 'kill "$main_pid" 2>/dev/null; rm -rf "$work"' EXIT
+
+"$main_bin" >"$work/main.log" 2>&1 &
+main_pid=$!
+
+pty=""
+for _ in $(seq 50); do
+  pty=$(sed -n 's/.*NERDSTAR_UART2=\(.*\))$/\1/p' "$work/main.log")
+  [ -n "$pty" ] && break
+  sleep 0.1
+done
+if [ -z "$pty" ]; then
+  echo "main role did not open a pty"
+  cat "$work/main.log"
+  exit 1
+fi
+
+NERDSTAR_UART2=$pty timeout 8 "$hid_bin" >"$work/hid.log" 2>&1
+
+cat "$work/hid.log"
+grep -q "Mount link ready" "$work/hid.log" &&
+  grep -q "Link running at" "$work/hid.log" &&
+  ! grep -q "Heartbeat lost" "$work/hid.log"
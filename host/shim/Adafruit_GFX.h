@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include "Print.h"
+
+// Text-only canvas: characters land in a grid of 6x8 cells (the classic GFX
+// font at size 1). Inverted cells come from text drawn black on white.
+class Adafruit_GFX : public Print {
+ public:
+  static constexpr int kCellWidth = 6;
+  static constexpr int kCellHeight = 8;
+  static constexpr int kMaxColumns = 32;
+  static constexpr int kMaxRows = 16;
+
+  Adafruit_GFX(int16_t w, int16_t h);
+  size_t write(uint8_t c) override;
+  using Print::write;
+  void setCursor(int16_t x, int16_t y) { cursorX_ = x; cursorY_ = y; }
+  void setTextColor(uint16_t color) { color_ = color; }
+  void setTextSize(uint8_t size) { textSize_ = size ? size : 1; }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void getTextBounds(const char* text, int16_t x, int16_t y, int16_t* x1, int16_t* y1,
+                     uint16_t* w, uint16_t* h);
+
+ protected:
+  struct Cell {
+    char glyph;
+    bool inverted;
+  };
+
+  void clearCells();
+  int columns() const;
+  int rows() const;
+
+  int16_t width_;
+  int16_t height_;
+  int16_t cursorX_ = 0;
+  int16_t cursorY_ = 0;
+  uint16_t color_ = 1;
+  uint8_t textSize_ = 1;
+  Cell cells_[kMaxRows][kMaxColumns];
+};
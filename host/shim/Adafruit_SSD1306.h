@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Adafruit_GFX.h"
+#include "Wire.h"
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_SWITCHCAPVCC 0x02
+
+// display() prints each changed frame to stderr when NERDSTAR_DISPLAY is set.
+class Adafruit_SSD1306 : public Adafruit_GFX {
+ public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* wire, int8_t resetPin);
+  bool begin(uint8_t vcs, uint8_t address);
+  void clearDisplay();
+  void display();
+
+ private:
+  bool echo_ = false;
+  std::string lastFrame_;
+};
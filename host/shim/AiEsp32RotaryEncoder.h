@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+// No knob on the host: the position stays where reset() left it.
+class AiEsp32RotaryEncoder {
+ public:
+  AiEsp32RotaryEncoder(uint8_t pinA, uint8_t pinB, int buttonPin, int vccPin);
+  void begin();
+  void setup(void (*isr)(), void (*buttonIsr)());
+  void setBoundaries(long minValue, long maxValue, bool circle);
+  void disableAcceleration();
+  void reset(long value = 0);
+  long readEncoder();
+  void readEncoder_ISR();
+  void readButton_ISR();
+  bool isEncoderButtonClicked();
+
+ private:
+  long value_ = 0;
+  long minValue_ = -2147483647L;
+  long maxValue_ = 2147483647L;
+};
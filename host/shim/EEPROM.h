@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Erased (0xFF) on every start unless NERDSTAR_EEPROM names a backing file,
+// which is loaded by begin() and rewritten by commit().
+class EEPROMClass {
+ public:
+  bool begin(size_t size);
+  bool commit();
+  template <typename T>
+  T& get(int address, T& value) {
+    if (address >= 0 && static_cast<size_t>(address) + sizeof(T) <= data_.size()) {
+      memcpy(&value, data_.data() + address, sizeof(T));
+    }
+    return value;
+  }
+  template <typename T>
+  const T& put(int address, const T& value) {
+    if (address >= 0 && static_cast<size_t>(address) + sizeof(T) <= data_.size()) {
+      memcpy(data_.data() + address, &value, sizeof(T));
+    }
+    return value;
+  }
+
+ private:
+  std::vector<uint8_t> data_;
+  std::string path_;
+};
+
+extern EEPROMClass EEPROM;
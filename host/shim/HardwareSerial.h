@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "Print.h"
+
+#define SERIAL_8N1 0x800001c
+
+// UART 0 maps to stdout/stdin. Other UARTs open the tty named by
+// NERDSTAR_UART<n> (a pty or a USB adapter); without it begin() creates a new
+// pty and prints the path the peer process should open. connect() joins two
+// ports of the same process through an in-memory pipe instead.
+class HardwareSerial : public Stream {
+ public:
+  explicit HardwareSerial(int uartNum);
+  ~HardwareSerial() override;
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1,
+             int8_t txPin = -1);
+  void end();
+  void updateBaudRate(unsigned long baud);
+  uint32_t baudRate() const { return baud_; }
+  size_t setRxBufferSize(size_t size) { return size; }
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  void flush() {}
+  explicit operator bool() const { return true; }
+  int uartNum() const { return uartNum_; }
+
+  static void connect(HardwareSerial& a, HardwareSerial& b);
+
+ private:
+  struct Pipe {
+    std::mutex mutex;
+    std::deque<uint8_t> bytes;
+  };
+
+  void openPort();
+  void fill();
+
+  int uartNum_;
+  uint32_t baud_ = 0;
+  int readFd_ = -1;
+  int writeFd_ = -1;
+  int spareFd_ = -1;  // pty slave kept open so the master never sees a hangup
+  bool ownsFds_ = false;
+  std::deque<uint8_t> rx_;
+  std::shared_ptr<Pipe> rxPipe_;
+  std::shared_ptr<Pipe> txPipe_;
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+
+class TimeSpan {
+ public:
+  TimeSpan(int32_t seconds = 0) : seconds_(seconds) {}
+  TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+      : seconds_(static_cast<int32_t>(days) * 86400L + static_cast<int32_t>(hours) * 3600 +
+                 static_cast<int32_t>(minutes) * 60 + seconds) {}
+  int32_t totalseconds() const { return seconds_; }
+
+ private:
+  int32_t seconds_;
+};
+
+class DateTime {
+ public:
+  DateTime(uint32_t t = 946684800u) { setUnix(t); }
+  DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0,
+           uint8_t sec = 0)
+      : y_(year), m_(month), d_(day), hh_(hour), mm_(min), ss_(sec) {}
+
+  uint16_t year() const { return y_; }
+  uint8_t month() const { return m_; }
+  uint8_t day() const { return d_; }
+  uint8_t hour() const { return hh_; }
+  uint8_t minute() const { return mm_; }
+  uint8_t second() const { return ss_; }
+  uint8_t dayOfTheWeek() const {
+    int64_t days = daysFromCivil(y_, m_, d_);
+    return static_cast<uint8_t>(((days % 7) + 11) % 7);  // 1970-01-01 was a Thursday
+  }
+  uint32_t unixtime() const {
+    int64_t days = daysFromCivil(y_, m_, d_);
+    return static_cast<uint32_t>(days * 86400 + hh_ * 3600 + mm_ * 60 + ss_);
+  }
+  DateTime operator+(const TimeSpan& span) const {
+    return DateTime(static_cast<uint32_t>(static_cast<int64_t>(unixtime()) + span.totalseconds()));
+  }
+  DateTime operator-(const TimeSpan& span) const {
+    return DateTime(static_cast<uint32_t>(static_cast<int64_t>(unixtime()) - span.totalseconds()));
+  }
+  TimeSpan operator-(const DateTime& right) const {
+    return TimeSpan(static_cast<int32_t>(static_cast<int64_t>(unixtime()) - right.unixtime()));
+  }
+
+ private:
+  static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+  }
+  void setUnix(uint32_t t) {
+    int64_t z = t / 86400;
+    uint32_t rem = t % 86400;
+    hh_ = rem / 3600;
+    mm_ = (rem % 3600) / 60;
+    ss_ = rem % 60;
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t y = static_cast<int64_t>(yoe) + era * 400;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d_ = doy - (153 * mp + 2) / 5 + 1;
+    m_ = mp < 10 ? mp + 3 : mp - 9;
+    y_ = static_cast<uint16_t>(y + (m_ <= 2));
+  }
+
+  uint16_t y_ = 2000;
+  uint8_t m_ = 1;
+  uint8_t d_ = 1;
+  uint8_t hh_ = 0;
+  uint8_t mm_ = 0;
+  uint8_t ss_ = 0;
+};
+
+// Runs on the host's UTC clock; adjust() stores an offset to it.
+class RTC_DS3231 {
+ public:
+  bool begin();
+  DateTime now();
+  void adjust(const DateTime& dt);
+
+ private:
+  int64_t offsetSeconds_ = 0;
+};
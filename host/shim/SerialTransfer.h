@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include "Print.h"
+
+// Host build of the SerialTransfer library with the same wire format: start
+// byte, packet id, COBS overhead byte, length, stuffed payload, CRC8 and stop
+// byte. A host process can therefore also talk to a real board.
+class SerialTransfer {
+ public:
+  static constexpr uint16_t kMaxPacketSize = 0xFE;
+  static constexpr int8_t kContinue = 3;
+  static constexpr int8_t kNewData = 2;
+  static constexpr int8_t kNoData = 1;
+  static constexpr int8_t kCrcError = 0;
+  static constexpr int8_t kPayloadError = -1;
+  static constexpr int8_t kStopByteError = -2;
+  static constexpr int8_t kStalePacketError = -3;
+
+  void begin(Stream& port, uint32_t timeoutMs = 50);
+  uint8_t available();
+  uint8_t sendData(uint16_t messageLen, uint8_t packetId = 0);
+
+  uint8_t txBuff[kMaxPacketSize]{};
+  uint8_t rxBuff[kMaxPacketSize]{};
+  int8_t status = 0;
+
+ private:
+  enum class State : uint8_t { kStart, kId, kOverhead, kLength, kPayload, kCrc, kEnd };
+
+  Stream* port_ = nullptr;
+  uint32_t timeoutMs_ = 50;
+  uint32_t lastByteMs_ = 0;
+  State state_ = State::kStart;
+  uint8_t overhead_ = 0;
+  uint8_t expected_ = 0;
+  uint8_t received_ = 0;
+  uint8_t crc_ = 0;
+};
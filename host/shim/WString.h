@@ -0,0 +1,78 @@
+#pragma once
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+
+class String {
+ public:
+  String() = default;
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  String(const String&) = default;
+  String(String&&) = default;
+  String& operator=(const String&) = default;
+  String& operator=(String&&) = default;
+  String& operator=(const char* s) { s_ = s ? s : ""; return *this; }
+  explicit String(char c) : s_(1, c) {}
+  explicit String(int v) : s_(std::to_string(v)) {}
+  explicit String(unsigned int v) : s_(std::to_string(v)) {}
+  explicit String(long v) : s_(std::to_string(v)) {}
+  explicit String(unsigned long v) : s_(std::to_string(v)) {}
+  explicit String(long long v) : s_(std::to_string(v)) {}
+  explicit String(unsigned long long v) : s_(std::to_string(v)) {}
+  explicit String(float v, unsigned int decimals = 2) { fmt(v, decimals); }
+  explicit String(double v, unsigned int decimals = 2) { fmt(v, decimals); }
+
+  unsigned int length() const { return static_cast<unsigned int>(s_.size()); }
+  bool isEmpty() const { return s_.empty(); }
+  const char* c_str() const { return s_.c_str(); }
+  bool reserve(unsigned int n) { s_.reserve(n); return true; }
+  char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  char charAt(unsigned int i) const { return (*this)[i]; }
+
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  bool concat(const char* o, unsigned int n) { s_.append(o, n); return true; }
+  friend String operator+(const String& a, const String& b) { return String(a.s_ + b.s_); }
+  friend String operator+(const String& a, const char* b) { return String(a.s_ + b); }
+  friend String operator+(const char* a, const String& b) { return String(std::string(a) + b.s_); }
+
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator==(const char* o) const { return s_ == o; }
+  bool operator!=(const String& o) const { return s_ != o.s_; }
+  bool operator!=(const char* o) const { return s_ != o; }
+  bool equals(const String& o) const { return s_ == o.s_; }
+  bool equals(const char* o) const { return s_ == o; }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(s_.c_str(), o.s_.c_str()) == 0; }
+  bool startsWith(const String& o) const { return s_.rfind(o.s_, 0) == 0; }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    auto p = s_.find(c, from);
+    return p == std::string::npos ? -1 : static_cast<int>(p);
+  }
+  String substring(unsigned int from) const { return from >= s_.size() ? String() : String(s_.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= s_.size()) return String();
+    return String(s_.substr(from, to - from));
+  }
+  int compareTo(const String& o) const { return s_.compare(o.s_); }
+  void toLowerCase() { for (auto& c : s_) c = static_cast<char>(tolower(static_cast<unsigned char>(c))); }
+  void toUpperCase() { for (auto& c : s_) c = static_cast<char>(toupper(static_cast<unsigned char>(c))); }
+  void trim() { while (!s_.empty() && isspace(static_cast<unsigned char>(s_.back()))) s_.pop_back(); size_t i = 0; while (i < s_.size() && isspace(static_cast<unsigned char>(s_[i]))) ++i; s_.erase(0, i); }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+  double toDouble() const { return strtod(s_.c_str(), nullptr); }
+
+ private:
+  void fmt(double v, unsigned int d) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", d, v);
+    s_ = buf;
+  }
+  std::string s_;
+};
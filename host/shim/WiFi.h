@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+
+typedef enum { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 } wl_status_t;
+typedef enum { WIFI_OFF = 0, WIFI_MODE_STA = 1 } wifi_mode_t;
+
+class WiFiClass {
+ public:
+  void persistent(bool) {}
+  bool mode(wifi_mode_t) { return true; }
+  bool disconnect(bool = false, bool = false) { return true; }
+  bool setHostname(const char*) { return true; }
+  bool setAutoReconnect(bool) { return true; }
+  wl_status_t begin(const char*, const char* = nullptr) { return WL_DISCONNECTED; }
+  wl_status_t status() { return WL_DISCONNECTED; }
+};
+
+extern WiFiClass WiFi;
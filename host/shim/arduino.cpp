@@ -0,0 +1,140 @@
+#include <Arduino.h>
+#include <esp_rom_sys.h>
+
+#include "host_sim.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point kBoot = Clock::now();
+
+constexpr uint8_t kPinCount = 64;
+constexpr uint16_t kAnalogCenter = 2048;  // joystick at rest, 12 bit
+
+uint8_t pinModes[kPinCount] = {};
+uint8_t pinLevels[kPinCount] = {};
+
+std::mutex randomMutex;
+std::mt19937 randomEngine{std::random_device{}()};
+
+std::atomic<bool> simulating{false};
+host_sim::Config simConfig{};
+int64_t simNs = 0;
+
+}  // namespace
+
+namespace host_sim {
+
+void begin(const Config& config) {
+  simConfig = config;
+  simNs = config.startNs;
+  simulating.store(true);
+}
+
+void end() { simulating.store(false); }
+
+bool active() { return simulating.load(std::memory_order_relaxed); }
+
+int64_t nowNs() { return simNs; }
+
+void charge(uint64_t ns) { simNs += static_cast<int64_t>(ns); }
+
+void wait(uint64_t ns) {
+  charge(ns);
+  if (simConfig.onWait) {
+    simConfig.onWait(simNs, simConfig.context);
+  }
+}
+
+}  // namespace host_sim
+
+int64_t esp_timer_get_time() {
+  if (host_sim::active()) {
+    host_sim::charge(simConfig.timerReadCostNs);
+    return simNs / 1000;
+  }
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - kBoot).count();
+}
+
+uint32_t millis() { return static_cast<uint32_t>(esp_timer_get_time() / 1000); }
+
+uint32_t micros() { return static_cast<uint32_t>(esp_timer_get_time()); }
+
+void delay(uint32_t ms) {
+  if (host_sim::active()) {
+    host_sim::wait(static_cast<uint64_t>(ms) * 1000000);
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void hostTaskYield() {
+  if (host_sim::active()) {
+    host_sim::wait(simConfig.yieldCostNs);
+    return;
+  }
+  std::this_thread::yield();
+}
+
+// Busy-waits like the ROM routine; sleeping would overshoot short pulses.
+void esp_rom_delay_us(uint32_t us) {
+  if (host_sim::active()) {
+    host_sim::wait(static_cast<uint64_t>(us) * 1000);
+    return;
+  }
+  const int64_t end = esp_timer_get_time() + us;
+  while (esp_timer_get_time() < end) {
+  }
+}
+
+void delayMicroseconds(uint32_t us) { esp_rom_delay_us(us); }
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  std::lock_guard<std::mutex> lock(randomMutex);
+  return std::uniform_int_distribution<long>(howsmall, howbig - 1)(randomEngine);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= kPinCount) {
+    return;
+  }
+  pinModes[pin] = mode;
+  if (mode == INPUT_PULLUP) {
+    pinLevels[pin] = HIGH;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < kPinCount) {
+    pinLevels[pin] = value ? HIGH : LOW;
+  }
+  if (host_sim::active()) {
+    host_sim::charge(simConfig.pinWriteCostNs);
+    if (simConfig.onPinWrite) {
+      simConfig.onPinWrite(pin, value ? HIGH : LOW, simNs, simConfig.context);
+    }
+  }
+}
+
+int digitalRead(uint8_t pin) { return pin < kPinCount ? pinLevels[pin] : LOW; }
+
+uint16_t analogRead(uint8_t) { return kAnalogCenter; }
+
+void analogReadResolution(uint8_t) {}
+
+void attachInterrupt(uint8_t, void (*)(), int) {}
+
+// The host never joins WiFi, so NTP never answers.
+void configTime(long, int, const char*, const char*, const char*) {}
+
+bool getLocalTime(struct tm*, uint32_t) { return false; }
@@ -0,0 +1,164 @@
+#include <Adafruit_SSD1306.h>
+#include <AiEsp32RotaryEncoder.h>
+#include <ArduinoOTA.h>
+#include <RTClib.h>
+#include <WiFi.h>
+#include <Wire.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+TwoWire Wire;
+WiFiClass WiFi;
+ArduinoOTAClass ArduinoOTA;
+
+bool TwoWire::begin(int, int, uint32_t) { return true; }
+
+namespace {
+
+constexpr uint8_t kDegreeGlyph = 0xF8;  // code page 437, as in the GFX font
+
+void appendGlyph(std::string& frame, char glyph) {
+  const uint8_t code = static_cast<uint8_t>(glyph);
+  if (code == kDegreeGlyph) {
+    frame += "\u00b0";
+  } else if (code < 0x20 || code >= 0x7F) {
+    frame += '?';
+  } else {
+    frame += glyph;
+  }
+}
+
+}  // namespace
+
+// Display ---------------------------------------------------------------------
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h) : width_(w), height_(h) { clearCells(); }
+
+int Adafruit_GFX::columns() const { return std::min<int>(width_ / kCellWidth, kMaxColumns); }
+
+int Adafruit_GFX::rows() const { return std::min<int>(height_ / kCellHeight, kMaxRows); }
+
+void Adafruit_GFX::clearCells() {
+  for (auto& row : cells_) {
+    for (auto& cell : row) {
+      cell = {' ', false};
+    }
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  const int advance = kCellWidth * textSize_;
+  if (c == '\n') {
+    cursorX_ = 0;
+    cursorY_ += kCellHeight * textSize_;
+    return 1;
+  }
+  if (c == '\r') {
+    return 1;
+  }
+  const int column = cursorX_ / kCellWidth;
+  const int row = cursorY_ / kCellHeight;
+  if (cursorX_ >= 0 && cursorY_ >= 0 && column < columns() && row < rows()) {
+    cells_[row][column] = {static_cast<char>(c), color_ == 0};
+  }
+  cursorX_ += advance;
+  return 1;
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  const int firstColumn = std::max(0, x / kCellWidth);
+  const int lastColumn = std::min(columns(), (x + w + kCellWidth - 1) / kCellWidth);
+  const int firstRow = std::max(0, y / kCellHeight);
+  const int lastRow = std::min(rows(), (y + h + kCellHeight - 1) / kCellHeight);
+  for (int row = firstRow; row < lastRow; ++row) {
+    for (int column = firstColumn; column < lastColumn; ++column) {
+      cells_[row][column] = {' ', color != 0};
+    }
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+
+void Adafruit_GFX::getTextBounds(const char* text, int16_t x, int16_t y, int16_t* x1,
+                                 int16_t* y1, uint16_t* w, uint16_t* h) {
+  *x1 = x;
+  *y1 = y;
+  *w = static_cast<uint16_t>(strlen(text) * kCellWidth * textSize_);
+  *h = static_cast<uint16_t>(kCellHeight * textSize_);
+}
+
+Adafruit_SSD1306::Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire*, int8_t)
+    : Adafruit_GFX(w, h) {}
+
+bool Adafruit_SSD1306::begin(uint8_t, uint8_t) {
+  echo_ = getenv("NERDSTAR_DISPLAY") != nullptr;
+  return true;
+}
+
+void Adafruit_SSD1306::clearDisplay() { clearCells(); }
+
+void Adafruit_SSD1306::display() {
+  if (!echo_) {
+    return;
+  }
+  std::string frame;
+  for (int row = 0; row < rows(); ++row) {
+    bool inverted = false;
+    frame += '|';
+    for (int column = 0; column < columns(); ++column) {
+      const Cell& cell = cells_[row][column];
+      if (cell.inverted != inverted) {
+        frame += cell.inverted ? "\033[7m" : "\033[0m";
+        inverted = cell.inverted;
+      }
+      appendGlyph(frame, cell.glyph);
+    }
+    frame += inverted ? "\033[0m|\n" : "|\n";
+  }
+  if (frame != lastFrame_) {
+    lastFrame_ = frame;
+    fprintf(stderr, "%s\n", frame.c_str());
+  }
+}
+
+// RTC -------------------------------------------------------------------------
+
+bool RTC_DS3231::begin() { return true; }
+
+DateTime RTC_DS3231::now() {
+  return DateTime(static_cast<uint32_t>(static_cast<int64_t>(time(nullptr)) + offsetSeconds_));
+}
+
+void RTC_DS3231::adjust(const DateTime& dt) {
+  offsetSeconds_ = static_cast<int64_t>(dt.unixtime()) - static_cast<int64_t>(time(nullptr));
+}
+
+// Rotary encoder --------------------------------------------------------------
+
+AiEsp32RotaryEncoder::AiEsp32RotaryEncoder(uint8_t, uint8_t, int, int) {}
+
+void AiEsp32RotaryEncoder::begin() {}
+
+void AiEsp32RotaryEncoder::setup(void (*)(), void (*)()) {}
+
+void AiEsp32RotaryEncoder::setBoundaries(long minValue, long maxValue, bool) {
+  minValue_ = minValue;
+  maxValue_ = maxValue;
+}
+
+void AiEsp32RotaryEncoder::disableAcceleration() {}
+
+void AiEsp32RotaryEncoder::reset(long value) {
+  value_ = std::clamp(value, minValue_, maxValue_);
+}
+
+long AiEsp32RotaryEncoder::readEncoder() { return value_; }
+
+void AiEsp32RotaryEncoder::readEncoder_ISR() {}
+
+void AiEsp32RotaryEncoder::readButton_ISR() {}
+
+bool AiEsp32RotaryEncoder::isEncoderButtonClicked() { return false; }
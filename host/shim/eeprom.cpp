@@ -0,0 +1,33 @@
+#include <EEPROM.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+EEPROMClass EEPROM;
+
+bool EEPROMClass::begin(size_t size) {
+  data_.assign(size, 0xFF);
+  const char* path = getenv("NERDSTAR_EEPROM");
+  path_ = path ? path : "";
+  if (path_.empty()) {
+    return true;
+  }
+  if (FILE* file = fopen(path_.c_str(), "rb")) {
+    size_t loaded = fread(data_.data(), 1, data_.size(), file);
+    (void)loaded;
+    fclose(file);
+  }
+  return true;
+}
+
+bool EEPROMClass::commit() {
+  if (path_.empty()) {
+    return true;
+  }
+  FILE* file = fopen(path_.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = fwrite(data_.data(), 1, data_.size(), file) == data_.size();
+  return fclose(file) == 0 && ok;
+}
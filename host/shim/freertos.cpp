@@ -0,0 +1,101 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+
+// Tasks are detached threads and ticks are milliseconds. Critical sections
+// only exclude other threads; nothing is masked.
+
+struct HostSemaphore {
+  std::recursive_timed_mutex mutex;
+};
+
+static_assert(sizeof(HostSemaphore) <= sizeof(StaticSemaphore_t),
+              "StaticSemaphore_t too small for the host semaphore");
+
+namespace {
+
+uint64_t threadId(std::thread::id id) {
+  // 0 marks a free mux, so never hand it out.
+  return std::hash<std::thread::id>{}(id) | 1u;
+}
+
+bool takeFor(SemaphoreHandle_t handle, TickType_t ticks) {
+  if (!handle) {
+    return false;
+  }
+  if (ticks == portMAX_DELAY) {
+    handle->mutex.lock();
+    return true;
+  }
+  return handle->mutex.try_lock_for(std::chrono::milliseconds(ticks));
+}
+
+}  // namespace
+
+void hostEnterCritical(portMUX_TYPE* mux) {
+  const uint64_t self = threadId(std::this_thread::get_id());
+  if (mux->owner.load(std::memory_order_acquire) == self) {
+    ++mux->count;
+    return;
+  }
+  uint64_t expected = 0;
+  while (!mux->owner.compare_exchange_weak(expected, self, std::memory_order_acquire)) {
+    expected = 0;
+    std::this_thread::yield();
+  }
+  mux->count = 1;
+}
+
+void hostExitCritical(portMUX_TYPE* mux) {
+  if (--mux->count == 0) {
+    mux->owner.store(0, std::memory_order_release);
+  }
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* params,
+                                   UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+  std::thread task(fn, params);
+  if (handle) {
+    *handle = reinterpret_cast<TaskHandle_t>(static_cast<uintptr_t>(threadId(task.get_id())));
+  }
+  task.detach();
+  return pdPASS;
+}
+
+TickType_t xTaskGetTickCount() { return millis(); }
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore; }
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new HostSemaphore; }
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t* buffer) {
+  return new (buffer->storage) HostSemaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks) {
+  return takeFor(handle, ticks) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle) {
+  if (!handle) {
+    return pdFALSE;
+  }
+  handle->mutex.unlock();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t handle, TickType_t ticks) {
+  return xSemaphoreTake(handle, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t handle) { return xSemaphoreGive(handle); }
@@ -0,0 +1,16 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+struct HostSemaphore;
+typedef HostSemaphore* SemaphoreHandle_t;
+struct StaticSemaphore_t {
+  alignas(16) unsigned char storage[128];
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t* buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t handle, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t handle);
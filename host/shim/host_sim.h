@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+// Deterministic time for single-threaded simulations. While a simulation
+// runs, esp_timer_get_time(), micros() and millis() read a virtual clock that
+// only moves when firmware code waits (delay, vTaskDelay, esp_rom_delay_us,
+// taskYIELD) or when a modelled CPU cost is charged, so every run of the same
+// scenario produces the same edges.
+namespace host_sim {
+
+struct Config {
+  int64_t startNs = 0;
+  uint32_t timerReadCostNs = 0;  // charged per esp_timer_get_time()/micros()/millis()
+  uint32_t pinWriteCostNs = 0;   // charged per digitalWrite()
+  uint32_t yieldCostNs = 0;      // charged per taskYIELD()
+  // Called for every digitalWrite() with the time the write happened.
+  void (*onPinWrite)(uint8_t pin, uint8_t level, int64_t nowNs, void* context) = nullptr;
+  // Called after a wait moved the clock; may throw to unwind a task loop.
+  void (*onWait)(int64_t nowNs, void* context) = nullptr;
+  void* context = nullptr;
+};
+
+void begin(const Config& config);
+void end();
+bool active();
+int64_t nowNs();
+// Moves the clock forward without firing onWait.
+void charge(uint64_t ns);
+// Moves the clock forward as a wait and fires onWait.
+void wait(uint64_t ns);
+
+}  // namespace host_sim
@@ -0,0 +1,208 @@
+#include <HardwareSerial.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+HardwareSerial Serial(0);
+
+namespace {
+
+constexpr size_t kReadChunk = 512;
+
+speed_t termiosSpeed(unsigned long baud) {
+  switch (baud) {
+    case 9600:
+      return B9600;
+    case 19200:
+      return B19200;
+    case 38400:
+      return B38400;
+    case 57600:
+      return B57600;
+    case 115200:
+      return B115200;
+    case 230400:
+      return B230400;
+    case 460800:
+      return B460800;
+    case 921600:
+      return B921600;
+    case 2000000:
+      return B2000000;
+    default:
+      return B115200;
+  }
+}
+
+// Raw 8N1 so no byte is translated or swallowed. A pty ignores the rate.
+void configureTty(int fd, unsigned long baud) {
+  termios settings{};
+  if (tcgetattr(fd, &settings) != 0) {
+    return;
+  }
+  cfmakeraw(&settings);
+  cfsetispeed(&settings, termiosSpeed(baud));
+  cfsetospeed(&settings, termiosSpeed(baud));
+  tcsetattr(fd, TCSANOW, &settings);
+}
+
+}  // namespace
+
+HardwareSerial::HardwareSerial(int uartNum) : uartNum_(uartNum) {}
+
+HardwareSerial::~HardwareSerial() { end(); }
+
+void HardwareSerial::begin(unsigned long baud, uint32_t, int8_t, int8_t) {
+  baud_ = static_cast<uint32_t>(baud);
+  if (readFd_ < 0 && !rxPipe_) {
+    openPort();
+  }
+}
+
+void HardwareSerial::openPort() {
+  if (uartNum_ == 0) {
+    readFd_ = STDIN_FILENO;
+    writeFd_ = STDOUT_FILENO;
+    return;
+  }
+
+  std::string variable = "NERDSTAR_UART" + std::to_string(uartNum_);
+  const char* path = getenv(variable.c_str());
+  int fd = -1;
+  if (path && *path) {
+    fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+      fprintf(stderr, "[HOST] Cannot open %s for UART%d: %s\n", path, uartNum_, strerror(errno));
+      return;
+    }
+  } else {
+    fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+      fprintf(stderr, "[HOST] Cannot create a pty for UART%d\n", uartNum_);
+      if (fd >= 0) {
+        close(fd);
+      }
+      return;
+    }
+    const char* peer = ptsname(fd);
+    spareFd_ = open(peer, O_RDWR | O_NOCTTY);
+    if (spareFd_ >= 0) {
+      configureTty(spareFd_, baud_);
+    }
+    fprintf(stderr, "[HOST] UART%d on %s (peer: %s=%s)\n", uartNum_, peer, variable.c_str(),
+            peer);
+  }
+  if (isatty(fd)) {
+    configureTty(fd, baud_);
+  }
+  readFd_ = fd;
+  writeFd_ = fd;
+  ownsFds_ = true;
+}
+
+void HardwareSerial::end() {
+  if (ownsFds_) {
+    close(readFd_);
+    if (spareFd_ >= 0) {
+      close(spareFd_);
+    }
+  }
+  readFd_ = -1;
+  writeFd_ = -1;
+  spareFd_ = -1;
+  ownsFds_ = false;
+}
+
+void HardwareSerial::updateBaudRate(unsigned long baud) {
+  baud_ = static_cast<uint32_t>(baud);
+  if (ownsFds_ && isatty(readFd_)) {
+    configureTty(readFd_, baud);
+  }
+}
+
+void HardwareSerial::connect(HardwareSerial& a, HardwareSerial& b) {
+  auto aToB = std::make_shared<Pipe>();
+  auto bToA = std::make_shared<Pipe>();
+  a.end();
+  b.end();
+  a.txPipe_ = aToB;
+  b.rxPipe_ = aToB;
+  b.txPipe_ = bToA;
+  a.rxPipe_ = bToA;
+}
+
+void HardwareSerial::fill() {
+  if (rxPipe_) {
+    std::lock_guard<std::mutex> lock(rxPipe_->mutex);
+    rx_.insert(rx_.end(), rxPipe_->bytes.begin(), rxPipe_->bytes.end());
+    rxPipe_->bytes.clear();
+    return;
+  }
+  if (readFd_ < 0) {
+    return;
+  }
+  pollfd descriptor{readFd_, POLLIN, 0};
+  while (poll(&descriptor, 1, 0) > 0 && (descriptor.revents & POLLIN)) {
+    uint8_t chunk[kReadChunk];
+    ssize_t count = ::read(readFd_, chunk, sizeof(chunk));
+    if (count <= 0) {
+      return;
+    }
+    rx_.insert(rx_.end(), chunk, chunk + count);
+  }
+}
+
+int HardwareSerial::available() {
+  fill();
+  return static_cast<int>(rx_.size());
+}
+
+int HardwareSerial::read() {
+  if (rx_.empty()) {
+    fill();
+  }
+  if (rx_.empty()) {
+    return -1;
+  }
+  uint8_t value = rx_.front();
+  rx_.pop_front();
+  return value;
+}
+
+int HardwareSerial::peek() {
+  if (rx_.empty()) {
+    fill();
+  }
+  return rx_.empty() ? -1 : rx_.front();
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+// A full pty drops bytes rather than blocking, as a UART with nobody
+// listening would.
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (txPipe_) {
+    std::lock_guard<std::mutex> lock(txPipe_->mutex);
+    txPipe_->bytes.insert(txPipe_->bytes.end(), buffer, buffer + size);
+    return size;
+  }
+  if (writeFd_ < 0) {
+    return 0;
+  }
+  size_t written = 0;
+  while (written < size) {
+    ssize_t count = ::write(writeFd_, buffer + written, size - written);
+    if (count <= 0) {
+      break;
+    }
+    written += static_cast<size_t>(count);
+  }
+  return written;
+}
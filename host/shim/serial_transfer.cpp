@@ -0,0 +1,148 @@
+#include <SerialTransfer.h>
+
+#include <Arduino.h>
+
+namespace {
+
+constexpr uint8_t kStartByte = 0x7E;
+constexpr uint8_t kStopByte = 0x81;
+constexpr uint8_t kCrcPolynomial = 0x9B;
+constexpr uint8_t kNoStuffedByte = 0xFF;
+
+uint8_t crc8(uint8_t crc, uint8_t value) {
+  crc ^= value;
+  for (int bit = 0; bit < 8; ++bit) {
+    crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ kCrcPolynomial)
+                       : static_cast<uint8_t>(crc << 1);
+  }
+  return crc;
+}
+
+// Every start byte in the payload is replaced by the distance to the next
+// one (0 for the last); the header carries the index of the first.
+uint8_t stuff(uint8_t* buffer, uint8_t length) {
+  int16_t next = -1;
+  for (int16_t i = static_cast<int16_t>(length) - 1; i >= 0; --i) {
+    if (buffer[i] == kStartByte) {
+      buffer[i] = next < 0 ? 0 : static_cast<uint8_t>(next - i);
+      next = i;
+    }
+  }
+  return next < 0 ? kNoStuffedByte : static_cast<uint8_t>(next);
+}
+
+void unstuff(uint8_t* buffer, uint8_t length, uint8_t first) {
+  uint16_t index = first;
+  while (index < length) {
+    uint8_t delta = buffer[index];
+    buffer[index] = kStartByte;
+    if (delta == 0) {
+      break;
+    }
+    index += delta;
+  }
+}
+
+}  // namespace
+
+void SerialTransfer::begin(Stream& port, uint32_t timeoutMs) {
+  port_ = &port;
+  timeoutMs_ = timeoutMs;
+  state_ = State::kStart;
+  status = kNoData;
+}
+
+uint8_t SerialTransfer::sendData(uint16_t messageLen, uint8_t packetId) {
+  if (!port_ || messageLen > kMaxPacketSize) {
+    return 0;
+  }
+  const uint8_t length = static_cast<uint8_t>(messageLen);
+  uint8_t frame[kMaxPacketSize + 6];
+  const uint8_t overhead = stuff(txBuff, length);
+  uint8_t crc = 0;
+  frame[0] = kStartByte;
+  frame[1] = packetId;
+  frame[2] = overhead;
+  frame[3] = length;
+  for (uint8_t i = 0; i < length; ++i) {
+    frame[4 + i] = txBuff[i];
+    crc = crc8(crc, txBuff[i]);
+  }
+  frame[4 + length] = crc;
+  frame[5 + length] = kStopByte;
+  // Callers may resend the buffer, so leave it as they wrote it.
+  unstuff(txBuff, length, overhead);
+  port_->write(frame, length + 6u);
+  return length;
+}
+
+uint8_t SerialTransfer::available() {
+  if (!port_) {
+    return 0;
+  }
+  if (port_->available() <= 0) {
+    if (state_ != State::kStart && millis() - lastByteMs_ > timeoutMs_) {
+      state_ = State::kStart;
+      status = kStalePacketError;
+    } else {
+      status = state_ == State::kStart ? kNoData : kContinue;
+    }
+    return 0;
+  }
+
+  while (port_->available() > 0) {
+    const uint8_t value = static_cast<uint8_t>(port_->read());
+    lastByteMs_ = millis();
+    status = kContinue;
+    switch (state_) {
+      case State::kStart:
+        if (value == kStartByte) {
+          state_ = State::kId;
+        }
+        break;
+      case State::kId:
+        state_ = State::kOverhead;
+        break;
+      case State::kOverhead:
+        overhead_ = value;
+        state_ = State::kLength;
+        break;
+      case State::kLength:
+        if (value == 0 || value > kMaxPacketSize) {
+          state_ = State::kStart;
+          status = kPayloadError;
+          return 0;
+        }
+        expected_ = value;
+        received_ = 0;
+        crc_ = 0;
+        state_ = State::kPayload;
+        break;
+      case State::kPayload:
+        rxBuff[received_++] = value;
+        crc_ = crc8(crc_, value);
+        if (received_ == expected_) {
+          state_ = State::kCrc;
+        }
+        break;
+      case State::kCrc:
+        if (value != crc_) {
+          state_ = State::kStart;
+          status = kCrcError;
+          return 0;
+        }
+        state_ = State::kEnd;
+        break;
+      case State::kEnd:
+        state_ = State::kStart;
+        if (value != kStopByte) {
+          status = kStopByteError;
+          return 0;
+        }
+        unstuff(rxBuff, expected_, overhead_);
+        status = kNewData;
+        return expected_;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,403 @@
+// Runs the main board's motor task on the simulated clock and measures the
+// step edges it produces: interval jitter against the commanded rate, rate
+// error, missed deadlines, queued velocity segments and the highest step rate
+// the scheduler sustains.
+//
+// Usage: motor_sim [--timer-cost-ns N] [--gpio-cost-ns N] [--yield-cost-ns N]
+//                  [--tolerance-us N] [--csv FILE]
+//
+// The costs model the CPU time of esp_timer_get_time(), digitalWrite() and a
+// task switch; they default to zero, which measures the scheduler alone.
+// --csv writes every edge of the goto scenario for offline comparison.
+// Exits non-zero when a single-axis constant rate misses a deadline or is off
+// by more than kMaxRateErrorPpm, or when the segment queue misses its step
+// counts or rates.
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "host_sim.h"
+#include "motion.h"
+
+namespace {
+
+constexpr double kMaxRateErrorPpm = 100.0;
+constexpr double kSegmentStepTolerance = 2.0;
+constexpr double kMaxSearchRate = 200000.0;
+constexpr double kSweepRates[] = {1, 10, 100, 1000, 5000, 10000, 20000, 30000};
+// Largest rate the Q16.16 rate snapshot can hold.
+constexpr double kMaxEngineRate = 2147483647.0 / 65536.0;
+
+struct StepEdge {
+  int64_t timeNs;
+  Axis axis;
+  int8_t direction;
+  double commandedStepsPerSecond;
+};
+
+struct Recorder {
+  std::vector<StepEdge> edges;
+  int8_t direction[2] = {1, 1};
+  bool pulseHigh[2] = {false, false};
+  int64_t stopAtNs = 0;
+};
+
+struct Metrics {
+  size_t steps = 0;
+  double commandedStepsPerSecond = 0.0;
+  double achievedStepsPerSecond = 0.0;
+  double rateErrorPpm = 0.0;
+  double jitterRmsUs = 0.0;
+  double jitterMaxUs = 0.0;
+  size_t missedDeadlines = 0;
+  double maxStepsPerSecond = 0.0;
+};
+
+struct Options {
+  host_sim::Config clock;
+  double toleranceUs = 5.0;
+  const char* csvPath = nullptr;
+};
+
+// Thrown from the wait hook to leave motorTaskLoop().
+struct Stop {};
+
+Recorder recorder;
+
+int axisIndex(Axis axis) { return axis == Axis::Az ? 0 : 1; }
+
+void onPinWrite(uint8_t pin, uint8_t level, int64_t nowNs, void*) {
+  const Axis axes[] = {Axis::Az, Axis::Alt};
+  const uint8_t dirPins[] = {config::DIR_RA, config::DIR_DEC};
+  const uint8_t stepPins[] = {config::STEP_RA, config::STEP_DEC};
+  for (Axis axis : axes) {
+    const int index = axisIndex(axis);
+    if (pin == dirPins[index]) {
+      recorder.direction[index] = level == HIGH ? 1 : -1;
+    } else if (pin == stepPins[index]) {
+      recorder.pulseHigh[index] = level == HIGH;
+      if (level == HIGH) {
+        recorder.edges.push_back({nowNs, axis, recorder.direction[index],
+                                  std::fabs(motion::getStepsPerSecond(axis))});
+      }
+    }
+  }
+}
+
+// Only stops between pulses so no step is cut in half.
+void onWait(int64_t nowNs, void*) {
+  if (nowNs >= recorder.stopAtNs && !recorder.pulseHigh[0] && !recorder.pulseHigh[1]) {
+    throw Stop{};
+  }
+}
+
+void runFor(double seconds) {
+  recorder.stopAtNs = host_sim::nowNs() + static_cast<int64_t>(seconds * 1e9);
+  try {
+    motion::motorTaskLoop();
+  } catch (const Stop&) {
+  }
+}
+
+void settle() {
+  motion::stopAll();
+  runFor(0.01);
+  recorder.edges.clear();
+}
+
+// Intervals are judged against requested when given, otherwise against the
+// rate the engine reported at each edge.
+Metrics measure(Axis axis, double toleranceUs, double requested = 0.0) {
+  Metrics metrics;
+  const StepEdge* previous = nullptr;
+  double commandedSum = 0.0;
+  double squareSum = 0.0;
+  size_t intervals = 0;
+  int64_t firstNs = 0;
+  int64_t lastNs = 0;
+  int64_t minIntervalNs = INT64_MAX;
+  for (const StepEdge& edge : recorder.edges) {
+    if (edge.axis != axis) {
+      continue;
+    }
+    if (metrics.steps++ == 0) {
+      firstNs = edge.timeNs;
+    }
+    lastNs = edge.timeNs;
+    const double commanded = requested > 0.0 ? requested : edge.commandedStepsPerSecond;
+    if (previous && previous->direction == edge.direction && commanded > 0.0) {
+      const int64_t intervalNs = edge.timeNs - previous->timeNs;
+      const double errorUs = (intervalNs - 1e9 / commanded) / 1000.0;
+      squareSum += errorUs * errorUs;
+      metrics.jitterMaxUs = std::max(metrics.jitterMaxUs, std::fabs(errorUs));
+      if (errorUs > toleranceUs) {
+        ++metrics.missedDeadlines;
+      }
+      commandedSum += commanded;
+      minIntervalNs = std::min(minIntervalNs, intervalNs);
+      ++intervals;
+    }
+    previous = &edge;
+  }
+  if (intervals == 0) {
+    return metrics;
+  }
+  metrics.commandedStepsPerSecond = commandedSum / intervals;
+  metrics.achievedStepsPerSecond = (metrics.steps - 1) * 1e9 / (lastNs - firstNs);
+  metrics.rateErrorPpm = (metrics.achievedStepsPerSecond - metrics.commandedStepsPerSecond) /
+                         metrics.commandedStepsPerSecond * 1e6;
+  metrics.jitterRmsUs = std::sqrt(squareSum / intervals);
+  metrics.maxStepsPerSecond = minIntervalNs > 0 ? 1e9 / minIntervalNs : 0.0;
+  return metrics;
+}
+
+void printHeader(const char* title) {
+  printf("\n%s\n", title);
+  printf("%-14s %8s %12s %12s %10s %9s %9s %7s %12s\n", "case", "steps", "cmd sps", "got sps",
+         "err ppm", "rms us", "max us", "missed", "max sps");
+}
+
+// Rate error is left out for ramps, where the mean of the commanded rates is
+// not what the edges should average to.
+void printRow(const char* name, const Metrics& m, bool showRateError = true) {
+  char error[16] = "-";
+  if (showRateError) {
+    snprintf(error, sizeof(error), "%.1f", m.rateErrorPpm);
+  }
+  printf("%-14s %8zu %12.2f %12.2f %10s %9.3f %9.3f %7zu %12.1f\n", name, m.steps,
+         m.commandedStepsPerSecond, m.achievedStepsPerSecond, error, m.jitterRmsUs,
+         m.jitterMaxUs, m.missedDeadlines, m.maxStepsPerSecond);
+}
+
+Metrics runConstantRate(double azRate, double altRate, double seconds, double toleranceUs,
+                        Axis measured) {
+  settle();
+  motion::setGotoStepsPerSecond(Axis::Az, azRate);
+  motion::setGotoStepsPerSecond(Axis::Alt, altRate);
+  runFor(seconds);
+  return measure(measured, toleranceUs, measured == Axis::Az ? azRate : altRate);
+}
+
+double secondsFor(double rate) { return std::clamp(2000.0 / rate, 0.2, 30.0); }
+
+bool passes(const Metrics& m, double maxErrorPpm) {
+  return m.steps > 1 && m.missedDeadlines == 0 && std::fabs(m.rateErrorPpm) <= maxErrorPpm;
+}
+
+bool sweep(const Options& options) {
+  printHeader("Constant rate, Az only");
+  bool ok = true;
+  for (double rate : kSweepRates) {
+    Metrics m = runConstantRate(rate, 0.0, secondsFor(rate), options.toleranceUs, Axis::Az);
+    char name[32];
+    snprintf(name, sizeof(name), "az %.0f", rate);
+    printRow(name, m);
+    ok = ok && passes(m, kMaxRateErrorPpm);
+  }
+  return ok;
+}
+
+void bothAxes(const Options& options) {
+  printHeader("Constant rate, both axes");
+  const double pairs[][2] = {{1000, 700}, {10000, 7000}, {20000, 15000}, {30000, 25000}};
+  for (const auto& pair : pairs) {
+    Metrics az = runConstantRate(pair[0], pair[1], 0.5, options.toleranceUs, Axis::Az);
+    Metrics alt = measure(Axis::Alt, options.toleranceUs, pair[1]);
+    char name[32];
+    snprintf(name, sizeof(name), "az %.0f", pair[0]);
+    printRow(name, az);
+    snprintf(name, sizeof(name), "alt %.0f", pair[1]);
+    printRow(name, alt);
+  }
+}
+
+void gotoMove(const Options& options) {
+  printHeader("Coordinated goto, 3 deg/s, 1 deg/s^2");
+  settle();
+  motion::setStepCount(Axis::Az, 0);
+  motion::setStepCount(Axis::Alt, 0);
+  const int64_t azTarget = motion::azDegreesToSteps(20.0);
+  const int64_t altTarget = motion::altDegreesToSteps(10.0);
+  GotoProfile profile{3.0f, 1.0f, 1.0f};
+  motion::moveTo(azTarget, altTarget, profile, MoveMode::Coordinated);
+  double elapsed = 0.0;
+  while (elapsed < 60.0) {
+    runFor(0.1);
+    elapsed += 0.1;
+    if (!motion::isMoveActive()) {
+      break;
+    }
+  }
+  printRow("az", measure(Axis::Az, options.toleranceUs), false);
+  printRow("alt", measure(Axis::Alt, options.toleranceUs), false);
+  printf("finished after %.1f s, position error az %lld alt %lld steps\n", elapsed,
+         static_cast<long long>(motion::getStepCount(Axis::Az) - azTarget),
+         static_cast<long long>(motion::getStepCount(Axis::Alt) - altTarget));
+}
+
+// Steps of the axis in [fromNs, toNs) and, when there are two or more, the
+// rate implied by the first and last of them.
+size_t stepsBetween(Axis axis, int64_t fromNs, int64_t toNs, double* rate = nullptr) {
+  size_t steps = 0;
+  int64_t firstNs = 0;
+  int64_t lastNs = 0;
+  for (const StepEdge& edge : recorder.edges) {
+    if (edge.axis != axis || edge.timeNs < fromNs || edge.timeNs >= toNs) {
+      continue;
+    }
+    if (steps++ == 0) {
+      firstNs = edge.timeNs;
+    }
+    lastNs = edge.timeNs;
+  }
+  if (rate) {
+    *rate = steps > 1 ? (steps - 1) * 1e9 / (lastNs - firstNs) : 0.0;
+  }
+  return steps;
+}
+
+// Queued velocity segments on Az: a cruise, a ramp and a slower cruise back
+// to back. Each segment must produce its integral within kSegmentStepTolerance
+// steps, so boundaries land within a step or two of their time, the cruises
+// must hold their rate within kMaxRateErrorPpm, and the axis must stop when
+// the queue runs dry.
+bool segmentQueue(const Options& options) {
+  printHeader("Segment queue, Az");
+  settle();
+  const VelocitySegment segments[] = {
+      {0, 500, 2000.0f, 0.0f},
+      {500, 1000, 2000.0f, 2000.0f},
+      {1500, 500, 1000.0f, 0.0f},
+  };
+  const int64_t startNs = host_sim::nowNs();
+  if (!motion::queueSegments(Axis::Az, segments, sizeof(segments) / sizeof(segments[0]))) {
+    printf("queueSegments rejected the segments\n");
+    return false;
+  }
+  runFor(2.5);
+  printRow("all", measure(Axis::Az, options.toleranceUs), false);
+
+  bool ok = true;
+  for (const VelocitySegment& segment : segments) {
+    const int64_t fromNs = startNs + static_cast<int64_t>(segment.startMs) * 1000000;
+    const int64_t toNs = fromNs + static_cast<int64_t>(segment.durationMs) * 1000000;
+    const double seconds = segment.durationMs / 1000.0;
+    const double expected = segment.startStepsPerSecond * seconds +
+                            0.5 * segment.accelStepsPerSecond2 * seconds * seconds;
+    double rate = 0.0;
+    const size_t steps = stepsBetween(Axis::Az, fromNs, toNs, &rate);
+    bool segmentOk = std::fabs(steps - expected) <= kSegmentStepTolerance;
+    char error[16] = "-";
+    if (segment.accelStepsPerSecond2 == 0.0f) {
+      const double ppm = (rate - segment.startStepsPerSecond) / segment.startStepsPerSecond * 1e6;
+      snprintf(error, sizeof(error), "%.1f", ppm);
+      segmentOk = segmentOk && std::fabs(ppm) <= kMaxRateErrorPpm;
+    }
+    printf("%5u-%-5u ms  %6zu steps (expected %.0f), rate error %s ppm  %s\n", segment.startMs,
+           segment.startMs + segment.durationMs, steps, expected, error,
+           segmentOk ? "ok" : "FAIL");
+    ok = ok && segmentOk;
+  }
+  const int64_t endNs = startNs + 2000LL * 1000000;
+  const size_t after = stepsBetween(Axis::Az, endNs + 1000000, INT64_MAX);
+  printf("steps more than 1 ms after the last segment: %zu\n", after);
+  return ok && after == 0;
+}
+
+// Highest single-axis rate that keeps every deadline and stays within
+// kMaxRateErrorPpm, found by doubling and then bisecting.
+void maxRate(const Options& options) {
+  auto sustains = [&](double rate) {
+    return passes(runConstantRate(rate, 0.0, 0.05, options.toleranceUs, Axis::Az),
+                  kMaxRateErrorPpm);
+  };
+  double good = 0.0;
+  double bad = kMaxSearchRate;
+  for (double rate = 1000.0; rate < kMaxSearchRate; rate *= 2.0) {
+    if (!sustains(rate)) {
+      bad = rate;
+      break;
+    }
+    good = rate;
+  }
+  while (bad - good > 100.0) {
+    double middle = (good + bad) / 2.0;
+    (sustains(middle) ? good : bad) = middle;
+  }
+  printf("\nMax sustained Az rate: %.0f steps/s (rate format limit %.0f)\n", good,
+         kMaxEngineRate);
+}
+
+void writeCsv(const char* path) {
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return;
+  }
+  fprintf(file, "time_ns,axis,direction,commanded_sps\n");
+  for (const StepEdge& edge : recorder.edges) {
+    fprintf(file, "%lld,%s,%d,%.3f\n", static_cast<long long>(edge.timeNs),
+            edge.axis == Axis::Az ? "az" : "alt", edge.direction,
+            edge.commandedStepsPerSecond);
+  }
+  fclose(file);
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* name = argv[i];
+    const char* value = argv[i + 1];
+    if (strcmp(name, "--timer-cost-ns") == 0) {
+      options.clock.timerReadCostNs = static_cast<uint32_t>(atoi(value));
+    } else if (strcmp(name, "--gpio-cost-ns") == 0) {
+      options.clock.pinWriteCostNs = static_cast<uint32_t>(atoi(value));
+    } else if (strcmp(name, "--yield-cost-ns") == 0) {
+      options.clock.yieldCostNs = static_cast<uint32_t>(atoi(value));
+    } else if (strcmp(name, "--tolerance-us") == 0) {
+      options.toleranceUs = atof(value);
+    } else if (strcmp(name, "--csv") == 0) {
+      options.csvPath = value;
+    } else {
+      fprintf(stderr, "Unknown option %s\n", name);
+    }
+  }
+  options.clock.onPinWrite = onPinWrite;
+  options.clock.onWait = onWait;
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+  host_sim::begin(options.clock);
+  motion::init();
+
+  printf("Costs: timer %u ns, gpio %u ns, yield %u ns; deadline tolerance %.1f us\n",
+         options.clock.timerReadCostNs, options.clock.pinWriteCostNs, options.clock.yieldCostNs,
+         options.toleranceUs);
+  bool ok = sweep(options);
+  bothAxes(options);
+  gotoMove(options);
+  if (options.csvPath) {
+    writeCsv(options.csvPath);
+  }
+  ok = segmentQueue(options) && ok;
+  maxRate(options);
+
+  host_sim::end();
+  if (!ok) {
+    printf("\nFAILED: a constant rate or the segment queue missed deadlines, rate or step "
+           "count bounds\n");
+  }
+  return ok ? 0 : 1;
+}
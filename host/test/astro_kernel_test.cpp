@@ -0,0 +1,120 @@
+// Checks the float astronomy kernel against the double reference over
+// 2000-2050: sidereal time, both coordinate transforms and every planet must
+// stay within astronomy::kFloatKernelErrorArcsec. Also checks that the double
+// transforms invert each other (up to refraction). Exits non-zero on failure.
+
+#include <Arduino.h>
+#include <RTClib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "astro_time.h"
+#include "astronomy.h"
+#include "planets.h"
+
+namespace {
+
+constexpr int kSamples = 20000;
+constexpr double kRoundTripArcsec = 0.001;
+constexpr PlanetId kPlanets[] = {PlanetId::Mercury, PlanetId::Venus,  PlanetId::Mars,
+                                 PlanetId::Jupiter, PlanetId::Saturn, PlanetId::Uranus,
+                                 PlanetId::Neptune};
+
+uint32_t seed = 2024;
+
+double uniform(double low, double high) {
+  seed = seed * 1664525u + 1013904223u;
+  return low + (high - low) * (seed / 4294967296.0);
+}
+
+// Angle between two directions given as (longitude, latitude) in degrees.
+double separationArcsec(double lon1, double lat1, double lon2, double lat2) {
+  double sinDLat = sin((lat2 - lat1) * DEG_TO_RAD / 2.0);
+  double sinDLon = sin((lon2 - lon1) * DEG_TO_RAD / 2.0);
+  double h = sinDLat * sinDLat +
+             cos(lat1 * DEG_TO_RAD) * cos(lat2 * DEG_TO_RAD) * sinDLon * sinDLon;
+  return 2.0 * asin(std::min(1.0, sqrt(h))) * RAD_TO_DEG * 3600.0;
+}
+
+struct Check {
+  const char* name;
+  double bound;
+  double maxError = 0.0;
+
+  void add(double error) { maxError = std::max(maxError, error); }
+  bool report() const {
+    bool ok = maxError <= bound;
+    printf("%-20s max %9.4f arcsec (bound %.3f)  %s\n", name, maxError, bound,
+           ok ? "ok" : "FAIL");
+    return ok;
+  }
+};
+
+}  // namespace
+
+int main() {
+  const double bound = astronomy::kFloatKernelErrorArcsec;
+  Check sidereal{"sidereal time", bound};
+  Check horizontal{"ra/dec -> alt/az", bound};
+  Check equatorial{"alt/az -> ra/dec", bound};
+  Check planet{"planets", bound};
+  Check roundTrip{"double round trip", kRoundTripArcsec};
+
+  const int64_t start = astro_time::microsSinceJ2000(DateTime(2000, 1, 1, 0, 0, 0).unixtime());
+  const int64_t end = astro_time::microsSinceJ2000(DateTime(2050, 1, 1, 0, 0, 0).unixtime());
+  for (int i = 0; i < kSamples; ++i) {
+    const int64_t micros = start + static_cast<int64_t>(uniform(0.0, 1.0) * (end - start));
+    const double jd = astronomy::julianDayAt(micros);
+    const double latitude = uniform(-65.0, 65.0);
+    const double longitude = uniform(-180.0, 180.0);
+
+    const double lst = astronomy::siderealDegrees(jd, longitude);
+    const float lstFloat = astronomy::siderealDegreesAt(micros, static_cast<float>(longitude));
+    sidereal.add(fabs(astronomy::wrapAngle180(lstFloat - lst)) * 3600.0);
+
+    const double ra = uniform(0.0, 24.0);
+    const double dec = uniform(-89.5, 89.5);
+    double az;
+    double alt;
+    float azFloat;
+    float altFloat;
+    astronomy::equatorialToHorizontal(lst, ra, dec, latitude, az, alt);
+    astronomy::equatorialToHorizontal(lstFloat, static_cast<float>(ra), static_cast<float>(dec),
+                                      static_cast<float>(latitude), azFloat, altFloat);
+    horizontal.add(separationArcsec(azFloat, altFloat, az, alt));
+
+    const double azIn = uniform(0.0, 360.0);
+    const double altIn = uniform(-5.0, 89.9);
+    double raOut;
+    double decOut;
+    float raFloat;
+    float decFloat;
+    astronomy::horizontalToEquatorial(lst, azIn, altIn, latitude, raOut, decOut);
+    astronomy::horizontalToEquatorial(lstFloat, static_cast<float>(azIn),
+                                      static_cast<float>(altIn), static_cast<float>(latitude),
+                                      raFloat, decFloat);
+    equatorial.add(separationArcsec(raFloat * 15.0, decFloat, raOut * 15.0, decOut));
+
+    double azBack;
+    double altBack;
+    astronomy::equatorialToHorizontal(lst, raOut, decOut, latitude, azBack, altBack);
+    roundTrip.add(separationArcsec(azBack, altBack, azIn,
+                                   astronomy::applyAtmosphericRefraction(altIn)));
+
+    const PlanetId id = kPlanets[i % (sizeof(kPlanets) / sizeof(kPlanets[0]))];
+    PlanetPosition reference;
+    PlanetPosition position;
+    planets::computePlanet(id, jd, reference);
+    planets::computePlanetAt(id, micros, position);
+    planet.add(separationArcsec(position.raHours * 15.0, position.decDegrees,
+                                reference.raHours * 15.0, reference.decDegrees));
+  }
+
+  bool ok = true;
+  for (const Check* check : {&sidereal, &horizontal, &equatorial, &planet, &roundTrip}) {
+    ok = check->report() && ok;
+  }
+  return ok ? 0 : 1;
+}
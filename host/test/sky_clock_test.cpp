@@ -0,0 +1,154 @@
+// Runs the sky clock on the simulated clock against a modelled DS3231 whose
+// crystal is kRtcDriftPpm fast of esp_timer and whose reads take
+// kReadCostUs of bus time. The loop sleeps like the HID loop does. After the
+// drift window the clock must be locked, track the RTC within kMaxErrorUs,
+// estimate the drift within kDriftTolPpm and never run backwards; no
+// update() may hold the bus longer than kMaxUpdateUs. A step of the RTC must
+// be followed by the next sync, and after an NTP reference the RTC must be
+// written within kWriteWindowUs of a second boundary and tracked again.
+// Exits non-zero on failure.
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "host_sim.h"
+#include "sky_clock.h"
+
+namespace {
+
+constexpr double kRtcDriftPpm = 20.0;
+constexpr int64_t kReadCostUs = 800;  // one rtc.now() at 100 kHz
+constexpr int64_t kLoopPeriodUs = 20000;
+constexpr int64_t kStartUtcMicros = 1735689600LL * 1000000 + 123456;  // 2025-01-01
+constexpr int64_t kRunMicros = 30LL * 60 * 1000000;
+constexpr int64_t kSettleMicros = 20LL * 60 * 1000000;
+constexpr int64_t kMaxErrorUs = 1000;
+constexpr double kDriftTolPpm = 1.0;
+constexpr int64_t kStepSeconds = 3600;
+// One sync interval plus the coarse and fine acquisition.
+constexpr int64_t kMaxStepFollowMicros = 65LL * 1000000;
+// A fine burst plus the read that ends it.
+constexpr int64_t kMaxUpdateUs = 3000 + 2 * kReadCostUs;
+constexpr int64_t kNtpOffsetMicros = 2500000;
+constexpr int64_t kWriteWindowUs = 5000 + kReadCostUs;
+
+int64_t rtcOffsetMicros = 0;
+int writes = 0;
+int64_t writeLagUs = 0;
+
+int64_t timerMicros() { return host_sim::nowNs() / 1000; }
+
+int64_t trueUtcMicros() {
+  return kStartUtcMicros + rtcOffsetMicros +
+         static_cast<int64_t>(llround(timerMicros() * (1.0 + kRtcDriftPpm * 1e-6)));
+}
+
+// The registers are latched halfway through the transfer.
+bool readRtc(time_t& utcEpoch) {
+  host_sim::charge(kReadCostUs * 500);
+  utcEpoch = static_cast<time_t>(trueUtcMicros() / 1000000);
+  host_sim::charge(kReadCostUs * 500);
+  return true;
+}
+
+// The oscillator restarts at the write, halfway through the transfer.
+bool writeRtc(time_t utcEpoch) {
+  host_sim::charge(kReadCostUs * 500);
+  writeLagUs = sky_clock::nowUtcMicros() - static_cast<int64_t>(utcEpoch) * 1000000;
+  rtcOffsetMicros += static_cast<int64_t>(utcEpoch) * 1000000 - trueUtcMicros();
+  ++writes;
+  host_sim::charge(kReadCostUs * 500);
+  return true;
+}
+
+struct Result {
+  int64_t maxErrorUs = 0;
+  int64_t maxUpdateUs = 0;
+  bool backwards = false;
+  int64_t lastUtc = INT64_MIN;
+};
+
+// Runs the UI loop until untilMicros; errors count from countFromMicros.
+void run(int64_t untilMicros, int64_t countFromMicros, Result& result) {
+  while (timerMicros() < untilMicros) {
+    int64_t start = timerMicros();
+    sky_clock::update();
+    result.maxUpdateUs = std::max<int64_t>(result.maxUpdateUs, timerMicros() - start);
+    int64_t utc = sky_clock::nowUtcMicros();
+    if (utc < result.lastUtc) {
+      result.backwards = true;
+    }
+    result.lastUtc = utc;
+    if (timerMicros() >= countFromMicros) {
+      result.maxErrorUs = std::max<int64_t>(result.maxErrorUs, std::llabs(utc - trueUtcMicros()));
+    }
+    host_sim::wait(static_cast<int64_t>(sky_clock::sleepMicros(kLoopPeriodUs)) * 1000);
+  }
+}
+
+bool report(const char* name, bool ok, const char* detail) {
+  printf("%-24s %-32s %s\n", name, detail, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+}  // namespace
+
+int main() {
+  host_sim::Config config;
+  host_sim::begin(config);
+  sky_clock::setReader(readRtc);
+  sky_clock::setWriter(writeRtc);
+  sky_clock::set(static_cast<time_t>(kStartUtcMicros / 1000000 - 40), sky_clock::Source::Stored);
+
+  Result tracking;
+  run(kRunMicros, kSettleMicros, tracking);
+  sky_clock::Status status = sky_clock::status();
+
+  rtcOffsetMicros = kStepSeconds * 1000000;
+  int64_t stepAt = timerMicros();
+  Result step;
+  run(stepAt + kMaxStepFollowMicros + 60 * 1000000, stepAt + kMaxStepFollowMicros, step);
+
+  // NTP disagrees with the RTC by more than a step; the RTC is rewritten.
+  int64_t ntpAt = timerMicros();
+  sky_clock::addReference(trueUtcMicros() + kNtpOffsetMicros, ntpAt, 10000,
+                          sky_clock::Source::Ntp);
+  sky_clock::requestWrite();
+  Result ntp;
+  run(ntpAt + kMaxStepFollowMicros + 60 * 1000000, ntpAt + kMaxStepFollowMicros, ntp);
+  host_sim::end();
+
+  char detail[64];
+  bool ok = true;
+  snprintf(detail, sizeof(detail), "source %d", static_cast<int>(status.source));
+  ok = report("locked to rtc", status.locked && status.source == sky_clock::Source::Rtc,
+              detail) && ok;
+  snprintf(detail, sizeof(detail), "max %lld us (bound %lld)",
+           static_cast<long long>(tracking.maxErrorUs), static_cast<long long>(kMaxErrorUs));
+  ok = report("tracking error", tracking.maxErrorUs <= kMaxErrorUs, detail) && ok;
+  snprintf(detail, sizeof(detail), "%u us", status.uncertaintyMicros);
+  ok = report("edge uncertainty", status.uncertaintyMicros <= kMaxErrorUs, detail) && ok;
+  snprintf(detail, sizeof(detail), "%.3f ppm (model %.1f)", status.driftPpm, kRtcDriftPpm);
+  ok = report("drift estimate", fabs(status.driftPpm - kRtcDriftPpm) <= kDriftTolPpm, detail) &&
+       ok;
+  ok = report("monotonic", !tracking.backwards, "") && ok;
+  snprintf(detail, sizeof(detail), "max %lld us after %lld s",
+           static_cast<long long>(step.maxErrorUs),
+           static_cast<long long>(kMaxStepFollowMicros / 1000000));
+  ok = report("follows rtc step", step.maxErrorUs <= kMaxErrorUs, detail) && ok;
+  int64_t maxUpdateUs = std::max({tracking.maxUpdateUs, step.maxUpdateUs, ntp.maxUpdateUs});
+  snprintf(detail, sizeof(detail), "max %lld us (bound %lld)", static_cast<long long>(maxUpdateUs),
+           static_cast<long long>(kMaxUpdateUs));
+  ok = report("update duration", maxUpdateUs <= kMaxUpdateUs, detail) && ok;
+  snprintf(detail, sizeof(detail), "%d write, %lld us after edge", writes,
+           static_cast<long long>(writeLagUs));
+  ok = report("rtc written on edge", writes == 1 && writeLagUs >= 0 && writeLagUs <= kWriteWindowUs,
+              detail) && ok;
+  snprintf(detail, sizeof(detail), "max %lld us", static_cast<long long>(ntp.maxErrorUs));
+  ok = report("tracks rewritten rtc", ntp.maxErrorUs <= kMaxErrorUs, detail) && ok;
+  return ok ? 0 : 1;
+}
@@ -10,16 +10,52 @@ enum class Axis {
   Alt
 };
 
+enum class MoveMode : uint8_t {
+  Independent,  // Each axis runs its own trapezoid
+  Coordinated   // Faster axis is scaled so both arrive together
+};
+
+// One constant-acceleration piece of an axis velocity profile. startMs is on
+// the sender's clock; the main board aligns it to its own timeline when a
+// segment reaches an idle queue, later segments keep that alignment.
+struct VelocitySegment {
+  uint32_t startMs;
+  uint32_t durationMs;
+  float startStepsPerSecond;
+  float accelStepsPerSecond2;
+};
+
+// Cubic fit of the tracking target's step position over a short horizon:
+// p(tau) = baseSteps + c1 * tau + c2 * tau^2 + c3 * tau^3, tau = t / horizon,
+// with t counted from when the main board receives it.
+struct TrackingPolynomial {
+  int64_t baseSteps;
+  double c1;
+  double c2;
+  double c3;
+  uint32_t horizonMs;
+};
+
 namespace motion {
 
+constexpr size_t kSegmentQueueCapacity = 16;
+
 void init();
 void setManualRate(Axis axis, float rpm);
 void setManualStepsPerSecond(Axis axis, double stepsPerSecond);
 void setGotoStepsPerSecond(Axis axis, double stepsPerSecond);
 void clearGotoRates();
+bool moveTo(int64_t azTargetSteps, int64_t altTargetSteps, const GotoProfile& profile,
+            MoveMode mode = MoveMode::Coordinated);
+bool isMoveActive();
+bool queueSegments(Axis axis, const VelocitySegment* segments, size_t count);
+void clearSegments();
+size_t getFreeSegmentSlots(Axis axis);
 void stopAll();
 void setTrackingEnabled(bool enabled);
 void setTrackingRates(double azDegPerSec, double altDegPerSec);
+bool setTrackingPolynomial(Axis axis, const TrackingPolynomial& polynomial);
+void clearTrackingPolynomials();
 int64_t getStepCount(Axis axis);
 void setStepCount(Axis axis, int64_t value);
 double stepsToAzDegrees(int64_t steps);
@@ -32,10 +68,16 @@ void applyCalibration(const AxisCalibration& calibration);
 void setBacklash(const BacklashConfig& backlash);
 int32_t getBacklashSteps(Axis axis);
 int8_t getLastDirection(Axis axis);
+double getStepsPerSecond(Axis axis);
 void setAltitudeLimitsEnabled(bool enabled);
 
 #if defined(DEVICE_ROLE_MAIN)
 void motorTaskLoop();
+#elif defined(DEVICE_ROLE_HID)
+void syncCalibration();
+// clearGotoRates for user aborts: also sent as an emergency stop so it does
+// not wait behind queued requests.
+void abortGoto();
 #endif
 
 } // namespace motion
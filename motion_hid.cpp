@@ -2,54 +2,185 @@
 
 #if defined(DEVICE_ROLE_HID)
 
+#include <algorithm>
 #include <cmath>
-#include <cstdlib>
-#include <initializer_list>
 #include <limits>
-#include <vector>
 
 #include "comm.h"
+#include "rpc_protocol.h"
 #include "state.h"
+#include "step_conversion.h"
 
 namespace {
 
-const char* axisToString(Axis axis) {
-  return (axis == Axis::Az) ? "AZ" : "ALT";
-}
+uint8_t axisToWire(Axis axis) { return (axis == Axis::Az) ? rpc::kAxisAz : rpc::kAxisAlt; }
 
-String formatFloat(double value) { return String(value, 6); }
+size_t axisIndex(Axis axis) { return (axis == Axis::Az) ? 0 : 1; }
 
-int64_t parseInt64(const String& value) {
-  return static_cast<int64_t>(strtoll(value.c_str(), nullptr, 10));
+template <typename Req>
+bool callAndUpdate(rpc::Opcode opcode, const Req& request) {
+  bool success = comm::call(opcode, request);
+  systemState.manualCommandOk = success;
+  return success;
 }
 
-double parseDouble(const String& value) {
-  return strtod(value.c_str(), nullptr);
+template <typename Req, typename Resp>
+bool callAndUpdate(rpc::Opcode opcode, const Req& request, Resp& response) {
+  bool success = comm::call(opcode, request, response);
+  systemState.manualCommandOk = success;
+  return success;
 }
 
-size_t axisIndex(Axis axis) { return (axis == Axis::Az) ? 0 : 1; }
-
-bool callAndUpdate(const char* command, std::initializer_list<String> params,
-                   std::vector<String>* payload = nullptr) {
-  bool success = comm::call(command, params, payload);
+template <typename Resp>
+bool queryAndUpdate(rpc::Opcode opcode, Resp& response) {
+  bool success = comm::query(opcode, response);
   systemState.manualCommandOk = success;
   return success;
 }
 
-float lastManualRpm[2] = {std::numeric_limits<float>::quiet_NaN(),
-                          std::numeric_limits<float>::quiet_NaN()};
-uint32_t lastManualSendMs[2] = {0, 0};
+// Setters the caller does not need an answer for are posted without waiting;
+// the result only feeds the link status shown in the UI.
+void updateCommandState(const comm::Response& response, void*) {
+  if (response.result == comm::CallResult::kCancelled) {
+    return;  // never sent, says nothing about the link
+  }
+  systemState.manualCommandOk = response.result == comm::CallResult::kOk;
+}
+
+bool post(rpc::Opcode opcode) {
+  bool queued = comm::callAsync(opcode, nullptr, 0, updateCommandState);
+  if (!queued) {
+    systemState.manualCommandOk = false;
+  }
+  return queued;
+}
+
+template <typename Req>
+bool post(rpc::Opcode opcode, const Req& request,
+          comm::ResponseCallback callback = updateCommandState, void* context = nullptr) {
+  bool queued = comm::callAsync(opcode, request, callback, context);
+  if (!queued) {
+    systemState.manualCommandOk = false;
+  }
+  return queued;
+}
+
+// Per-tick setpoints are collected and leave as one frame when the loop
+// calls comm::flushBatch().
+template <typename Req>
+bool deferSetpoint(rpc::Opcode opcode, const Req& request,
+                   comm::ResponseCallback callback = updateCommandState,
+                   void* context = nullptr) {
+  bool queued = comm::defer(opcode, request, callback, context);
+  if (!queued) {
+    systemState.manualCommandOk = false;
+  }
+  return queued;
+}
+
+struct ManualRateCache {
+  float rpm;
+  uint32_t sentMs;
+};
+
+ManualRateCache manualCache[2] = {{std::numeric_limits<float>::quiet_NaN(), 0},
+                                  {std::numeric_limits<float>::quiet_NaN(), 0}};
 
 constexpr float kManualRpmDelta = 0.02f;
 constexpr uint32_t kManualRefreshIntervalMs = 250;
 
+void invalidateManualCache(ManualRateCache& cache) {
+  cache.rpm = std::numeric_limits<float>::quiet_NaN();
+  cache.sentMs = 0;
+}
+
 void invalidateManualCache() {
-  for (size_t i = 0; i < 2; ++i) {
-    lastManualRpm[i] = std::numeric_limits<float>::quiet_NaN();
-    lastManualSendMs[i] = 0;
+  for (auto& cache : manualCache) {
+    invalidateManualCache(cache);
+  }
+}
+
+// The cache is filled when the rate is posted; a failed call clears it so
+// the next joystick poll resends.
+void handleManualRateResponse(const comm::Response& response, void* context) {
+  updateCommandState(response, nullptr);
+  if (response.result != comm::CallResult::kOk) {
+    invalidateManualCache(*static_cast<ManualRateCache*>(context));
   }
 }
 
+// Last tracking setpoints posted. updateTracking() repeats them every tick
+// while idle or in a goto; an unchanged value is only resent after
+// kTrackingRefreshIntervalMs, and never while it is the main board's
+// power-on state (disabled, zero rates).
+struct TrackingCache {
+  bool ratesValid;
+  float azRate;
+  float altRate;
+  uint32_t ratesSentMs;
+  bool enabledValid;
+  bool enabled;
+  uint32_t enabledSentMs;
+};
+
+constexpr uint32_t kTrackingRefreshIntervalMs = 1000;
+
+TrackingCache trackingCache{};
+
+bool trackingRefreshDue(bool idle, uint32_t sentMs, uint32_t now) {
+  return !idle && (now - sentMs) >= kTrackingRefreshIntervalMs;
+}
+
+void handleTrackingRatesResponse(const comm::Response& response, void*) {
+  updateCommandState(response, nullptr);
+  if (response.result != comm::CallResult::kOk) {
+    trackingCache.ratesValid = false;
+  }
+}
+
+void handleTrackingEnabledResponse(const comm::Response& response, void*) {
+  updateCommandState(response, nullptr);
+  if (response.result != comm::CallResult::kOk) {
+    trackingCache.enabledValid = false;
+  }
+}
+
+// Local copy of the main board's calibration and altitude-limit state.
+// Conversions run against it, and the generation lets the main board report
+// which version it has applied.
+struct CalibrationMirror {
+  AxisCalibration calibration;
+  bool altitudeLimitsEnabled;
+  uint32_t generation;
+  uint32_t lastResyncMs;
+};
+
+constexpr uint32_t kCalibrationResyncIntervalMs = 1000;
+
+CalibrationMirror mirror{{0.0, 0.0, 0, 0}, true, 0, 0};
+portMUX_TYPE mirrorMux = portMUX_INITIALIZER_UNLOCKED;
+
+CalibrationMirror readMirror() {
+  portENTER_CRITICAL(&mirrorMux);
+  CalibrationMirror copy = mirror;
+  portEXIT_CRITICAL(&mirrorMux);
+  return copy;
+}
+
+void sendCalibration(const CalibrationMirror& state) {
+  const AxisCalibration& calibration = state.calibration;
+  post(rpc::Opcode::kApplyCalibration,
+       rpc::CalibrationRequest{calibration.stepsPerDegreeAz, calibration.stepsPerDegreeAlt,
+                               calibration.azHomeOffset, calibration.altHomeOffset,
+                               state.generation});
+}
+
+void sendAltitudeLimits(const CalibrationMirror& state) {
+  post(rpc::Opcode::kSetAltLimitsEnabled,
+       rpc::AltitudeLimitsRequest{static_cast<uint8_t>(state.altitudeLimitsEnabled),
+                                  state.generation});
+}
+
 }  // namespace
 
 namespace motion {
@@ -61,8 +192,8 @@ void init() {
 }
 
 void setManualRate(Axis axis, float rpm) {
-  size_t index = axisIndex(axis);
-  float previous = lastManualRpm[index];
+  ManualRateCache& cache = manualCache[axisIndex(axis)];
+  float previous = cache.rpm;
   uint32_t now = millis();
 
   bool shouldSend = false;
@@ -70,8 +201,7 @@ void setManualRate(Axis axis, float rpm) {
     shouldSend = true;
   } else if (fabsf(previous - rpm) > kManualRpmDelta) {
     shouldSend = true;
-  } else if (lastManualSendMs[index] == 0 ||
-             (now - lastManualSendMs[index]) >= kManualRefreshIntervalMs) {
+  } else if (cache.sentMs == 0 || (now - cache.sentMs) >= kManualRefreshIntervalMs) {
     shouldSend = true;
   }
 
@@ -79,150 +209,274 @@ void setManualRate(Axis axis, float rpm) {
     return;
   }
 
-  if (callAndUpdate("SET_MANUAL_RPM",
-                    {String(axisToString(axis)), formatFloat(rpm)})) {
-    lastManualRpm[index] = rpm;
-    lastManualSendMs[index] = now;
+  // Both axes are usually updated back to back and share one batch frame.
+  if (deferSetpoint(rpc::Opcode::kSetManualRpm, rpc::AxisFloat{axisToWire(axis), rpm},
+                    handleManualRateResponse, &cache)) {
+    cache.rpm = rpm;
+    cache.sentMs = now;
   }
 }
 
 void setManualStepsPerSecond(Axis axis, double stepsPerSecond) {
-  if (callAndUpdate("SET_MANUAL_SPS",
-                    {String(axisToString(axis)), formatFloat(stepsPerSecond)})) {
-    lastManualRpm[axisIndex(axis)] = std::numeric_limits<float>::quiet_NaN();
-    lastManualSendMs[axisIndex(axis)] = 0;
-  }
+  rpc::AxisFloat request{axisToWire(axis), static_cast<float>(stepsPerSecond)};
+  invalidateManualCache(manualCache[axisIndex(axis)]);
+  deferSetpoint(rpc::Opcode::kSetManualSps, request);
 }
 
 void setGotoStepsPerSecond(Axis axis, double stepsPerSecond) {
-  callAndUpdate("SET_GOTO_SPS",
-                {String(axisToString(axis)), formatFloat(stepsPerSecond)});
+  deferSetpoint(rpc::Opcode::kSetGotoSps,
+                rpc::AxisFloat{axisToWire(axis), static_cast<float>(stepsPerSecond)});
 }
 
-void clearGotoRates() { callAndUpdate("CLEAR_GOTO", {}); }
+void clearGotoRates() { post(rpc::Opcode::kClearGoto); }
 
-void stopAll() {
-  if (callAndUpdate("STOP_ALL", {})) {
-    invalidateManualCache();
+void abortGoto() {
+  comm::sendEmergencyStop(rpc::StopScope::kGoto);
+  clearGotoRates();
+}
+
+bool moveTo(int64_t azTargetSteps, int64_t altTargetSteps, const GotoProfile& profile,
+            MoveMode mode) {
+  rpc::MoveToRequest request{};
+  request.azTargetSteps = azTargetSteps;
+  request.altTargetSteps = altTargetSteps;
+  request.maxSpeedDegPerSec = profile.maxSpeedDegPerSec;
+  request.accelerationDegPerSec2 = profile.accelerationDegPerSec2;
+  request.decelerationDegPerSec2 = profile.decelerationDegPerSec2;
+  request.mode = static_cast<uint8_t>(mode);
+  bool accepted = callAndUpdate(rpc::Opcode::kMoveTo, request);
+  // Frames built before the move was accepted would report it finished.
+  comm::invalidateTelemetry();
+  return accepted;
+}
+
+bool isMoveActive() {
+  rpc::Telemetry telemetry;
+  if (comm::readTelemetry(telemetry)) {
+    return (telemetry.flags & rpc::kTelemetryMoveActive) != 0;
+  }
+  rpc::Flag response{};
+  if (!queryAndUpdate(rpc::Opcode::kGetMoveActive, response)) {
+    // Keep the goto running on a missed poll; the joystick still aborts it.
+    return true;
+  }
+  return response.value != 0;
+}
+
+bool queueSegments(Axis axis, const VelocitySegment* segments, size_t count) {
+  if (segments == nullptr || count == 0) {
+    return false;
+  }
+  for (size_t offset = 0; offset < count; offset += rpc::kMaxSegmentsPerRequest) {
+    size_t chunk = std::min(count - offset, rpc::kMaxSegmentsPerRequest);
+    rpc::QueueSegmentsRequest request{};
+    request.axis = axisToWire(axis);
+    request.count = static_cast<uint8_t>(chunk);
+    for (size_t i = 0; i < chunk; ++i) {
+      const VelocitySegment& segment = segments[offset + i];
+      request.segments[i] = {segment.startMs, segment.durationMs, segment.startStepsPerSecond,
+                             segment.accelStepsPerSecond2};
+    }
+    rpc::Int32Value freeSlots{};
+    size_t requestSize = rpc::kQueueSegmentsHeaderSize + chunk * sizeof(rpc::Segment);
+    bool success = comm::call(rpc::Opcode::kQueueSegments, &request, requestSize, &freeSlots,
+                              sizeof(freeSlots));
+    systemState.manualCommandOk = success;
+    if (!success) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void clearSegments() { post(rpc::Opcode::kClearSegments); }
+
+size_t getFreeSegmentSlots(Axis axis) {
+  rpc::Int32Value response{};
+  if (!callAndUpdate(rpc::Opcode::kGetSegmentSpace, rpc::AxisSelect{axisToWire(axis)},
+                     response)) {
+    return 0;
   }
+  return static_cast<size_t>(std::max<int32_t>(response.value, 0));
+}
+
+void stopAll() {
+  comm::sendEmergencyStop(rpc::StopScope::kAll);
+  invalidateManualCache();
+  // kStopAll disables tracking and drops the polynomial feed.
+  trackingCache.ratesValid = false;
+  trackingCache.enabledValid = true;
+  trackingCache.enabled = false;
+  post(rpc::Opcode::kStopAll);
+  comm::invalidateTelemetry();
 }
 
 void setTrackingEnabled(bool enabled) {
-  callAndUpdate("SET_TRACKING_ENABLED", {enabled ? "1" : "0"});
+  uint32_t now = millis();
+  if (trackingCache.enabledValid && trackingCache.enabled == enabled &&
+      !trackingRefreshDue(!enabled, trackingCache.enabledSentMs, now)) {
+    return;
+  }
+  if (deferSetpoint(rpc::Opcode::kSetTrackingEnabled, rpc::Flag{static_cast<uint8_t>(enabled)},
+                    handleTrackingEnabledResponse)) {
+    trackingCache.enabledValid = true;
+    trackingCache.enabled = enabled;
+    trackingCache.enabledSentMs = now;
+  }
 }
 
 void setTrackingRates(double azDegPerSec, double altDegPerSec) {
-  callAndUpdate("SET_TRACKING_RATES",
-                {formatFloat(azDegPerSec), formatFloat(altDegPerSec)});
+  float azRate = static_cast<float>(azDegPerSec);
+  float altRate = static_cast<float>(altDegPerSec);
+  uint32_t now = millis();
+  if (trackingCache.ratesValid && trackingCache.azRate == azRate &&
+      trackingCache.altRate == altRate &&
+      !trackingRefreshDue(azRate == 0.0f && altRate == 0.0f, trackingCache.ratesSentMs, now)) {
+    return;
+  }
+  if (deferSetpoint(rpc::Opcode::kSetTrackingRates, rpc::TrackingRatesRequest{azRate, altRate},
+                    handleTrackingRatesResponse)) {
+    trackingCache.ratesValid = true;
+    trackingCache.azRate = azRate;
+    trackingCache.altRate = altRate;
+    trackingCache.ratesSentMs = now;
+  }
+}
+
+bool setTrackingPolynomial(Axis axis, const TrackingPolynomial& polynomial) {
+  rpc::TrackingPolyRequest request{};
+  request.axis = axisToWire(axis);
+  request.horizonMs = polynomial.horizonMs;
+  request.baseSteps = polynomial.baseSteps;
+  request.c1 = static_cast<float>(polynomial.c1);
+  request.c2 = static_cast<float>(polynomial.c2);
+  request.c3 = static_cast<float>(polynomial.c3);
+  // The feed replaces the rate contribution on the main board.
+  trackingCache.ratesValid = false;
+  return callAndUpdate(rpc::Opcode::kSetTrackingPoly, request);
 }
 
+void clearTrackingPolynomials() {
+  trackingCache.ratesValid = false;
+  post(rpc::Opcode::kClearTrackingPoly);
+}
+
+// Step counts, directions and the move flag come from the pushed telemetry;
+// polling is only the fallback when it is missing or stale.
 int64_t getStepCount(Axis axis) {
-  std::vector<String> payload;
-  if (!callAndUpdate("GET_STEP_COUNT", {String(axisToString(axis))}, &payload)) {
-    return 0;
+  rpc::Telemetry telemetry;
+  if (comm::readTelemetry(telemetry)) {
+    return (axis == Axis::Az) ? telemetry.azSteps : telemetry.altSteps;
   }
-  if (payload.empty()) {
+  rpc::Int64Value response{};
+  if (!callAndUpdate(rpc::Opcode::kGetStepCount, rpc::AxisSelect{axisToWire(axis)}, response)) {
     return 0;
   }
-  return parseInt64(payload.front());
+  return response.value;
 }
 
 void setStepCount(Axis axis, int64_t value) {
-  if (callAndUpdate("SET_STEP_COUNT",
-                    {String(axisToString(axis)), String(value)})) {
-    lastManualRpm[axisIndex(axis)] = std::numeric_limits<float>::quiet_NaN();
-    lastManualSendMs[axisIndex(axis)] = 0;
-  }
+  invalidateManualCache(manualCache[axisIndex(axis)]);
+  post(rpc::Opcode::kSetStepCount, rpc::AxisInt64{axisToWire(axis), value});
+  comm::invalidateTelemetry();
 }
 
 double stepsToAzDegrees(int64_t steps) {
-  std::vector<String> payload;
-  if (!callAndUpdate("STEPS_TO_AZ", {String(steps)}, &payload)) {
-    return 0.0;
-  }
-  if (payload.empty()) {
-    return 0.0;
-  }
-  return parseDouble(payload.front());
+  return step_conversion::stepsToAzDegrees(readMirror().calibration, steps);
 }
 
 double stepsToAltDegrees(int64_t steps) {
-  std::vector<String> payload;
-  if (!callAndUpdate("STEPS_TO_ALT", {String(steps)}, &payload)) {
-    return 0.0;
-  }
-  if (payload.empty()) {
-    return 0.0;
-  }
-  return parseDouble(payload.front());
+  CalibrationMirror state = readMirror();
+  return step_conversion::stepsToAltDegrees(state.calibration, state.altitudeLimitsEnabled, steps);
 }
 
 int64_t azDegreesToSteps(double degrees) {
-  std::vector<String> payload;
-  if (!callAndUpdate("AZ_TO_STEPS", {formatFloat(degrees)}, &payload)) {
-    return 0;
-  }
-  if (payload.empty()) {
-    return 0;
-  }
-  return parseInt64(payload.front());
+  return step_conversion::azDegreesToSteps(readMirror().calibration, degrees);
 }
 
 int64_t altDegreesToSteps(double degrees) {
-  std::vector<String> payload;
-  if (!callAndUpdate("ALT_TO_STEPS", {formatFloat(degrees)}, &payload)) {
-    return 0;
-  }
-  if (payload.empty()) {
-    return 0;
-  }
-  return parseInt64(payload.front());
+  CalibrationMirror state = readMirror();
+  return step_conversion::altDegreesToSteps(state.calibration, state.altitudeLimitsEnabled,
+                                            degrees);
 }
 
-double getMinAltitudeDegrees() { return -5.0; }
+double getMinAltitudeDegrees() { return step_conversion::kMinAltitudeDegrees; }
 
-double getMaxAltitudeDegrees() { return 90.0; }
+double getMaxAltitudeDegrees() { return step_conversion::kMaxAltitudeDegrees; }
 
 void applyCalibration(const AxisCalibration& calibration) {
-  callAndUpdate("APPLY_CALIBRATION",
-                {formatFloat(calibration.stepsPerDegreeAz),
-                 formatFloat(calibration.stepsPerDegreeAlt),
-                 String(calibration.azHomeOffset),
-                 String(calibration.altHomeOffset)});
+  portENTER_CRITICAL(&mirrorMux);
+  mirror.calibration = calibration;
+  ++mirror.generation;
+  mirror.lastResyncMs = millis();
+  CalibrationMirror state = mirror;
+  portEXIT_CRITICAL(&mirrorMux);
+  sendCalibration(state);
 }
 
 void setBacklash(const BacklashConfig& backlash) {
-  callAndUpdate("SET_BACKLASH",
-                {String(backlash.azSteps), String(backlash.altSteps)});
+  post(rpc::Opcode::kSetBacklash, rpc::BacklashRequest{backlash.azSteps, backlash.altSteps});
 }
 
 void setAltitudeLimitsEnabled(bool enabled) {
-  callAndUpdate("SET_ALT_LIMITS_ENABLED", {enabled ? "1" : "0"});
+  portENTER_CRITICAL(&mirrorMux);
+  mirror.altitudeLimitsEnabled = enabled;
+  ++mirror.generation;
+  mirror.lastResyncMs = millis();
+  CalibrationMirror state = mirror;
+  portEXIT_CRITICAL(&mirrorMux);
+  sendAltitudeLimits(state);
 }
 
-int32_t getBacklashSteps(Axis axis) {
-  std::vector<String> payload;
-  if (!callAndUpdate("GET_BACKLASH", {String(axisToString(axis))}, &payload)) {
-    return 0;
+// Resends the whole mirror when telemetry shows the main board on another
+// generation, e.g. after it rebooted or a calibration request was lost.
+void syncCalibration() {
+  CalibrationMirror state = readMirror();
+  rpc::Telemetry telemetry;
+  if (state.generation == 0 || !comm::readTelemetry(telemetry) ||
+      telemetry.calibrationGeneration == state.generation) {
+    return;
+  }
+  uint32_t now = millis();
+  if ((now - state.lastResyncMs) < kCalibrationResyncIntervalMs) {
+    return;
   }
-  if (payload.empty()) {
+  portENTER_CRITICAL(&mirrorMux);
+  mirror.lastResyncMs = now;
+  portEXIT_CRITICAL(&mirrorMux);
+  sendCalibration(state);
+  sendAltitudeLimits(state);
+}
+
+int32_t getBacklashSteps(Axis axis) {
+  rpc::Int32Value response{};
+  if (!callAndUpdate(rpc::Opcode::kGetBacklash, rpc::AxisSelect{axisToWire(axis)}, response)) {
     return 0;
   }
-  return static_cast<int32_t>(payload.front().toInt());
+  return response.value;
 }
 
 int8_t getLastDirection(Axis axis) {
-  std::vector<String> payload;
-  if (!callAndUpdate("GET_LAST_DIR", {String(axisToString(axis))}, &payload)) {
-    return 0;
+  rpc::Telemetry telemetry;
+  if (comm::readTelemetry(telemetry)) {
+    return (axis == Axis::Az) ? telemetry.azLastDirection : telemetry.altLastDirection;
   }
-  if (payload.empty()) {
+  rpc::Int8Value response{};
+  if (!callAndUpdate(rpc::Opcode::kGetLastDir, rpc::AxisSelect{axisToWire(axis)}, response)) {
     return 0;
   }
-  return static_cast<int8_t>(payload.front().toInt());
+  return response.value;
+}
+
+// Only available from telemetry; there is no polling fallback.
+double getStepsPerSecond(Axis axis) {
+  rpc::Telemetry telemetry;
+  if (!comm::readTelemetry(telemetry)) {
+    return 0.0;
+  }
+  return (axis == Axis::Az) ? telemetry.azStepsPerSecond : telemetry.altStepsPerSecond;
 }
 
 }  // namespace motion
 
 #endif  // DEVICE_ROLE_HID
-
@@ -3,6 +3,7 @@
 #if defined(DEVICE_ROLE_MAIN)
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <limits>
 
@@ -11,6 +12,8 @@
 #include <esp_timer.h>
 
 #include "config.h"
+#include "motion_profile.h"
+#include "step_conversion.h"
 #include "storage.h"
 
 namespace {
@@ -19,9 +22,44 @@ constexpr double kStepsPerAxisRev =
     config::FULLSTEPS_PER_REV * config::MICROSTEPS * config::GEAR_RATIO;
 constexpr double kMinActiveStepsPerSecond = 0.1;
 constexpr uint32_t kStepPulseWidthUs = 3;
-constexpr double kMinAltitudeDegrees = -5.0;
-constexpr double kMaxAltitudeDegrees = 90.0;
+using step_conversion::kMaxAltitudeDegrees;
+using step_conversion::kMinAltitudeDegrees;
+constexpr uint32_t kMoveUpdateIntervalUs = 1000;
+constexpr double kTrackingCorrectionGain = 0.5;       // 1/s on the position error
+constexpr double kMaxTrackingCorrectionStepsPerSecond = 50.0;
+
+// Step generator fixed-point formats: rates are Q16.16 steps/s, times and
+// intervals are Q24.8 microseconds.
+constexpr int kRateFractionBits = 16;
+constexpr int kTimeFractionBits = 8;
+constexpr int32_t kMinActiveRate =
+    static_cast<int32_t>(kMinActiveStepsPerSecond * (1 << kRateFractionBits));
+constexpr int32_t kMaxRate = std::numeric_limits<int32_t>::max();
+constexpr uint32_t kMinStepIntervalUs = 10;
+constexpr uint32_t kMinStepInterval = kMinStepIntervalUs << kTimeFractionBits;
+constexpr uint64_t kIntervalDividend =
+    (1000000ULL << kTimeFractionBits) << kRateFractionBits;
+
+// Owned by the motor task. nextStep is the due time of the next edge, the
+// fractional part carries over between steps so the average rate stays exact.
+struct StepGenerator {
+  int32_t rate;
+  uint32_t interval;
+  uint64_t nextStep;
+  int8_t direction;
+  int8_t dirPinDirection;
+};
+
+// What the motor task needs from the command side, published as a seqlock
+// snapshot so the step path never spins on a lock held by the other core.
+struct AxisSnapshot {
+  int32_t rate;
+  int64_t minSteps;
+  int64_t maxSteps;
+};
 
+// mux guards the step counter and serialises snapshot writers; the
+// contribution fields are writer-side only.
 struct AxisState {
   uint8_t enPin;
   uint8_t dirPin;
@@ -31,8 +69,14 @@ struct AxisState {
   double userStepsPerSecond;
   double gotoStepsPerSecond;
   double trackingStepsPerSecond;
+  double segmentStepsPerSecond;
+  bool trackingEnabled;
+  int64_t minSteps;
+  int64_t maxSteps;
   int8_t lastDirection;
-  uint64_t nextStepDueUs;
+  std::atomic<uint32_t> snapshotSeq;
+  AxisSnapshot snapshot;
+  StepGenerator generator;
 };
 
 struct ManualAxisControl {
@@ -40,6 +84,62 @@ struct ManualAxisControl {
   uint64_t lastUpdateUs;
 };
 
+struct AxisMove {
+  bool active;
+  bool compensationPending;
+  int64_t finalTarget;
+  int64_t target;
+  double currentSpeed;
+  motion_profile::AxisLimits limits;
+  motion_profile::AxisLimits leg;
+};
+
+struct QueuedSegment {
+  uint64_t startUs;
+  uint64_t endUs;
+  double startStepsPerSecond;
+  double accelStepsPerSecond2;
+};
+
+// Ring of velocity segments per axis. epochMs/epochUs map the sender's
+// clock onto esp_timer time. changed is raised after every write so the motor
+// task rereads the ring at once; active, nextUpdateUs and publishedRate are
+// only touched by the motor task.
+struct SegmentQueue {
+  QueuedSegment entries[motion::kSegmentQueueCapacity];
+  size_t head;
+  size_t count;
+  bool aligned;
+  uint32_t epochMs;
+  uint64_t epochUs;
+  std::atomic<bool> changed;
+  bool active;
+  uint64_t nextUpdateUs;
+  double publishedRate;
+};
+
+// active, startUs, polynomial and generation are guarded by trackingFeedMux;
+// every writer bumps generation and raises changed. running and nextUpdateUs
+// are only touched by the motor task.
+struct TrackingFeed {
+  bool active;
+  uint64_t startUs;
+  TrackingPolynomial polynomial;
+  uint32_t generation;
+  std::atomic<bool> changed;
+  bool running;
+  uint64_t nextUpdateUs;
+};
+
+struct MoveCommand {
+  bool pending;
+  bool cancel;
+  int64_t azTarget;
+  int64_t altTarget;
+  GotoProfile profile;
+  MoveMode mode;
+};
+
 AxisState axisAz{config::EN_RA,
                  config::DIR_RA,
                  config::STEP_RA,
@@ -48,8 +148,14 @@ AxisState axisAz{config::EN_RA,
                  0.0,
                  0.0,
                  0.0,
+                 0.0,
+                 false,
+                 std::numeric_limits<int64_t>::min(),
+                 std::numeric_limits<int64_t>::max(),
                  1,
-                 0};
+                 {0},
+                 {0, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()},
+                 {0, 0, 0, 0, 0}};
 
 AxisState axisAlt{config::EN_DEC,
                   config::DIR_DEC,
@@ -59,12 +165,46 @@ AxisState axisAlt{config::EN_DEC,
                   0.0,
                   0.0,
                   0.0,
+                  0.0,
+                  false,
+                  std::numeric_limits<int64_t>::min(),
+                  std::numeric_limits<int64_t>::max(),
                   1,
-                  0};
+                  {0},
+                  {0, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()},
+                  {0, 0, 0, 0, 0}};
 
+// Ramped by the command task; an emergency stop from the link task resets it,
+// so both sides go through manualMux.
+portMUX_TYPE manualMux = portMUX_INITIALIZER_UNLOCKED;
 ManualAxisControl manualAzControl{0.0, 0};
 ManualAxisControl manualAltControl{0.0, 0};
 
+// Move requests are handed from the command task to the motor task through
+// moveCommand; the AxisMove runtimes are owned by the motor task.
+// moveCommandPosted is raised after every write to moveCommand so the motor
+// task only takes moveMux when there is something to collect.
+portMUX_TYPE moveMux = portMUX_INITIALIZER_UNLOCKED;
+MoveCommand moveCommand{false, false, 0, 0, {0.0f, 0.0f, 0.0f}, MoveMode::Independent};
+bool moveActive = false;
+std::atomic<bool> moveCommandPosted{false};
+AxisMove moveAz{false, false, 0, 0, 0.0, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+AxisMove moveAlt{false, false, 0, 0, 0.0, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+uint64_t lastMoveUpdateUs = 0;
+
+// Written by the command task, drained by the motor task.
+portMUX_TYPE segmentMux = portMUX_INITIALIZER_UNLOCKED;
+SegmentQueue segmentsAz{};
+SegmentQueue segmentsAlt{};
+
+// Written by the command task. The motor task evaluates a copy of the feed
+// outside the lock and publishes the result under trackingFeedMux only if the
+// generation is unchanged, so a concurrent rate-mode update cannot be
+// overwritten by a stale feed.
+portMUX_TYPE trackingFeedMux = portMUX_INITIALIZER_UNLOCKED;
+TrackingFeed trackingFeedAz{};
+TrackingFeed trackingFeedAlt{};
+
 AxisCalibration calibration{
     (config::FULLSTEPS_PER_REV * config::MICROSTEPS * config::GEAR_RATIO) / 360.0,
     (config::FULLSTEPS_PER_REV * config::MICROSTEPS * config::GEAR_RATIO) / 360.0,
@@ -73,8 +213,6 @@ AxisCalibration calibration{
 
 BacklashConfig backlash{0, 0};
 
-portMUX_TYPE trackingMux = portMUX_INITIALIZER_UNLOCKED;
-bool trackingEnabled = false;
 bool altitudeLimitsEnabled = true;
 
 AxisState& getAxisState(Axis axis) {
@@ -90,19 +228,6 @@ double getAxisStepsPerDegree(Axis axis) {
                             : calibration.stepsPerDegreeAlt;
 }
 
-bool isTrackingEnabled() {
-  portENTER_CRITICAL(&trackingMux);
-  bool enabled = trackingEnabled;
-  portEXIT_CRITICAL(&trackingMux);
-  return enabled;
-}
-
-void updateNextStep(AxisState& axis, uint64_t next) {
-  portENTER_CRITICAL(&axis.mux);
-  axis.nextStepDueUs = next;
-  portEXIT_CRITICAL(&axis.mux);
-}
-
 void setAxisCounter(AxisState& axis, int64_t value) {
   portENTER_CRITICAL(&axis.mux);
   axis.stepCounter = value;
@@ -116,140 +241,491 @@ int64_t getAxisCounter(const AxisState& axis) {
   return value;
 }
 
-double getAxisUserContribution(const AxisState& axis) {
-  portENTER_CRITICAL(const_cast<portMUX_TYPE*>(&axis.mux));
-  double value = axis.userStepsPerSecond;
-  portEXIT_CRITICAL(const_cast<portMUX_TYPE*>(&axis.mux));
-  return value;
+int32_t toFixedRate(double stepsPerSecond) {
+  double scaled = stepsPerSecond * static_cast<double>(1 << kRateFractionBits);
+  if (!std::isfinite(scaled)) {
+    return 0;
+  }
+  scaled = std::clamp(scaled, -static_cast<double>(kMaxRate), static_cast<double>(kMaxRate));
+  return static_cast<int32_t>(llround(scaled));
 }
 
-double getAxisGotoContribution(const AxisState& axis) {
-  portENTER_CRITICAL(const_cast<portMUX_TYPE*>(&axis.mux));
-  double value = axis.gotoStepsPerSecond;
-  portEXIT_CRITICAL(const_cast<portMUX_TYPE*>(&axis.mux));
-  return value;
+// Folds the rate contributions and limits into the snapshot the motor task
+// reads. Must be called with axis.mux held, which keeps writers on both
+// cores from interleaving and cannot be preempted mid-update.
+void publishAxisRate(AxisState& axis) {
+  double total = axis.userStepsPerSecond + axis.gotoStepsPerSecond + axis.segmentStepsPerSecond;
+  if (axis.trackingEnabled) {
+    total += axis.trackingStepsPerSecond;
+  }
+  AxisSnapshot next{toFixedRate(total), axis.minSteps, axis.maxSteps};
+  uint32_t seq = axis.snapshotSeq.load(std::memory_order_relaxed);
+  axis.snapshotSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  axis.snapshot = next;
+  axis.snapshotSeq.store(seq + 2, std::memory_order_release);
 }
 
-double getAxisTrackingContribution(const AxisState& axis) {
-  portENTER_CRITICAL(const_cast<portMUX_TYPE*>(&axis.mux));
-  double value = axis.trackingStepsPerSecond;
-  portEXIT_CRITICAL(const_cast<portMUX_TYPE*>(&axis.mux));
-  return value;
+// Lock-free read for the motor task; only retries while a writer is inside
+// its critical section.
+AxisSnapshot readAxisSnapshot(const AxisState& axis) {
+  AxisSnapshot snapshot;
+  uint32_t before;
+  uint32_t after;
+  do {
+    before = axis.snapshotSeq.load(std::memory_order_acquire);
+    snapshot = axis.snapshot;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = axis.snapshotSeq.load(std::memory_order_relaxed);
+  } while ((before & 1U) != 0 || before != after);
+  return snapshot;
 }
 
 void setAxisUserContribution(AxisState& axis, double value) {
   portENTER_CRITICAL(&axis.mux);
   axis.userStepsPerSecond = value;
+  publishAxisRate(axis);
   portEXIT_CRITICAL(&axis.mux);
 }
 
 void setAxisGotoContribution(AxisState& axis, double value) {
   portENTER_CRITICAL(&axis.mux);
   axis.gotoStepsPerSecond = value;
+  publishAxisRate(axis);
   portEXIT_CRITICAL(&axis.mux);
 }
 
 void setAxisTrackingContribution(AxisState& axis, double value) {
   portENTER_CRITICAL(&axis.mux);
   axis.trackingStepsPerSecond = value;
+  publishAxisRate(axis);
   portEXIT_CRITICAL(&axis.mux);
 }
 
-double clampAltitudeDegrees(double degrees) {
-  return std::clamp(degrees, kMinAltitudeDegrees, kMaxAltitudeDegrees);
+void setAxisSegmentContribution(AxisState& axis, double value) {
+  portENTER_CRITICAL(&axis.mux);
+  axis.segmentStepsPerSecond = value;
+  publishAxisRate(axis);
+  portEXIT_CRITICAL(&axis.mux);
 }
 
-double stepsToAltitudeDegreesRaw(int64_t steps) {
-  if (calibration.stepsPerDegreeAlt <= 0.0) {
-    return 0.0;
+void setAxisTrackingEnabled(AxisState& axis, bool enabled) {
+  portENTER_CRITICAL(&axis.mux);
+  axis.trackingEnabled = enabled;
+  publishAxisRate(axis);
+  portEXIT_CRITICAL(&axis.mux);
+}
+
+// Converts the altitude window into step bounds once per calibration or
+// limit change so the step path only compares integers.
+void updateAltitudeBounds() {
+  int64_t minSteps = std::numeric_limits<int64_t>::min();
+  int64_t maxSteps = std::numeric_limits<int64_t>::max();
+  if (altitudeLimitsEnabled && calibration.stepsPerDegreeAlt > 0.0) {
+    minSteps = static_cast<int64_t>(std::ceil(
+        kMinAltitudeDegrees * calibration.stepsPerDegreeAlt + calibration.altHomeOffset));
+    maxSteps = static_cast<int64_t>(std::floor(
+        kMaxAltitudeDegrees * calibration.stepsPerDegreeAlt + calibration.altHomeOffset));
   }
-  double adjusted = static_cast<double>(steps - calibration.altHomeOffset);
-  return adjusted / calibration.stepsPerDegreeAlt;
+  portENTER_CRITICAL(&axisAlt.mux);
+  axisAlt.minSteps = minSteps;
+  axisAlt.maxSteps = maxSteps;
+  publishAxisRate(axisAlt);
+  portEXIT_CRITICAL(&axisAlt.mux);
 }
 
 int64_t clampAltitudeSteps(int64_t steps) {
-  if (calibration.stepsPerDegreeAlt <= 0.0) {
-    return steps;
-  }
-  double degrees = stepsToAltitudeDegreesRaw(steps);
-  double clampedDegrees = clampAltitudeDegrees(degrees);
-  double clampedSteps =
-      clampedDegrees * calibration.stepsPerDegreeAlt + calibration.altHomeOffset;
-  return static_cast<int64_t>(llround(clampedSteps));
-}
-
-void applyStep(AxisState& axis, int8_t direction, uint64_t nextDue) {
-  bool allowStep = true;
-  if (&axis == &axisAlt && calibration.stepsPerDegreeAlt > 0.0 && altitudeLimitsEnabled) {
-    portENTER_CRITICAL(&axis.mux);
-    int64_t candidate = axis.stepCounter + direction;
-    double candidateDegrees = stepsToAltitudeDegreesRaw(candidate);
-    if (candidateDegrees < kMinAltitudeDegrees ||
-        candidateDegrees > kMaxAltitudeDegrees) {
-      axis.stepCounter = clampAltitudeSteps(axis.stepCounter);
-      axis.nextStepDueUs = 0;
-      allowStep = false;
-    } else {
-      axis.stepCounter = candidate;
-      axis.lastDirection = direction;
-      axis.nextStepDueUs = nextDue;
-    }
-    portEXIT_CRITICAL(&axis.mux);
-  } else {
-    portENTER_CRITICAL(&axis.mux);
-    axis.stepCounter += direction;
+  portENTER_CRITICAL(&axisAlt.mux);
+  int64_t clamped = std::clamp(steps, axisAlt.minSteps, axisAlt.maxSteps);
+  portEXIT_CRITICAL(&axisAlt.mux);
+  return clamped;
+}
+
+bool applyStep(AxisState& axis, const AxisSnapshot& snapshot, int8_t direction) {
+  portENTER_CRITICAL(&axis.mux);
+  int64_t candidate = axis.stepCounter + direction;
+  bool allowStep = candidate >= snapshot.minSteps && candidate <= snapshot.maxSteps;
+  if (allowStep) {
+    axis.stepCounter = candidate;
     axis.lastDirection = direction;
-    axis.nextStepDueUs = nextDue;
-    portEXIT_CRITICAL(&axis.mux);
+  } else {
+    axis.stepCounter = std::clamp(static_cast<int64_t>(axis.stepCounter), snapshot.minSteps,
+                                  snapshot.maxSteps);
   }
+  portEXIT_CRITICAL(&axis.mux);
 
   if (!allowStep) {
-    return;
+    return false;
   }
 
-  digitalWrite(axis.dirPin, direction > 0 ? HIGH : LOW);
+  StepGenerator& generator = axis.generator;
+  if (generator.dirPinDirection != direction) {
+    digitalWrite(axis.dirPin, direction > 0 ? HIGH : LOW);
+    generator.dirPinDirection = direction;
+  }
   digitalWrite(axis.stepPin, HIGH);
   esp_rom_delay_us(kStepPulseWidthUs);
   digitalWrite(axis.stepPin, LOW);
+  return true;
+}
+
+// Re-derives the step interval when the commanded rate changes. The division
+// happens here only; an edge that is already running keeps its start time so
+// rate ramps take effect on the very next step.
+void retuneGenerator(StepGenerator& generator, int32_t rate, uint64_t now) {
+  generator.rate = rate;
+  uint32_t magnitude = (rate < 0) ? static_cast<uint32_t>(-static_cast<int64_t>(rate))
+                                  : static_cast<uint32_t>(rate);
+  if (magnitude < static_cast<uint32_t>(kMinActiveRate)) {
+    generator.interval = 0;
+    generator.nextStep = 0;
+    return;
+  }
+
+  uint64_t interval = kIntervalDividend / magnitude;
+  interval = std::clamp<uint64_t>(interval, kMinStepInterval,
+                                  std::numeric_limits<uint32_t>::max());
+  int8_t direction = (rate > 0) ? 1 : -1;
+  if (generator.interval == 0 || direction != generator.direction) {
+    generator.nextStep = now;
+  } else {
+    if (interval >= generator.interval) {
+      generator.nextStep += interval - generator.interval;
+    } else {
+      uint64_t shortenBy = generator.interval - interval;
+      generator.nextStep = (generator.nextStep > shortenBy) ? generator.nextStep - shortenBy : 0;
+    }
+    generator.nextStep = std::max(generator.nextStep, now);
+  }
+  generator.interval = static_cast<uint32_t>(interval);
+  generator.direction = direction;
 }
 
 uint64_t updateAxis(AxisState& axis, uint64_t nowUs) {
-  double user = getAxisUserContribution(axis);
-  double gotoRate = getAxisGotoContribution(axis);
-  double trackingRate = isTrackingEnabled() ? getAxisTrackingContribution(axis)
-                                            : 0.0;
-  double total = user + gotoRate + trackingRate;
-  if (std::fabs(total) < kMinActiveStepsPerSecond) {
-    updateNextStep(axis, 0);
-    digitalWrite(axis.stepPin, LOW);
+  StepGenerator& generator = axis.generator;
+  uint64_t now = nowUs << kTimeFractionBits;
+  AxisSnapshot snapshot = readAxisSnapshot(axis);
+  if (snapshot.rate != generator.rate) {
+    retuneGenerator(generator, snapshot.rate, now);
+  }
+  if (generator.interval == 0) {
     return std::numeric_limits<uint64_t>::max();
   }
 
-  int8_t direction = (total >= 0.0) ? 1 : -1;
-  total = std::fabs(total);
-  if (total < kMinActiveStepsPerSecond) {
-    total = kMinActiveStepsPerSecond;
+  if (now + (1 << kTimeFractionBits) >= generator.nextStep) {
+    applyStep(axis, snapshot, generator.direction);
+    generator.nextStep += generator.interval;
+    // Resynchronise instead of bursting when the task was held off for more
+    // than a full interval.
+    if (generator.nextStep < now) {
+      generator.nextStep = now + generator.interval;
+    }
   }
-  uint64_t nextDue = nowUs;
-  {
-    portENTER_CRITICAL(&axis.mux);
-    if (axis.nextStepDueUs != 0) {
-      nextDue = axis.nextStepDueUs;
+  return generator.nextStep >> kTimeFractionBits;
+}
+
+AxisMove& getAxisMove(Axis axis) {
+  return (axis == Axis::Az) ? moveAz : moveAlt;
+}
+
+void setMoveActive(bool active) {
+  portENTER_CRITICAL(&moveMux);
+  moveActive = active;
+  portEXIT_CRITICAL(&moveMux);
+}
+
+void startAxisMove(Axis axis, int64_t targetSteps, const GotoProfile& profile) {
+  AxisMove& move = getAxisMove(axis);
+  AxisState& state = getAxisState(axis);
+
+  if (axis == Axis::Alt && altitudeLimitsEnabled) {
+    targetSteps = clampAltitudeSteps(targetSteps);
+  }
+
+  move.finalTarget = targetSteps;
+  move.target = targetSteps;
+  move.compensationPending = false;
+  move.currentSpeed = 0.0;
+  move.limits = motion_profile::toAxisLimits(profile, getAxisStepsPerDegree(axis));
+  move.leg = move.limits;
+
+  int64_t diff = targetSteps - getAxisCounter(state);
+  if (diff == 0) {
+    move.active = false;
+    setAxisGotoContribution(state, 0.0);
+    return;
+  }
+
+  int8_t desiredDirection = diff > 0 ? 1 : -1;
+  int32_t backlashSteps = motion::getBacklashSteps(axis);
+  int8_t lastDirection = motion::getLastDirection(axis);
+  if (backlashSteps > 0 && lastDirection != 0 && lastDirection != desiredDirection) {
+    move.target = targetSteps + desiredDirection * backlashSteps;
+    if (axis == Axis::Alt && altitudeLimitsEnabled) {
+      move.target = clampAltitudeSteps(move.target);
     }
-    portEXIT_CRITICAL(&axis.mux);
+    move.compensationPending = move.target != targetSteps;
   }
+  move.active = true;
+}
 
-  if (nowUs + 1 >= nextDue) {
-    double intervalUs = 1000000.0 / (total * 1.0);
-    if (intervalUs < 50.0) {
-      intervalUs = 50.0;
+void updateAxisMove(Axis axis, double dt) {
+  AxisMove& move = getAxisMove(axis);
+  if (!move.active) {
+    return;
+  }
+  AxisState& state = getAxisState(axis);
+  int64_t error = move.target - getAxisCounter(state);
+  if (error == 0) {
+    move.currentSpeed = 0.0;
+    setAxisGotoContribution(state, 0.0);
+    if (move.compensationPending) {
+      move.compensationPending = false;
+      move.target = move.finalTarget;
+      move.leg = move.limits;
+      return;
     }
-    uint64_t scheduled = nowUs + static_cast<uint64_t>(intervalUs);
-    applyStep(axis, direction, scheduled);
-    return scheduled;
+    move.active = false;
+    return;
   }
 
-  return nextDue;
+  // Accelerate towards the cruise speed but never faster than what still
+  // allows stopping on the target; the floor is the speed reached after one
+  // step from rest so the first step interval stays short.
+  double distance = std::fabs(static_cast<double>(error));
+  const motion_profile::AxisLimits& leg = move.leg;
+  double speed = std::min(move.currentSpeed + leg.acceleration * dt, leg.maxSpeed);
+  speed = std::min(speed, std::sqrt(2.0 * leg.deceleration * distance));
+  speed = std::max(speed, std::min(std::sqrt(2.0 * leg.acceleration), leg.maxSpeed));
+  move.currentSpeed = speed;
+  setAxisGotoContribution(state, error > 0 ? speed : -speed);
+}
+
+// Stretches the axis with the shorter travel time onto the other axis'
+// trapezoid so the first leg ends at the same instant on both axes. Backlash
+// take-up legs afterwards run with each axis' own limits.
+void coordinateMoves() {
+  if (!moveAz.active || !moveAlt.active) {
+    return;
+  }
+  double azDistance = static_cast<double>(moveAz.target - getAxisCounter(axisAz));
+  double altDistance = static_cast<double>(moveAlt.target - getAxisCounter(axisAlt));
+  double azTime = motion_profile::computeTravelTimeSteps(azDistance, moveAz.limits);
+  double altTime = motion_profile::computeTravelTimeSteps(altDistance, moveAlt.limits);
+  if (azTime >= altTime) {
+    moveAlt.leg = motion_profile::scaleToLeadAxis(moveAz.limits, azDistance, moveAlt.limits,
+                                                  altDistance);
+  } else {
+    moveAz.leg = motion_profile::scaleToLeadAxis(moveAlt.limits, altDistance, moveAz.limits,
+                                                 azDistance);
+  }
+}
+
+void cancelMoves() {
+  moveAz.active = false;
+  moveAz.currentSpeed = 0.0;
+  moveAlt.active = false;
+  moveAlt.currentSpeed = 0.0;
+  setAxisGotoContribution(axisAz, 0.0);
+  setAxisGotoContribution(axisAlt, 0.0);
+}
+
+uint64_t serviceMoves(uint64_t nowUs) {
+  bool posted = moveCommandPosted.load(std::memory_order_acquire);
+  if (!posted) {
+    if (!moveAz.active && !moveAlt.active) {
+      return std::numeric_limits<uint64_t>::max();
+    }
+    if (nowUs - lastMoveUpdateUs < kMoveUpdateIntervalUs) {
+      return lastMoveUpdateUs + kMoveUpdateIntervalUs;
+    }
+  }
+
+  MoveCommand command{};
+  if (posted) {
+    portENTER_CRITICAL(&moveMux);
+    command = moveCommand;
+    moveCommand.pending = false;
+    moveCommand.cancel = false;
+    moveCommandPosted.store(false, std::memory_order_relaxed);
+    portEXIT_CRITICAL(&moveMux);
+  }
+
+  if (command.cancel) {
+    cancelMoves();
+  }
+  if (command.pending) {
+    startAxisMove(Axis::Az, command.azTarget, command.profile);
+    startAxisMove(Axis::Alt, command.altTarget, command.profile);
+    if (command.mode == MoveMode::Coordinated) {
+      coordinateMoves();
+    }
+    lastMoveUpdateUs = nowUs;
+  }
+
+  if (!moveAz.active && !moveAlt.active) {
+    if (command.cancel || command.pending) {
+      setMoveActive(false);
+    }
+    return std::numeric_limits<uint64_t>::max();
+  }
+
+  if (!command.pending && nowUs - lastMoveUpdateUs < kMoveUpdateIntervalUs) {
+    return lastMoveUpdateUs + kMoveUpdateIntervalUs;
+  }
+
+  double dt = static_cast<double>(nowUs - lastMoveUpdateUs) / 1000000.0;
+  lastMoveUpdateUs = nowUs;
+  updateAxisMove(Axis::Az, dt);
+  updateAxisMove(Axis::Alt, dt);
+  if (!moveAz.active && !moveAlt.active) {
+    setMoveActive(false);
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return nowUs + kMoveUpdateIntervalUs;
+}
+
+SegmentQueue& getSegmentQueue(Axis axis) {
+  return (axis == Axis::Az) ? segmentsAz : segmentsAlt;
+}
+
+uint64_t toSegmentTimeUs(const SegmentQueue& queue, uint32_t senderMs) {
+  int64_t offsetUs = static_cast<int64_t>(static_cast<int32_t>(senderMs - queue.epochMs)) * 1000;
+  int64_t timeUs = static_cast<int64_t>(queue.epochUs) + offsetUs;
+  return timeUs > 0 ? static_cast<uint64_t>(timeUs) : 0;
+}
+
+// Drops finished segments and drives the segment contribution from the
+// current one. Gaps between segments run at zero segment rate. The ring is
+// read at segment boundaries, every kMoveUpdateIntervalUs inside a ramp, and
+// whenever the command task changed it; the rate is republished only when it
+// differs.
+uint64_t serviceSegmentQueue(Axis axis, uint64_t nowUs) {
+  SegmentQueue& queue = getSegmentQueue(axis);
+  bool changed = queue.changed.load(std::memory_order_acquire);
+  if (!changed) {
+    if (!queue.active) {
+      return std::numeric_limits<uint64_t>::max();
+    }
+    if (nowUs < queue.nextUpdateUs) {
+      return queue.nextUpdateUs;
+    }
+  }
+
+  QueuedSegment current{};
+  bool haveSegment = false;
+  portENTER_CRITICAL(&segmentMux);
+  queue.changed.store(false, std::memory_order_relaxed);
+  while (queue.count > 0 && queue.entries[queue.head].endUs <= nowUs) {
+    queue.head = (queue.head + 1) % motion::kSegmentQueueCapacity;
+    --queue.count;
+  }
+  if (queue.count > 0) {
+    current = queue.entries[queue.head];
+    haveSegment = true;
+  } else {
+    queue.aligned = false;
+  }
+  portEXIT_CRITICAL(&segmentMux);
+
+  // stopAll() zeroes the contribution behind the queue's back, so a change
+  // from the command task always republishes.
+  AxisState& state = getAxisState(axis);
+  if (!haveSegment) {
+    if (queue.active || changed) {
+      setAxisSegmentContribution(state, 0.0);
+      queue.publishedRate = 0.0;
+    }
+    queue.active = false;
+    return std::numeric_limits<uint64_t>::max();
+  }
+
+  double rate = 0.0;
+  uint64_t nextUpdateUs = current.startUs;
+  if (nowUs >= current.startUs) {
+    double elapsed = static_cast<double>(nowUs - current.startUs) / 1000000.0;
+    rate = current.startStepsPerSecond + current.accelStepsPerSecond2 * elapsed;
+    nextUpdateUs = current.endUs;
+    if (current.accelStepsPerSecond2 != 0.0) {
+      nextUpdateUs = std::min(nextUpdateUs, nowUs + kMoveUpdateIntervalUs);
+    }
+  }
+  if (changed || rate != queue.publishedRate) {
+    setAxisSegmentContribution(state, rate);
+    queue.publishedRate = rate;
+  }
+  queue.active = true;
+  queue.nextUpdateUs = nextUpdateUs;
+  return nextUpdateUs;
+}
+
+TrackingFeed& getTrackingFeed(Axis axis) {
+  return (axis == Axis::Az) ? trackingFeedAz : trackingFeedAlt;
+}
+
+// Bumps the generation and wakes the motor task. Caller holds
+// trackingFeedMux.
+void touchTrackingFeedLocked(TrackingFeed& feed) {
+  ++feed.generation;
+  feed.changed.store(true, std::memory_order_release);
+}
+
+// Feed-forward from the polynomial's derivative plus a bounded proportional
+// trim on the remaining step error. Past the horizon the fit is continued
+// linearly until the HID sends the next one. Runs every
+// kMoveUpdateIntervalUs, or at once when the feed changed.
+uint64_t serviceTrackingFeed(Axis axis, uint64_t nowUs) {
+  TrackingFeed& feed = getTrackingFeed(axis);
+  bool changed = feed.changed.load(std::memory_order_acquire);
+  if (!changed) {
+    if (!feed.running) {
+      return std::numeric_limits<uint64_t>::max();
+    }
+    if (nowUs < feed.nextUpdateUs) {
+      return feed.nextUpdateUs;
+    }
+  }
+
+  portENTER_CRITICAL(&trackingFeedMux);
+  feed.changed.store(false, std::memory_order_relaxed);
+  bool active = feed.active;
+  uint64_t startUs = feed.startUs;
+  TrackingPolynomial poly = feed.polynomial;
+  uint32_t generation = feed.generation;
+  portEXIT_CRITICAL(&trackingFeedMux);
+  feed.running = active;
+  if (!active) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+
+  // The command task may stamp startUs after nowUs was read.
+  int64_t elapsedUs = std::max<int64_t>(static_cast<int64_t>(nowUs - startUs), 0);
+  double horizonSec = static_cast<double>(poly.horizonMs) / 1000.0;
+  double tau = static_cast<double>(elapsedUs) / 1000000.0 / horizonSec;
+  double position = 0.0;
+  double slope = 0.0;
+  if (tau <= 1.0) {
+    position = ((poly.c3 * tau + poly.c2) * tau + poly.c1) * tau;
+    slope = (3.0 * poly.c3 * tau + 2.0 * poly.c2) * tau + poly.c1;
+  } else {
+    slope = 3.0 * poly.c3 + 2.0 * poly.c2 + poly.c1;
+    position = poly.c3 + poly.c2 + poly.c1 + slope * (tau - 1.0);
+  }
+  AxisState& state = getAxisState(axis);
+  double target = static_cast<double>(poly.baseSteps) + position;
+  double error = target - static_cast<double>(getAxisCounter(state));
+  double correction = std::clamp(error * kTrackingCorrectionGain,
+                                 -kMaxTrackingCorrectionStepsPerSecond,
+                                 kMaxTrackingCorrectionStepsPerSecond);
+  double rate = slope / horizonSec + correction;
+
+  portENTER_CRITICAL(&trackingFeedMux);
+  if (feed.generation == generation) {
+    setAxisTrackingContribution(state, rate);
+  }
+  portEXIT_CRITICAL(&trackingFeedMux);
+  feed.nextUpdateUs = nowUs + kMoveUpdateIntervalUs;
+  return feed.nextUpdateUs;
 }
 
 }  // namespace
@@ -272,16 +748,20 @@ void init() {
   digitalWrite(axisAz.enPin, LOW);
   digitalWrite(axisAlt.enPin, LOW);
 
-  updateNextStep(axisAz, 0);
-  updateNextStep(axisAlt, 0);
+  updateAltitudeBounds();
 }
 
 void motorTaskLoop() {
   while (true) {
     uint64_t now = esp_timer_get_time();
+    uint64_t nextMove = serviceMoves(now);
+    uint64_t nextSegment = std::min(serviceSegmentQueue(Axis::Az, now),
+                                    serviceSegmentQueue(Axis::Alt, now));
+    uint64_t nextFeed = std::min(serviceTrackingFeed(Axis::Az, now),
+                                 serviceTrackingFeed(Axis::Alt, now));
     uint64_t nextAz = updateAxis(axisAz, now);
     uint64_t nextAlt = updateAxis(axisAlt, now);
-    uint64_t nextWake = std::min(nextAz, nextAlt);
+    uint64_t nextWake = std::min({nextMove, nextSegment, nextFeed, nextAz, nextAlt});
 
     if (nextWake == std::numeric_limits<uint64_t>::max()) {
       vTaskDelay(pdMS_TO_TICKS(2));
@@ -345,6 +825,7 @@ void setManualStepsPerSecond(Axis axis, double stepsPerSecond) {
     target = std::clamp(target, -maxSpeed, maxSpeed);
   }
 
+  portENTER_CRITICAL(&manualMux);
   uint64_t nowUs = esp_timer_get_time();
   double dt = 0.0;
   if (control.lastUpdateUs != 0 && nowUs >= control.lastUpdateUs) {
@@ -373,6 +854,7 @@ void setManualStepsPerSecond(Axis axis, double stepsPerSecond) {
 
   control.currentStepsPerSecond = current;
   setAxisUserContribution(axisState, current);
+  portEXIT_CRITICAL(&manualMux);
 }
 
 void setGotoStepsPerSecond(Axis axis, double stepsPerSecond) {
@@ -380,38 +862,187 @@ void setGotoStepsPerSecond(Axis axis, double stepsPerSecond) {
 }
 
 void clearGotoRates() {
+  portENTER_CRITICAL(&moveMux);
+  moveCommand.pending = false;
+  moveCommand.cancel = true;
+  moveCommandPosted.store(true, std::memory_order_release);
+  portEXIT_CRITICAL(&moveMux);
   setAxisGotoContribution(axisAz, 0.0);
   setAxisGotoContribution(axisAlt, 0.0);
 }
 
+bool moveTo(int64_t azTargetSteps, int64_t altTargetSteps, const GotoProfile& profile,
+            MoveMode mode) {
+  if (!std::isfinite(profile.maxSpeedDegPerSec) || profile.maxSpeedDegPerSec <= 0.0f ||
+      !std::isfinite(profile.accelerationDegPerSec2) || profile.accelerationDegPerSec2 <= 0.0f ||
+      !std::isfinite(profile.decelerationDegPerSec2) || profile.decelerationDegPerSec2 <= 0.0f) {
+    return false;
+  }
+  if (calibration.stepsPerDegreeAz <= 0.0 || calibration.stepsPerDegreeAlt <= 0.0) {
+    return false;
+  }
+  portENTER_CRITICAL(&moveMux);
+  moveCommand.pending = true;
+  moveCommand.azTarget = azTargetSteps;
+  moveCommand.altTarget = altTargetSteps;
+  moveCommand.profile = profile;
+  moveCommand.mode = mode;
+  moveActive = true;
+  moveCommandPosted.store(true, std::memory_order_release);
+  portEXIT_CRITICAL(&moveMux);
+  return true;
+}
+
+bool isMoveActive() {
+  portENTER_CRITICAL(&moveMux);
+  bool active = moveActive || moveCommand.pending;
+  portEXIT_CRITICAL(&moveMux);
+  return active;
+}
+
+bool queueSegments(Axis axis, const VelocitySegment* segments, size_t count) {
+  if (segments == nullptr || count == 0) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    const VelocitySegment& segment = segments[i];
+    if (segment.durationMs == 0 || !std::isfinite(segment.startStepsPerSecond) ||
+        !std::isfinite(segment.accelStepsPerSecond2)) {
+      return false;
+    }
+  }
+
+  uint64_t nowUs = esp_timer_get_time();
+  SegmentQueue& queue = getSegmentQueue(axis);
+  bool accepted = false;
+  portENTER_CRITICAL(&segmentMux);
+  if (queue.count + count <= kSegmentQueueCapacity) {
+    if (!queue.aligned) {
+      queue.aligned = true;
+      queue.epochMs = segments[0].startMs;
+      queue.epochUs = nowUs;
+    }
+    uint64_t previousStartUs = 0;
+    if (queue.count > 0) {
+      size_t tail = (queue.head + queue.count - 1) % kSegmentQueueCapacity;
+      previousStartUs = queue.entries[tail].startUs;
+    }
+    accepted = true;
+    for (size_t i = 0; i < count; ++i) {
+      uint64_t startUs = toSegmentTimeUs(queue, segments[i].startMs);
+      if (startUs < previousStartUs) {
+        accepted = false;
+        break;
+      }
+      previousStartUs = startUs;
+    }
+    for (size_t i = 0; i < count && accepted; ++i) {
+      QueuedSegment& entry = queue.entries[(queue.head + queue.count) % kSegmentQueueCapacity];
+      entry.startUs = toSegmentTimeUs(queue, segments[i].startMs);
+      entry.endUs = entry.startUs + static_cast<uint64_t>(segments[i].durationMs) * 1000;
+      entry.startStepsPerSecond = segments[i].startStepsPerSecond;
+      entry.accelStepsPerSecond2 = segments[i].accelStepsPerSecond2;
+      ++queue.count;
+    }
+    if (!accepted && queue.count == 0) {
+      queue.aligned = false;
+    }
+  }
+  if (accepted) {
+    queue.changed.store(true, std::memory_order_release);
+  }
+  portEXIT_CRITICAL(&segmentMux);
+  return accepted;
+}
+
+void clearSegments() {
+  portENTER_CRITICAL(&segmentMux);
+  for (SegmentQueue* queue : {&segmentsAz, &segmentsAlt}) {
+    queue->head = 0;
+    queue->count = 0;
+    queue->aligned = false;
+    queue->changed.store(true, std::memory_order_release);
+  }
+  portEXIT_CRITICAL(&segmentMux);
+}
+
+size_t getFreeSegmentSlots(Axis axis) {
+  SegmentQueue& queue = getSegmentQueue(axis);
+  portENTER_CRITICAL(&segmentMux);
+  size_t freeSlots = kSegmentQueueCapacity - queue.count;
+  portEXIT_CRITICAL(&segmentMux);
+  return freeSlots;
+}
+
 void stopAll() {
+  portENTER_CRITICAL(&manualMux);
   manualAzControl.currentStepsPerSecond = 0.0;
   manualAzControl.lastUpdateUs = esp_timer_get_time();
   manualAltControl.currentStepsPerSecond = 0.0;
   manualAltControl.lastUpdateUs = manualAzControl.lastUpdateUs;
-
   setAxisUserContribution(axisAz, 0.0);
   setAxisUserContribution(axisAlt, 0.0);
+  portEXIT_CRITICAL(&manualMux);
+
+  portENTER_CRITICAL(&moveMux);
+  moveCommand.pending = false;
+  moveCommand.cancel = true;
+  moveCommandPosted.store(true, std::memory_order_release);
+  portEXIT_CRITICAL(&moveMux);
+
   setAxisGotoContribution(axisAz, 0.0);
   setAxisGotoContribution(axisAlt, 0.0);
-  setAxisTrackingContribution(axisAz, 0.0);
-  setAxisTrackingContribution(axisAlt, 0.0);
-  portENTER_CRITICAL(&trackingMux);
-  trackingEnabled = false;
-  portEXIT_CRITICAL(&trackingMux);
+  clearTrackingPolynomials();
+  clearSegments();
+  setAxisSegmentContribution(axisAz, 0.0);
+  setAxisSegmentContribution(axisAlt, 0.0);
+  setAxisTrackingEnabled(axisAz, false);
+  setAxisTrackingEnabled(axisAlt, false);
 }
 
 void setTrackingEnabled(bool enabled) {
-  portENTER_CRITICAL(&trackingMux);
-  trackingEnabled = enabled;
-  portEXIT_CRITICAL(&trackingMux);
+  setAxisTrackingEnabled(axisAz, enabled);
+  setAxisTrackingEnabled(axisAlt, enabled);
 }
 
 void setTrackingRates(double azDegPerSec, double altDegPerSec) {
   double azSteps = azDegPerSec * calibration.stepsPerDegreeAz;
   double altSteps = altDegPerSec * calibration.stepsPerDegreeAlt;
+  portENTER_CRITICAL(&trackingFeedMux);
+  trackingFeedAz.active = false;
+  trackingFeedAlt.active = false;
+  touchTrackingFeedLocked(trackingFeedAz);
+  touchTrackingFeedLocked(trackingFeedAlt);
   setAxisTrackingContribution(axisAz, azSteps);
   setAxisTrackingContribution(axisAlt, altSteps);
+  portEXIT_CRITICAL(&trackingFeedMux);
+}
+
+bool setTrackingPolynomial(Axis axis, const TrackingPolynomial& polynomial) {
+  if (polynomial.horizonMs == 0 || !std::isfinite(polynomial.c1) ||
+      !std::isfinite(polynomial.c2) || !std::isfinite(polynomial.c3)) {
+    return false;
+  }
+  TrackingFeed& feed = getTrackingFeed(axis);
+  uint64_t nowUs = esp_timer_get_time();
+  portENTER_CRITICAL(&trackingFeedMux);
+  feed.polynomial = polynomial;
+  feed.startUs = nowUs;
+  feed.active = true;
+  touchTrackingFeedLocked(feed);
+  portEXIT_CRITICAL(&trackingFeedMux);
+  return true;
+}
+
+void clearTrackingPolynomials() {
+  portENTER_CRITICAL(&trackingFeedMux);
+  trackingFeedAz.active = false;
+  trackingFeedAlt.active = false;
+  touchTrackingFeedLocked(trackingFeedAz);
+  touchTrackingFeedLocked(trackingFeedAlt);
+  setAxisTrackingContribution(axisAz, 0.0);
+  setAxisTrackingContribution(axisAlt, 0.0);
+  portEXIT_CRITICAL(&trackingFeedMux);
 }
 
 int64_t getStepCount(Axis axis) { return getAxisCounter(getAxisState(axis)); }
@@ -424,53 +1055,19 @@ void setStepCount(Axis axis, int64_t value) {
 }
 
 double stepsToAzDegrees(int64_t steps) {
-  double adjusted = static_cast<double>(steps - calibration.azHomeOffset);
-  double degrees = adjusted / calibration.stepsPerDegreeAz;
-  degrees = fmod(degrees, 360.0);
-  if (degrees < 0.0) {
-    degrees += 360.0;
-  }
-  return degrees;
+  return step_conversion::stepsToAzDegrees(calibration, steps);
 }
 
 double stepsToAltDegrees(int64_t steps) {
-  if (calibration.stepsPerDegreeAlt <= 0.0) {
-    return 0.0;
-  }
-  double degrees = stepsToAltitudeDegreesRaw(steps);
-  if (degrees > 180.0 || degrees < -180.0) {
-    degrees = fmod(degrees, 360.0);
-    if (degrees > 180.0) {
-      degrees -= 360.0;
-    } else if (degrees < -180.0) {
-      degrees += 360.0;
-    }
-  }
-  if (altitudeLimitsEnabled) {
-    return clampAltitudeDegrees(degrees);
-  }
-  return degrees;
+  return step_conversion::stepsToAltDegrees(calibration, altitudeLimitsEnabled, steps);
 }
 
 int64_t azDegreesToSteps(double degrees) {
-  double wrapped = fmod(degrees, 360.0);
-  if (wrapped < 0.0) {
-    wrapped += 360.0;
-  }
-  double steps = wrapped * calibration.stepsPerDegreeAz + calibration.azHomeOffset;
-  return static_cast<int64_t>(llround(steps));
+  return step_conversion::azDegreesToSteps(calibration, degrees);
 }
 
 int64_t altDegreesToSteps(double degrees) {
-  if (calibration.stepsPerDegreeAlt <= 0.0) {
-    return 0;
-  }
-  double target = degrees;
-  if (altitudeLimitsEnabled) {
-    target = clampAltitudeDegrees(degrees);
-  }
-  double steps = target * calibration.stepsPerDegreeAlt + calibration.altHomeOffset;
-  return static_cast<int64_t>(llround(steps));
+  return step_conversion::altDegreesToSteps(calibration, altitudeLimitsEnabled, degrees);
 }
 
 double getMinAltitudeDegrees() { return kMinAltitudeDegrees; }
@@ -479,11 +1076,15 @@ double getMaxAltitudeDegrees() { return kMaxAltitudeDegrees; }
 
 void applyCalibration(const AxisCalibration& newCalibration) {
   calibration = newCalibration;
+  updateAltitudeBounds();
 }
 
 void setBacklash(const BacklashConfig& newBacklash) { backlash = newBacklash; }
 
-void setAltitudeLimitsEnabled(bool enabled) { altitudeLimitsEnabled = enabled; }
+void setAltitudeLimitsEnabled(bool enabled) {
+  altitudeLimitsEnabled = enabled;
+  updateAltitudeBounds();
+}
 
 int32_t getBacklashSteps(Axis axis) {
   return (axis == Axis::Az) ? backlash.azSteps : backlash.altSteps;
@@ -497,6 +1098,11 @@ int8_t getLastDirection(Axis axis) {
   return direction;
 }
 
+double getStepsPerSecond(Axis axis) {
+  AxisSnapshot snapshot = readAxisSnapshot(getAxisState(axis));
+  return static_cast<double>(snapshot.rate) / static_cast<double>(1 << kRateFractionBits);
+}
+
 }  // namespace motion
 
 #endif  // DEVICE_ROLE_MAIN
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "calibration.h"
+
+// Trapezoidal profile helpers shared by the HID planner and the main board
+// move executor. All values are in steps, steps/s and steps/s^2.
+namespace motion_profile {
+
+struct AxisLimits {
+  double maxSpeed;
+  double acceleration;
+  double deceleration;
+};
+
+inline AxisLimits toAxisLimits(const GotoProfile& profile, double stepsPerDegree) {
+  AxisLimits limits{};
+  limits.maxSpeed = std::max(profile.maxSpeedDegPerSec * stepsPerDegree, 1.0);
+  limits.acceleration = std::max(profile.accelerationDegPerSec2 * stepsPerDegree, 1.0);
+  limits.deceleration = std::max(profile.decelerationDegPerSec2 * stepsPerDegree, 1.0);
+  return limits;
+}
+
+inline double computeTravelTimeSteps(double distanceSteps,
+                                     double maxSpeed,
+                                     double accel,
+                                     double decel) {
+  double distance = std::fabs(distanceSteps);
+  if (distance < 1.0) {
+    return 0.0;
+  }
+  maxSpeed = std::max(maxSpeed, 1.0);
+  accel = std::max(accel, 1.0);
+  decel = std::max(decel, 1.0);
+  double distAccel = (maxSpeed * maxSpeed) / (2.0 * accel);
+  double distDecel = (maxSpeed * maxSpeed) / (2.0 * decel);
+  if (distance >= distAccel + distDecel) {
+    double cruise = distance - distAccel - distDecel;
+    return maxSpeed / accel + maxSpeed / decel + cruise / maxSpeed;
+  }
+  double peakSpeed = std::sqrt((2.0 * distance * accel * decel) / (accel + decel));
+  return peakSpeed / accel + peakSpeed / decel;
+}
+
+inline double computeTravelTimeSteps(double distanceSteps, const AxisLimits& limits) {
+  return computeTravelTimeSteps(distanceSteps, limits.maxSpeed, limits.acceleration,
+                                limits.deceleration);
+}
+
+inline double computePeakSpeedSteps(double distanceSteps, const AxisLimits& limits) {
+  double distance = std::fabs(distanceSteps);
+  double accel = std::max(limits.acceleration, 1.0);
+  double decel = std::max(limits.deceleration, 1.0);
+  double peakSpeed = std::sqrt((2.0 * distance * accel * decel) / (accel + decel));
+  return std::min(std::max(limits.maxSpeed, 1.0), peakSpeed);
+}
+
+// Scales the follower axis to the lead axis' trapezoid so both cover their
+// distance along the same normalised trajectory and arrive together. The
+// result never exceeds the follower's own limits.
+inline AxisLimits scaleToLeadAxis(const AxisLimits& lead,
+                                  double leadDistanceSteps,
+                                  const AxisLimits& follower,
+                                  double followerDistanceSteps) {
+  double leadDistance = std::fabs(leadDistanceSteps);
+  if (leadDistance < 1.0) {
+    return follower;
+  }
+  double ratio = std::fabs(followerDistanceSteps) / leadDistance;
+  AxisLimits scaled{};
+  scaled.maxSpeed =
+      std::min(computePeakSpeedSteps(leadDistance, lead) * ratio, follower.maxSpeed);
+  scaled.acceleration = std::min(std::max(lead.acceleration, 1.0) * ratio, follower.acceleration);
+  scaled.deceleration = std::min(std::max(lead.deceleration, 1.0) * ratio, follower.deceleration);
+  return scaled;
+}
+
+}  // namespace motion_profile
@@ -22,6 +22,8 @@ enum class PlanetId {
 namespace planets {
 
 bool computePlanet(PlanetId id, double julianDay, PlanetPosition& out);
+// Float kernel; the time is microseconds since J2000.0 (see astro_time.h).
+bool computePlanetAt(PlanetId id, int64_t microsSinceJ2000, PlanetPosition& out);
 bool planetFromString(const String& name, PlanetId& id);
 double julianDay(int year, int month, int day, double hourFraction);
 
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cmath>
+
+#include "astro_time.h"
+#include "planets.h"
+
+// Keplerian planet model (JPL approximate elements, 1800-2050), templated on
+// the scalar type so host benchmarks can build float and operation-counting
+// variants. planets.cpp instantiates it in double; computeGeocentricAt() is the
+// float build, which takes the fast-moving mean longitudes from fixed-point
+// time.
+namespace planets {
+namespace kernel {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kDegToRad = kPi / 180.0;
+constexpr double kRadToDeg = 180.0 / kPi;
+constexpr double kRadToHour = 12.0 / kPi;
+
+struct OrbitalElements {
+  double a0;
+  double a1;
+  double e0;
+  double e1;
+  double i0;
+  double i1;
+  double L0;
+  double L1;
+  double peri0;
+  double peri1;
+  double node0;
+  double node1;
+};
+
+constexpr OrbitalElements kElements[] = {
+    // Mercury
+    {0.38709927, 0.00000037, 0.20563593, 0.00001906, 7.00497902, -0.00594749, 252.25032350,
+     149472.67411175, 77.45779628, 0.16047689, 48.33076593, -0.12534081},
+    // Venus
+    {0.72333566, 0.00000390, 0.00677672, -0.00004107, 3.39467605, -0.00078890, 181.97909950,
+     58517.81538729, 131.60246718, 0.00268329, 76.67984255, -0.27769418},
+    // Earth
+    {1.00000261, 0.00000562, 0.01671123, -0.00004392, -0.00001531, -0.01294668, 100.46457166,
+     35999.37244981, 102.93768193, 0.32327364, 0.0, 0.0},
+    // Mars
+    {1.52371034, 0.00001847, 0.09339410, 0.00007882, 1.84969142, -0.00813131, -4.55343205,
+     19140.30268499, -23.94362959, 0.44441088, 49.55953891, -0.29257343},
+    // Jupiter
+    {5.20288700, -0.00011607, 0.04838624, -0.00013253, 1.30439695, -0.00183714, 34.39644051,
+     3034.74612775, 14.72847983, 0.21252668, 100.47390909, 0.20469106},
+    // Saturn
+    {9.53667594, -0.00125060, 0.05386179, -0.00050991, 2.48599187, 0.00193609, 49.95424423,
+     1222.49362201, 92.59887831, -0.41897216, 113.66242448, -0.28867794},
+    // Uranus
+    {19.18916464, -0.00196176, 0.04725744, -0.00004397, 0.77263783, -0.00242939, 313.23810451,
+     428.48202785, 170.95427630, 0.40805281, 74.01692503, 0.04240589},
+    // Neptune
+    {30.06992276, 0.00026291, 0.00859048, 0.00005105, 1.77004347, 0.00035372, -55.12002969,
+     218.45945325, 44.96476227, -0.32241464, 131.78422574, -0.00508664},
+};
+
+template <typename Real>
+struct Vec3 {
+  Real x;
+  Real y;
+  Real z;
+};
+
+template <typename Real>
+struct Position {
+  Real raHours;
+  Real decDegrees;
+  Real distanceAu;
+};
+
+template <typename Real>
+Real normalizeAngle(Real value) {
+  using std::fmod;
+  value = fmod(value, Real(360.0));
+  if (value < Real(0)) value += Real(360.0);
+  return value;
+}
+
+template <typename Real>
+Real normalizeRadians(Real value) {
+  using std::fmod;
+  value = fmod(value, Real(2 * kPi));
+  if (value < Real(0)) value += Real(2 * kPi);
+  return value;
+}
+
+template <typename Real>
+Real solveKepler(Real M, Real e) {
+  using std::cos;
+  using std::fabs;
+  using std::sin;
+  Real E = M;
+  for (int i = 0; i < 5; ++i) {
+    Real delta = (E - e * sin(E) - M) / (Real(1.0) - e * cos(E));
+    E -= delta;
+    if (fabs(delta) < Real(1e-8)) {
+      break;
+    }
+  }
+  return E;
+}
+
+template <typename Real>
+Real meanLongitudeDeg(PlanetId id, Real T) {
+  const OrbitalElements& el = kElements[static_cast<int>(id)];
+  return normalizeAngle(Real(el.L0) + Real(el.L1) * T);
+}
+
+// L is the mean longitude in degrees.
+template <typename Real>
+Vec3<Real> heliocentricEcliptic(PlanetId id, Real T, Real meanLongitude) {
+  using std::atan2;
+  using std::cos;
+  using std::sin;
+  using std::sqrt;
+  const OrbitalElements& el = kElements[static_cast<int>(id)];
+  Real a = Real(el.a0) + Real(el.a1) * T;
+  Real e = Real(el.e0) + Real(el.e1) * T;
+  Real I = (Real(el.i0) + Real(el.i1) * T) * Real(kDegToRad);
+  Real L = meanLongitude * Real(kDegToRad);
+  Real peri = normalizeAngle(Real(el.peri0) + Real(el.peri1) * T) * Real(kDegToRad);
+  Real node = normalizeAngle(Real(el.node0) + Real(el.node1) * T) * Real(kDegToRad);
+  Real M = normalizeRadians(L - peri);
+  Real E = solveKepler(M, e);
+  Real xv = cos(E) - e;
+  Real yv = sqrt(Real(1) - e * e) * sin(E);
+  Real v = atan2(yv, xv);
+  Real r = a * (Real(1) - e * cos(E));
+  Real w = peri - node;
+  Real cosO = cos(node);
+  Real sinO = sin(node);
+  Real cosI = cos(I);
+  Real sinI = sin(I);
+  Real cosvw = cos(v + w);
+  Real sinvw = sin(v + w);
+
+  Vec3<Real> result;
+  result.x = r * (cosO * cosvw - sinO * sinvw * cosI);
+  result.y = r * (sinO * cosvw + cosO * sinvw * cosI);
+  result.z = r * (sinvw * sinI);
+  return result;
+}
+
+// T is Julian centuries since J2000.
+template <typename Real>
+Position<Real> computeGeocentric(PlanetId planet, Real T, Real planetLongitude,
+                                 Real earthLongitude) {
+  using std::atan2;
+  using std::cos;
+  using std::sin;
+  using std::sqrt;
+  Vec3<Real> planetVec = heliocentricEcliptic(planet, T, planetLongitude);
+  Vec3<Real> earthVec = heliocentricEcliptic(PlanetId::Earth, T, earthLongitude);
+  Vec3<Real> geo{planetVec.x - earthVec.x, planetVec.y - earthVec.y, planetVec.z - earthVec.z};
+
+  Real epsilon = (Real(23.439291) - Real(0.0130042) * T) * Real(kDegToRad);
+  Real cosEps = cos(epsilon);
+  Real sinEps = sin(epsilon);
+  Real x = geo.x;
+  Real y = geo.y * cosEps - geo.z * sinEps;
+  Real z = geo.y * sinEps + geo.z * cosEps;
+
+  Real ra = atan2(y, x);
+  if (ra < Real(0)) {
+    ra += Real(2 * kPi);
+  }
+  Real dec = atan2(z, sqrt(x * x + y * y));
+  Real distance = sqrt(x * x + y * y + z * z);
+
+  Position<Real> position{normalizeRadians(ra) * Real(kRadToHour), dec * Real(kRadToDeg),
+                          distance};
+  if (position.raHours < Real(0)) {
+    position.raHours += Real(24.0);
+  }
+  return position;
+}
+
+template <typename Real>
+Position<Real> computeGeocentric(PlanetId planet, Real T) {
+  return computeGeocentric(planet, T, meanLongitudeDeg(planet, T),
+                           meanLongitudeDeg(PlanetId::Earth, T));
+}
+
+// Mercury's mean longitude advances 4 degrees a day, far more than float keeps
+// of a Julian-century product, so the float build reads it from fixed point.
+constexpr astro_time::LinearAngle meanLongitudeAngle(int index) {
+  return astro_time::linearAngle(kElements[index].L0,
+                                 kElements[index].L1 / astro_time::kDaysPerCentury);
+}
+
+constexpr astro_time::LinearAngle kMeanLongitudes[] = {
+    meanLongitudeAngle(0), meanLongitudeAngle(1), meanLongitudeAngle(2), meanLongitudeAngle(3),
+    meanLongitudeAngle(4), meanLongitudeAngle(5), meanLongitudeAngle(6), meanLongitudeAngle(7),
+};
+
+inline float meanLongitudeDegAt(PlanetId id, int64_t microsSinceJ2000) {
+  return astro_time::turnsToDegrees(
+      astro_time::angleAt(kMeanLongitudes[static_cast<int>(id)], microsSinceJ2000));
+}
+
+inline Position<float> computeGeocentricAt(PlanetId planet, int64_t microsSinceJ2000) {
+  return computeGeocentric(planet, astro_time::centuries(microsSinceJ2000),
+                           meanLongitudeDegAt(planet, microsSinceJ2000),
+                           meanLongitudeDegAt(PlanetId::Earth, microsSinceJ2000));
+}
+
+}  // namespace kernel
+}  // namespace planets
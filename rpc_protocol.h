@@ -0,0 +1,304 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "Comms.h"
+
+// Binary RPC between HID and main board. Every frame on kChannel starts with
+// a header followed by the packed payload struct of its opcode. Both boards
+// are little-endian ESP32s, so the structs go over the wire as-is. Bump
+// kVersion whenever a payload layout changes.
+namespace rpc {
+
+constexpr uint8_t kVersion = 2;
+constexpr uint8_t kChannel = 2;
+// Unsolicited main board state, see Telemetry.
+constexpr uint8_t kTelemetryChannel = 3;
+
+enum class Opcode : uint8_t {
+  kSetManualRpm = 1,
+  kSetManualSps,
+  kSetGotoSps,
+  kClearGoto,
+  kMoveTo,
+  kGetMoveActive,
+  kStopAll,
+  kSetTrackingEnabled,
+  kSetTrackingRates,
+  kSetTrackingPoly,
+  kClearTrackingPoly,
+  kQueueSegments,
+  kClearSegments,
+  kGetSegmentSpace,
+  kSetWifiEnabled,
+  kGetStepCount,
+  kSetStepCount,
+  kStepsToAz,
+  kStepsToAlt,
+  kAzToSteps,
+  kAltToSteps,
+  kApplyCalibration,
+  kSetBacklash,
+  kSetAltLimitsEnabled,
+  kGetBacklash,
+  kGetLastDir,
+  kSetLinkBaud,
+  kGetLinkStats,
+  kBatch,
+};
+
+// Highest opcode; per-command tables are indexed by opcode - 1.
+constexpr size_t kOpcodeCount = static_cast<size_t>(Opcode::kBatch);
+
+// kBatch carries up to kMaxBatchCommands setters, each packed as opcode,
+// payload size and payload. They run in order and the answer is a count
+// followed by one Status per command; result payloads are dropped.
+constexpr size_t kMaxBatchCommands = 12;
+constexpr size_t kBatchEntryHeaderSize = 2;
+
+// Commands allowed inside kBatch: quick setters answered by a status alone.
+// Getters would lose their result, kSetLinkBaud would switch the rate before
+// the batch answer, and kSetWifiEnabled blocks; the main board answers those
+// with kBadPayload without running them.
+constexpr bool isBatchable(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::kSetManualRpm:
+    case Opcode::kSetManualSps:
+    case Opcode::kSetGotoSps:
+    case Opcode::kClearGoto:
+    case Opcode::kStopAll:
+    case Opcode::kSetTrackingEnabled:
+    case Opcode::kSetTrackingRates:
+    case Opcode::kClearTrackingPoly:
+    case Opcode::kClearSegments:
+    case Opcode::kSetStepCount:
+    case Opcode::kApplyCalibration:
+    case Opcode::kSetBacklash:
+    case Opcode::kSetAltLimitsEnabled:
+      return true;
+    default:
+      return false;
+  }
+}
+
+enum class Status : uint8_t {
+  kOk = 0,
+  kUnsupportedVersion,
+  kUnknownOpcode,
+  kBadPayload,
+  kInvalidAxis,
+  kRejected,
+};
+
+inline const char* statusName(Status status) {
+  switch (status) {
+    case Status::kOk:
+      return "OK";
+    case Status::kUnsupportedVersion:
+      return "Version mismatch";
+    case Status::kUnknownOpcode:
+      return "Unknown command";
+    case Status::kBadPayload:
+      return "Bad payload";
+    case Status::kInvalidAxis:
+      return "Invalid axis";
+    case Status::kRejected:
+    default:
+      return "Rejected";
+  }
+}
+
+struct __attribute__((packed)) RequestHeader {
+  uint8_t version;
+  Opcode opcode;
+  uint16_t id;
+};
+
+struct __attribute__((packed)) ResponseHeader {
+  uint8_t version;
+  Opcode opcode;
+  uint16_t id;
+  Status status;
+};
+
+constexpr size_t kMaxPayloadSize = Comms::kMaxPayloadSize - sizeof(ResponseHeader);
+
+// The main board keeps the answers to its last kReplayDepth binary requests
+// for kReplayMaxAgeMs and replays them to retransmitted ids. Every request id
+// takes at most one entry, so the HID retransmits only while fewer than
+// kReplayDepth newer ids are out and the first attempt is younger than
+// kReplayMaxAgeMs; past either limit a retry could run the command twice.
+constexpr size_t kReplayDepth = 16;
+constexpr uint32_t kReplayMaxAgeMs = 5000;
+
+// Axis on the wire: 0 = Az, 1 = Alt.
+constexpr uint8_t kAxisAz = 0;
+constexpr uint8_t kAxisAlt = 1;
+
+// Shared payloads ------------------------------------------------------------
+
+struct __attribute__((packed)) AxisSelect {
+  uint8_t axis;
+};
+
+struct __attribute__((packed)) AxisFloat {
+  uint8_t axis;
+  float value;
+};
+
+struct __attribute__((packed)) AxisInt64 {
+  uint8_t axis;
+  int64_t value;
+};
+
+struct __attribute__((packed)) Flag {
+  uint8_t value;
+};
+
+struct __attribute__((packed)) FloatValue {
+  float value;
+};
+
+struct __attribute__((packed)) Int64Value {
+  int64_t value;
+};
+
+struct __attribute__((packed)) Int32Value {
+  int32_t value;
+};
+
+struct __attribute__((packed)) Int8Value {
+  int8_t value;
+};
+
+// Opcode specific payloads ---------------------------------------------------
+
+struct __attribute__((packed)) MoveToRequest {
+  int64_t azTargetSteps;
+  int64_t altTargetSteps;
+  float maxSpeedDegPerSec;
+  float accelerationDegPerSec2;
+  float decelerationDegPerSec2;
+  uint8_t mode;
+};
+
+struct __attribute__((packed)) TrackingRatesRequest {
+  float azDegPerSec;
+  float altDegPerSec;
+};
+
+struct __attribute__((packed)) TrackingPolyRequest {
+  uint8_t axis;
+  uint32_t horizonMs;
+  int64_t baseSteps;
+  float c1;
+  float c2;
+  float c3;
+};
+
+struct __attribute__((packed)) Segment {
+  uint32_t startMs;
+  uint32_t durationMs;
+  float startStepsPerSecond;
+  float accelStepsPerSecond2;
+};
+
+constexpr size_t kMaxSegmentsPerRequest = 8;
+
+// Variable length: only the first count segments are transmitted.
+struct __attribute__((packed)) QueueSegmentsRequest {
+  uint8_t axis;
+  uint8_t count;
+  Segment segments[kMaxSegmentsPerRequest];
+};
+
+constexpr size_t kQueueSegmentsHeaderSize = 2;
+
+// generation numbers the HID's calibration mirror; the main board echoes the
+// last one it applied in telemetry so a lost or rebooted state is resent.
+struct __attribute__((packed)) CalibrationRequest {
+  double stepsPerDegreeAz;
+  double stepsPerDegreeAlt;
+  int64_t azHomeOffset;
+  int64_t altHomeOffset;
+  uint32_t generation;
+};
+
+struct __attribute__((packed)) AltitudeLimitsRequest {
+  uint8_t enabled;
+  uint32_t generation;
+};
+
+// Answered at the current rate; both boards switch once the answer is through.
+struct __attribute__((packed)) LinkBaudRequest {
+  uint32_t baud;
+};
+
+struct __attribute__((packed)) BacklashRequest {
+  int32_t azSteps;
+  int32_t altSteps;
+};
+
+// Main board side of the link, answered to kGetLinkStats. Counters run
+// since boot; byte rates cover the last full second.
+struct __attribute__((packed)) LinkStats {
+  uint32_t baud;
+  uint32_t crcErrors;
+  uint32_t payloadErrors;
+  uint32_t retransmits;
+  uint32_t duplicatesRx;
+  uint32_t deliveryFailures;
+  uint32_t replayedRequests;
+  uint32_t txBytesPerSecond;
+  uint32_t rxBytesPerSecond;
+  uint8_t frameQueueHighWater;
+  uint8_t lineQueueHighWater;
+};
+
+// Emergency stop --------------------------------------------------------------
+
+enum class StopScope : uint8_t {
+  kAll = 0,  // Everything, as kStopAll.
+  kGoto,     // Goto rates and moves, as kClearGoto.
+};
+
+// Sent as a Comms priority frame so it never waits behind queued requests.
+// The main board's link task acts on it from the receive path, within about
+// one 1 ms poll even while a request handler runs, and echoes it back, which
+// lets the HID measure stop latency.
+struct __attribute__((packed)) EmergencyStop {
+  uint8_t version;
+  StopScope scope;
+  uint16_t sequence;
+};
+
+// Telemetry -----------------------------------------------------------------
+
+constexpr uint8_t kTelemetryMoveActive = 0x01;
+
+// Pushed by the main board at config::TELEMETRY_RATE_HZ. lastRequestId is the
+// newest request it had finished when the frame was built, so the HID can
+// tell whether a frame already reflects a command it sent.
+struct __attribute__((packed)) Telemetry {
+  uint8_t version;
+  uint16_t lastRequestId;
+  uint32_t timestampMs;
+  int64_t azSteps;
+  int64_t altSteps;
+  float azStepsPerSecond;
+  float altStepsPerSecond;
+  int8_t azLastDirection;
+  int8_t altLastDirection;
+  uint8_t flags;
+  uint32_t calibrationGeneration;
+};
+
+static_assert(sizeof(QueueSegmentsRequest) <= kMaxPayloadSize,
+              "Segment batch does not fit a link packet");
+static_assert(sizeof(CalibrationRequest) <= kMaxPayloadSize,
+              "Calibration payload does not fit a link packet");
+static_assert(sizeof(LinkStats) <= kMaxPayloadSize, "Link stats do not fit a link packet");
+static_assert(sizeof(Telemetry) <= Comms::kMaxPayloadSize,
+              "Telemetry does not fit a link packet");
+
+}  // namespace rpc
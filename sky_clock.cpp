@@ -0,0 +1,381 @@
+#include "sky_clock.h"
+
+#include <esp_timer.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "astro_time.h"
+
+namespace sky_clock {
+
+namespace {
+
+constexpr int64_t kMicrosPerSecond = astro_time::kMicrosPerSecond;
+constexpr int64_t kSyncIntervalMicros = 60 * kMicrosPerSecond;
+// An edge further than this from the model is a different timeline (RTC
+// set, NTP step) rather than drift.
+constexpr int64_t kStepThresholdMicros = 500000;
+// Drift needs captures spanning at least this long to beat the edge
+// uncertainty; kHistorySize captures at kSyncIntervalMicros span 15 minutes.
+constexpr int64_t kMinDriftSpanMicros = 5 * 60 * kMicrosPerSecond;
+constexpr size_t kHistorySize = 16;
+constexpr int64_t kMaxDriftPpb = 500000;  // 500 ppm, far beyond any crystal
+// The fine window spans the current uncertainty plus this margin on either
+// side of the predicted edge.
+constexpr int64_t kFineMarginMicros = 2000;
+// One update() reads back to back for at most this long; the window is
+// narrowed across passes and seconds instead of waiting inside it.
+constexpr int64_t kFineBurstMicros = 3000;
+// Bounds from different passes are applied once they are this close.
+constexpr int64_t kFineTargetMicros = 1000;
+// A window the edge keeps dodging is re-acquired coarsely.
+constexpr int64_t kFineTimeoutMicros = 30 * kMicrosPerSecond;
+// The reference restarts its second when written, so a pending write only
+// goes out this soon after a boundary; well inside an NTP reference's own
+// uncertainty.
+constexpr int64_t kWriteWindowMicros = 5000;
+
+enum class Phase : uint8_t {
+  Coarse,  // read once per update() until the seconds change
+  Fine,    // narrow the predicted edge with short bursts of reads
+};
+
+struct Edge {
+  int64_t timerMicros;
+  int64_t utcMicros;
+};
+
+portMUX_TYPE clockMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Guarded by clockMux.
+int64_t anchorTimer = 0;
+int64_t anchorUtc = 0;
+int64_t driftPpb = 0;
+Source source = Source::None;
+bool locked = false;
+uint32_t uncertaintyMicros = 0;
+int64_t lastReturnedUtc = INT64_MIN;
+Edge history[kHistorySize];
+size_t historyCount = 0;
+
+// Only touched from the UI loop.
+SecondsReader reader = nullptr;
+SecondsWriter writer = nullptr;
+bool writePending = false;
+Phase phase = Phase::Coarse;
+int64_t nextCaptureTimer = 0;
+bool coarseHavePrevious = false;
+time_t coarsePreviousSecond = 0;
+int64_t coarsePreviousTimer = 0;
+// The edge lies between these offsets from its predicted timer value.
+int64_t fineLo = 0;
+int64_t fineHi = 0;
+
+int64_t utcAtLocked(int64_t timerMicros) {
+  int64_t elapsed = timerMicros - anchorTimer;
+  return anchorUtc + elapsed + elapsed * driftPpb / 1000000000;
+}
+
+int64_t timerAtLocked(int64_t utcMicros) {
+  int64_t elapsed = utcMicros - anchorUtc;
+  return anchorTimer + elapsed - elapsed * driftPpb / 1000000000;
+}
+
+// Two-point drift between the oldest and newest capture of the timeline.
+void updateDriftLocked() {
+  if (historyCount < 2) {
+    return;
+  }
+  const Edge& oldest = history[0];
+  const Edge& newest = history[historyCount - 1];
+  int64_t timerSpan = newest.timerMicros - oldest.timerMicros;
+  if (timerSpan < kMinDriftSpanMicros) {
+    return;
+  }
+  int64_t error = (newest.utcMicros - oldest.utcMicros) - timerSpan;
+  int64_t ppb = error * 1000000000 / timerSpan;
+  driftPpb = ppb > kMaxDriftPpb ? kMaxDriftPpb : (ppb < -kMaxDriftPpb ? -kMaxDriftPpb : ppb);
+}
+
+// Returns false when a less trusted source tried to step the clock.
+bool apply(int64_t utcMicros, int64_t timerMicros, uint32_t uncertainty, Source from, bool fine,
+           bool force) {
+  portENTER_CRITICAL(&clockMux);
+  bool step = source == Source::None ||
+              llabs(utcMicros - utcAtLocked(timerMicros)) > kStepThresholdMicros;
+  if (step && !force && from < source) {
+    portEXIT_CRITICAL(&clockMux);
+    return false;
+  }
+  if (step || force) {
+    historyCount = 0;
+    lastReturnedUtc = INT64_MIN;
+    source = from;
+  } else if (from > source) {
+    source = from;
+  }
+  if (historyCount == kHistorySize) {
+    memmove(history, history + 1, sizeof(history[0]) * (kHistorySize - 1));
+    --historyCount;
+  }
+  history[historyCount++] = {timerMicros, utcMicros};
+  updateDriftLocked();
+  anchorTimer = timerMicros;
+  anchorUtc = utcMicros;
+  locked = fine;
+  uncertaintyMicros = uncertainty;
+  portEXIT_CRITICAL(&clockMux);
+  return true;
+}
+
+void startCoarse(int64_t nowTimer, int64_t after) {
+  phase = Phase::Coarse;
+  nextCaptureTimer = nowTimer + after;
+  coarseHavePrevious = false;
+}
+
+void startFine(int64_t nowTimer, int64_t after) {
+  phase = Phase::Fine;
+  nextCaptureTimer = nowTimer + after;
+  portENTER_CRITICAL(&clockMux);
+  int64_t lead = static_cast<int64_t>(uncertaintyMicros) + kFineMarginMicros;
+  portEXIT_CRITICAL(&clockMux);
+  fineLo = -lead;
+  fineHi = lead;
+}
+
+// The RTC latches its registers partway through a read; the middle of the
+// transfer is the best single timestamp for it.
+bool timedRead(time_t& second, int64_t& timerMicros) {
+  int64_t start = esp_timer_get_time();
+  bool ok = reader(second);
+  timerMicros = (start + esp_timer_get_time()) / 2;
+  return ok;
+}
+
+// Once per update(): an edge lies between two reads whose seconds differ.
+void coarseCapture() {
+  int64_t before;
+  time_t second;
+  if (!timedRead(second, before)) {
+    coarseHavePrevious = false;
+    return;
+  }
+  if (coarseHavePrevious && second == coarsePreviousSecond + 1) {
+    int64_t edge = (coarsePreviousTimer + before) / 2;
+    uint32_t uncertainty = static_cast<uint32_t>((before - coarsePreviousTimer) / 2);
+    if (apply(static_cast<int64_t>(second) * kMicrosPerSecond, edge, uncertainty, Source::Rtc,
+              false, false)) {
+      startFine(before, 0);  // refine right away
+    } else {
+      startCoarse(before, kSyncIntervalMicros);
+    }
+    return;
+  }
+  coarseHavePrevious = true;
+  coarsePreviousSecond = second;
+  coarsePreviousTimer = before;
+}
+
+// Timer value of the UTC second boundary whose fine window has not closed
+// yet at timerMicros.
+void fineWindow(int64_t timerMicros, int64_t& edgeTimer, time_t& secondBefore) {
+  portENTER_CRITICAL(&clockMux);
+  int64_t boundary = utcAtLocked(timerMicros) / kMicrosPerSecond * kMicrosPerSecond;
+  edgeTimer = timerAtLocked(boundary);
+  if (timerMicros >= edgeTimer + fineHi) {
+    boundary += kMicrosPerSecond;
+    edgeTimer = timerAtLocked(boundary);
+  }
+  portEXIT_CRITICAL(&clockMux);
+  secondBefore = static_cast<time_t>(boundary / kMicrosPerSecond - 1);
+}
+
+// Reads back to back for at most kFineBurstMicros. A read before the edge
+// raises fineLo, one after it lowers fineHi; an edge between two reads of the
+// burst, or bounds that met across passes, are applied. A read the window
+// cannot explain falls back to coarse acquisition.
+void fineCapture() {
+  int64_t now = esp_timer_get_time();
+  if (now - nextCaptureTimer > kFineTimeoutMicros) {
+    startCoarse(now, 0);
+    return;
+  }
+  int64_t edgeTimer;
+  time_t secondBefore;
+  fineWindow(now, edgeTimer, secondBefore);
+  const int64_t burstEnd = now + kFineBurstMicros;
+  bool havePrevious = false;
+  for (;;) {
+    int64_t at;
+    time_t second;
+    if (!timedRead(second, at)) {
+      return;  // bus busy: retry on a later pass
+    }
+    int64_t offset = at - edgeTimer;
+    if (second == secondBefore && offset < fineHi) {
+      fineLo = offset > fineLo ? offset : fineLo;
+      havePrevious = true;
+    } else if (second == secondBefore + 1 && offset > fineLo) {
+      fineHi = offset < fineHi ? offset : fineHi;
+      if (havePrevious || fineHi - fineLo <= kFineTargetMicros) {
+        bool accepted = apply(static_cast<int64_t>(second) * kMicrosPerSecond,
+                              edgeTimer + (fineLo + fineHi) / 2,
+                              static_cast<uint32_t>((fineHi - fineLo) / 2), Source::Rtc, true,
+                              false);
+        if (accepted) {
+          startFine(at, kSyncIntervalMicros);
+        } else {
+          startCoarse(at, kSyncIntervalMicros);
+        }
+      }
+      return;
+    } else {
+      startCoarse(at, 0);
+      return;
+    }
+    if (at >= burstEnd) {
+      return;
+    }
+  }
+}
+
+// Timer value of the next UTC second boundary, or nowTimer when one passed
+// less than kWriteWindowMicros ago. INT64_MAX until the clock is set.
+int64_t writeTimer(int64_t nowTimer) {
+  portENTER_CRITICAL(&clockMux);
+  int64_t timer = INT64_MAX;
+  if (source != Source::None) {
+    int64_t utc = utcAtLocked(nowTimer);
+    int64_t boundary = utc / kMicrosPerSecond * kMicrosPerSecond;
+    timer = utc - boundary < kWriteWindowMicros ? nowTimer
+                                                 : timerAtLocked(boundary + kMicrosPerSecond);
+  }
+  portEXIT_CRITICAL(&clockMux);
+  return timer;
+}
+
+bool writeDue(int64_t nowTimer) {
+  return writePending && writer && writeTimer(nowTimer) <= nowTimer;
+}
+
+// Copies the clock to the reference right after a boundary. Its edges then
+// follow the clock's phase, so the fine window is searched again.
+void writeNow() {
+  if (!writer(nowUtcEpoch())) {
+    return;  // bus busy: retry after a later boundary
+  }
+  writePending = false;
+  if (reader) {
+    startFine(esp_timer_get_time(), 0);
+  }
+}
+
+}  // namespace
+
+void setReader(SecondsReader secondsReader) { reader = secondsReader; }
+
+void setWriter(SecondsWriter secondsWriter) { writer = secondsWriter; }
+
+bool captureDue() {
+  int64_t now = esp_timer_get_time();
+  if (writeDue(now)) {
+    return true;
+  }
+  if (!reader || now < nextCaptureTimer) {
+    return false;
+  }
+  if (phase == Phase::Coarse) {
+    return true;
+  }
+  if (now - nextCaptureTimer > kFineTimeoutMicros) {
+    return true;  // fineCapture() gives up on the window
+  }
+  int64_t edgeTimer;
+  time_t secondBefore;
+  fineWindow(now, edgeTimer, secondBefore);
+  return now >= edgeTimer + fineLo;
+}
+
+uint32_t sleepMicros(uint32_t periodMicros) {
+  int64_t now = esp_timer_get_time();
+  int64_t wake = now + periodMicros;
+  if (writePending && writer) {
+    int64_t at = writeTimer(now);
+    wake = at < wake ? at : wake;
+  }
+  if (reader && phase == Phase::Fine) {
+    int64_t from = nextCaptureTimer > now ? nextCaptureTimer : now;
+    int64_t edgeTimer;
+    time_t secondBefore;
+    fineWindow(from, edgeTimer, secondBefore);
+    int64_t open = edgeTimer + fineLo > from ? edgeTimer + fineLo : from;
+    wake = open < wake ? open : wake;
+  }
+  return wake > now ? static_cast<uint32_t>(wake - now) : 0;
+}
+
+void update() {
+  int64_t now = esp_timer_get_time();
+  if (writeDue(now)) {
+    writeNow();
+    return;
+  }
+  if (!captureDue()) {
+    return;
+  }
+  if (phase == Phase::Coarse) {
+    coarseCapture();
+  } else {
+    fineCapture();
+  }
+}
+
+void requestWrite() { writePending = true; }
+
+void set(time_t utcEpoch, Source from) {
+  apply(static_cast<int64_t>(utcEpoch) * kMicrosPerSecond, esp_timer_get_time(),
+        kMicrosPerSecond / 2, from, false, true);
+  // Whatever the RTC says now is the same timeline; re-acquire its phase.
+  startCoarse(0, 0);
+}
+
+void addReference(int64_t utcMicros, int64_t timerMicros, uint32_t uncertainty, Source from) {
+  apply(utcMicros, timerMicros, uncertainty, from, true, false);
+}
+
+int64_t nowUtcMicros() {
+  int64_t timer = esp_timer_get_time();
+  portENTER_CRITICAL(&clockMux);
+  int64_t utc = utcAtLocked(timer);
+  if (utc < lastReturnedUtc) {
+    utc = lastReturnedUtc;
+  } else {
+    lastReturnedUtc = utc;
+  }
+  portEXIT_CRITICAL(&clockMux);
+  return utc;
+}
+
+int64_t nowMicrosSinceJ2000() {
+  return nowUtcMicros() - astro_time::kJ2000UnixSeconds * kMicrosPerSecond;
+}
+
+time_t nowUtcEpoch() {
+  int64_t utc = nowUtcMicros();
+  return static_cast<time_t>(utc >= 0 ? utc / kMicrosPerSecond
+                                      : (utc - kMicrosPerSecond + 1) / kMicrosPerSecond);
+}
+
+Status status() {
+  int64_t timer = esp_timer_get_time();
+  portENTER_CRITICAL(&clockMux);
+  Status result{source, locked, static_cast<float>(driftPpb) / 1000.0f, uncertaintyMicros,
+                static_cast<uint32_t>((timer - anchorTimer) / 1000)};
+  portEXIT_CRITICAL(&clockMux);
+  return result;
+}
+
+}  // namespace sky_clock
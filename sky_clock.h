@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+// Sub-millisecond UTC for the astronomy code without touching the I2C bus.
+// esp_timer_get_time() is disciplined against second edges captured from the
+// DS3231 and against NTP when it answers: every capture re-anchors the phase,
+// and the spread of the recent captures gives the timer's drift.
+namespace sky_clock {
+
+// Ordered by trust; a reference may step the clock only if it is at least as
+// trusted as the one that set it.
+enum class Source : uint8_t {
+  None,
+  Stored,  // last epoch from EEPROM
+  Manual,  // user edit
+  Rtc,
+  Ntp,
+};
+
+struct Status {
+  Source source;
+  bool locked;  // phase from a fine second-edge capture
+  float driftPpm;  // positive when the timer runs slow
+  uint32_t uncertaintyMicros;
+  uint32_t lastSyncAgeMs;
+};
+
+// Reads the reference clock's whole UTC seconds; false when unavailable.
+using SecondsReader = bool (*)(time_t& utcEpoch);
+// Sets the reference clock, which restarts its second; false when busy.
+using SecondsWriter = bool (*)(time_t utcEpoch);
+
+void setReader(SecondsReader reader);
+void setWriter(SecondsWriter writer);
+// True when update() would read or write the reference. Lets the caller take
+// the bus only then.
+bool captureDue();
+// How long the UI loop may sleep, at most periodMicros, so its next pass
+// lands when a fine capture window opens or a pending write is due.
+uint32_t sleepMicros(uint32_t periodMicros);
+// Captures second edges from the reader and performs a pending write when
+// due. Call from the UI loop. It never waits for a window: a pass reads for
+// at most about 3 ms and the edge is narrowed over later passes.
+void update();
+// Writes the clock to the reference on the first update() just after a
+// second boundary, e.g. after an NTP reference.
+void requestWrite();
+// Steps the clock to a whole second, e.g. after a user edit; the drift
+// estimate is kept.
+void set(time_t utcEpoch, Source source);
+// An exact reference instant, e.g. NTP, taken at timerMicros.
+void addReference(int64_t utcMicros, int64_t timerMicros, uint32_t uncertaintyMicros,
+                  Source source);
+
+// Never runs backwards except when the clock is stepped.
+int64_t nowUtcMicros();
+int64_t nowMicrosSinceJ2000();
+time_t nowUtcEpoch();
+Status status();
+
+}  // namespace sky_clock
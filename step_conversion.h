@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "calibration.h"
+
+// Step <-> degree conversions shared by the main board and the HID's
+// calibration mirror, so both roles produce identical results.
+namespace step_conversion {
+
+constexpr double kMinAltitudeDegrees = -5.0;
+constexpr double kMaxAltitudeDegrees = 90.0;
+
+inline double clampAltitudeDegrees(double degrees) {
+  return std::clamp(degrees, kMinAltitudeDegrees, kMaxAltitudeDegrees);
+}
+
+inline double stepsToAltitudeDegreesRaw(const AxisCalibration& calibration, int64_t steps) {
+  if (calibration.stepsPerDegreeAlt <= 0.0) {
+    return 0.0;
+  }
+  double adjusted = static_cast<double>(steps - calibration.altHomeOffset);
+  return adjusted / calibration.stepsPerDegreeAlt;
+}
+
+inline double stepsToAzDegrees(const AxisCalibration& calibration, int64_t steps) {
+  if (calibration.stepsPerDegreeAz <= 0.0) {
+    return 0.0;
+  }
+  double adjusted = static_cast<double>(steps - calibration.azHomeOffset);
+  double degrees = std::fmod(adjusted / calibration.stepsPerDegreeAz, 360.0);
+  if (degrees < 0.0) {
+    degrees += 360.0;
+  }
+  return degrees;
+}
+
+inline double stepsToAltDegrees(const AxisCalibration& calibration, bool limitsEnabled,
+                                int64_t steps) {
+  if (calibration.stepsPerDegreeAlt <= 0.0) {
+    return 0.0;
+  }
+  double degrees = stepsToAltitudeDegreesRaw(calibration, steps);
+  if (degrees > 180.0 || degrees < -180.0) {
+    degrees = std::fmod(degrees, 360.0);
+    if (degrees > 180.0) {
+      degrees -= 360.0;
+    } else if (degrees < -180.0) {
+      degrees += 360.0;
+    }
+  }
+  if (limitsEnabled) {
+    return clampAltitudeDegrees(degrees);
+  }
+  return degrees;
+}
+
+inline int64_t azDegreesToSteps(const AxisCalibration& calibration, double degrees) {
+  double wrapped = std::fmod(degrees, 360.0);
+  if (wrapped < 0.0) {
+    wrapped += 360.0;
+  }
+  double steps = wrapped * calibration.stepsPerDegreeAz + calibration.azHomeOffset;
+  return static_cast<int64_t>(std::llround(steps));
+}
+
+inline int64_t altDegreesToSteps(const AxisCalibration& calibration, bool limitsEnabled,
+                                 double degrees) {
+  if (calibration.stepsPerDegreeAlt <= 0.0) {
+    return 0;
+  }
+  double target = limitsEnabled ? clampAltitudeDegrees(degrees) : degrees;
+  double steps = target * calibration.stepsPerDegreeAlt + calibration.altHomeOffset;
+  return static_cast<int64_t>(std::llround(steps));
+}
+
+}  // namespace step_conversion
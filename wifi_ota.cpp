@@ -2,13 +2,17 @@
 
 #include <ArduinoOTA.h>
 #include <WiFi.h>
+#include <sys/time.h>
 #include <time.h>
 
 #include "config.h"
 #include "storage.h"
 
 #if defined(DEVICE_ROLE_HID)
+#include <esp_timer.h>
+
 #include "display_menu.h"
+#include "sky_clock.h"
 #endif
 
 namespace wifi_ota {
@@ -26,6 +30,8 @@ NtpStatus lastReportedNtpStatus = NtpStatus::None;
 constexpr uint32_t kReconnectIntervalMs = 10000;
 constexpr uint32_t kNtpResyncIntervalMs = 6UL * 60UL * 60UL * 1000UL;
 constexpr uint32_t kNtpRetryIntervalMs = 60000;
+// SNTP over WiFi typically lands within a few milliseconds.
+constexpr uint32_t kNtpUncertaintyMicros = 10000;
 
 uint32_t lastReconnectAttemptMs = 0;
 uint32_t lastNtpSyncMs = 0;
@@ -92,10 +98,19 @@ bool syncTimeWithNtp() {
   if (!getLocalTime(&timeinfo, 10000)) {
     return false;
   }
-  time_t utcEpoch = mktime(&timeinfo);
 #if defined(DEVICE_ROLE_HID)
-  display_menu::applyNetworkTime(utcEpoch);
+  // The system time was just set by SNTP; pair it with the timer read around
+  // it. The RTC is written by the sky clock on a later UI pass, right after a
+  // second boundary, so its edges stay in phase with NTP.
+  struct timeval tv{};
+  int64_t before = esp_timer_get_time();
+  gettimeofday(&tv, nullptr);
+  int64_t timerMicros = (before + esp_timer_get_time()) / 2;
+  sky_clock::addReference(static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec, timerMicros,
+                          kNtpUncertaintyMicros, sky_clock::Source::Ntp);
+  display_menu::applyNetworkTime();
 #else
+  time_t utcEpoch = mktime(&timeinfo);
   storage::setRtcEpoch(static_cast<uint32_t>(utcEpoch));
 #endif
   return true;